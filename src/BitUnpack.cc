@@ -0,0 +1,725 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BitUnpack.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ORC_X86_KERNELS
+#include <immintrin.h>
+#define ORC_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace orc {
+
+  const char* getBitUnpackLevelName(BitUnpackLevel level) {
+    switch (level) {
+    case BitUnpackLevel_SCALAR:
+      return "scalar";
+    case BitUnpackLevel_SSE42:
+      return "sse4.2";
+    case BitUnpackLevel_AVX2:
+      return "avx2";
+    case BitUnpackLevel_AVX512:
+      return "avx512";
+    }
+    return "unknown";
+  }
+
+  static BitUnpackLevel detectBitUnpackLevel() {
+#ifdef ORC_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512bw")) {
+      return BitUnpackLevel_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      return BitUnpackLevel_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+      return BitUnpackLevel_SSE42;
+    }
+#endif
+    return BitUnpackLevel_SCALAR;
+  }
+
+  BitUnpackLevel getBitUnpackLevel() {
+    static const BitUnpackLevel level = detectBitUnpackLevel();
+    return level;
+  }
+
+  template <typename T>
+  static void checkWidth(unsigned int width) {
+    if (width == 0 || width > 8 * sizeof(T)) {
+      throw std::logic_error("bad bit width " + std::to_string(width) +
+                             " for " + std::to_string(8 * sizeof(T)) +
+                             " bit values");
+    }
+  }
+
+  /**
+   * Unpack count values of WIDTH bits each. Since the width is a compile
+   * time constant the shifts and masks fold into constants and the byte
+   * loops unroll. This is the reference that the vector kernels are
+   * tested against and it also handles the values after the last full
+   * vector.
+   */
+  template <unsigned int WIDTH, typename T>
+  static void unpackScalar(const unsigned char* input,
+                           unsigned long count,
+                           T* output) {
+    const uint64_t mask = WIDTH == 64 ? ~0UL : (1UL << WIDTH) - 1;
+    if (WIDTH % 8 == 0) {
+      // byte aligned values are plain big-endian integers
+      for (unsigned long i = 0; i < count; ++i) {
+        uint64_t value = 0;
+        for (unsigned int b = 0; b < WIDTH / 8; ++b) {
+          value = value << 8 | *(input++);
+        }
+        output[i] = static_cast<T>(value);
+      }
+    } else if (8 % WIDTH == 0) {
+      // several values per byte
+      const unsigned int perByte = 8 / WIDTH;
+      unsigned long i = 0;
+      for (; i + perByte <= count; i += perByte) {
+        const unsigned int byte = *(input++);
+        for (unsigned int j = 0; j < perByte; ++j) {
+          output[i + j] = static_cast<T>(byte >> (8 - WIDTH * (j + 1)) & mask);
+        }
+      }
+      for (unsigned int j = 0; i < count; ++i, ++j) {
+        output[i] = static_cast<T>(*input >> (8 - WIDTH * (j + 1)) & mask);
+      }
+    } else if (WIDTH <= 57) {
+      // the accumulator holds the leftover bits of the last byte and the
+      // bytes of the next value, which fit in 64 bits
+      uint64_t buffer = 0;
+      unsigned int bits = 0;
+      for (unsigned long i = 0; i < count; ++i) {
+        while (bits < WIDTH) {
+          buffer = buffer << 8 | *(input++);
+          bits += 8;
+        }
+        bits -= WIDTH;
+        output[i] = static_cast<T>(buffer >> bits & mask);
+        buffer &= (1UL << bits) - 1;
+      }
+    } else {
+      // wider values are assembled from the leftover bits, the whole
+      // bytes and the top of the last byte
+      uint64_t buffer = 0;
+      unsigned int bits = 0;
+      for (unsigned long i = 0; i < count; ++i) {
+        uint64_t value = buffer;
+        unsigned int needed = WIDTH - bits;
+        while (needed >= 8) {
+          value = value << 8 | *(input++);
+          needed -= 8;
+        }
+        if (needed > 0) {
+          const unsigned int byte = *(input++);
+          value = value << needed | byte >> (8 - needed);
+          bits = 8 - needed;
+          buffer = byte & ((1U << bits) - 1);
+        } else {
+          bits = 0;
+          buffer = 0;
+        }
+        output[i] = static_cast<T>(value);
+      }
+    }
+  }
+
+  template <typename T>
+  struct ScalarKernels {
+    typedef void (*Function)(const unsigned char*, unsigned long, T*);
+
+    template <unsigned int WIDTH, bool DONE = WIDTH == 0>
+    struct Filler {
+      static void fill(Function* table) {
+        table[WIDTH] = &unpackScalar<WIDTH, T>;
+        Filler<WIDTH - 1>::fill(table);
+      }
+    };
+
+    template <bool DONE>
+    struct Filler<0, DONE> {
+      static void fill(Function* table) {
+        table[0] = nullptr;
+      }
+    };
+
+    Function table[8 * sizeof(T) + 1];
+
+    ScalarKernels() {
+      Filler<8 * sizeof(T)>::fill(table);
+    }
+  };
+
+  template <typename T>
+  static void unpackScalar(const unsigned char* input,
+                           unsigned long count,
+                           unsigned int width,
+                           T* output) {
+    static const ScalarKernels<T> kernels;
+    kernels.table[width](input, count, output);
+  }
+
+#ifdef ORC_X86_KERNELS
+
+  /**
+   * The vector kernels read a 4 or 8 byte window for each value, so the
+   * values at the end of the input are left to the scalar kernels. The
+   * vector part is a multiple of 16 values, which keeps the remainder
+   * byte aligned.
+   * @return the number of values that the vector kernels can unpack
+   */
+  static unsigned long getVectorCount(unsigned long count,
+                                      unsigned int width,
+                                      unsigned int windowBytes) {
+    const unsigned long length = getPackedLength(count, width);
+    unsigned long result = count / 16 * 16;
+    while (result > 0 &&
+           (result - 1) * width / 8 + windowBytes > length) {
+      result -= 16;
+    }
+    return result;
+  }
+
+  // Every kernel handles 8 or 16 values per step, which is a whole number
+  // of bytes, so the byte offset and shift of each lane within a step are
+  // the same for every step. Each lane loads a big-endian window at its
+  // byte offset, shifts its first bit to the top and shifts the value down.
+
+  // the 64 bit lanes are stored straight into the long outputs
+  static_assert(sizeof(long) == 8, "the 64 bit kernels need 64 bit longs");
+
+  ORC_TARGET("sse4.2")
+  static void store4(__m128i values, long* output) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output),
+                     _mm_cvtepu32_epi64(values));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2),
+                     _mm_cvtepu32_epi64(_mm_srli_si128(values, 8)));
+  }
+
+  ORC_TARGET("sse4.2")
+  static void store4(__m128i values, int32_t* output) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), values);
+  }
+
+  ORC_TARGET("sse4.2")
+  static void store4(__m128i values, int16_t* output) {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(output),
+                     _mm_packus_epi32(values, values));
+  }
+
+  ORC_TARGET("sse4.2")
+  static void store4(__m128i values, int8_t* output) {
+    const __m128i lowBytes = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1,
+                                           -1, -1, -1, -1, -1, -1, -1, -1);
+    int32_t bytes = _mm_cvtsi128_si32(_mm_shuffle_epi8(values, lowBytes));
+    memcpy(output, &bytes, sizeof(bytes));
+  }
+
+  /**
+   * Unpack widths up to 25 bits with 32 bit lanes. SSE has neither gathers
+   * nor per lane shifts, so the windows are loaded one at a time and the
+   * left shift is a multiply.
+   */
+  template <typename T>
+  ORC_TARGET("sse4.2")
+  static void unpack32Sse42(const unsigned char* input,
+                            unsigned long count,
+                            unsigned int width,
+                            T* output) {
+    unsigned int offsets[8];
+    int32_t multipliers[8];
+    for (unsigned int lane = 0; lane < 8; ++lane) {
+      offsets[lane] = lane * width / 8;
+      multipliers[lane] = 1 << (lane * width % 8);
+    }
+    const __m128i low = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(multipliers));
+    const __m128i high = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(multipliers + 4));
+    const __m128i swap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                       11, 10, 9, 8, 15, 14, 13, 12);
+    const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(32 - width));
+    for (unsigned long i = 0; i < count; i += 8, input += width) {
+      int32_t windows[8];
+      for (unsigned int lane = 0; lane < 8; ++lane) {
+        memcpy(windows + lane, input + offsets[lane], sizeof(int32_t));
+      }
+      __m128i first = _mm_loadu_si128(reinterpret_cast<__m128i*>(windows));
+      __m128i second =
+          _mm_loadu_si128(reinterpret_cast<__m128i*>(windows + 4));
+      first = _mm_shuffle_epi8(first, swap);
+      second = _mm_shuffle_epi8(second, swap);
+      first = _mm_srl_epi32(_mm_mullo_epi32(first, low), shift);
+      second = _mm_srl_epi32(_mm_mullo_epi32(second, high), shift);
+      store4(first, output + i);
+      store4(second, output + i + 4);
+    }
+  }
+
+  ORC_TARGET("sse4.2")
+  static void store2(__m128i values, long* output) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), values);
+  }
+
+  ORC_TARGET("sse4.2")
+  static void store2(__m128i values, int32_t* output) {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(output),
+                     _mm_shuffle_epi32(values, _MM_SHUFFLE(2, 0, 2, 0)));
+  }
+
+  /**
+   * Unpack wider values with 64 bit lanes. The per lane shift is two
+   * shifts and a blend.
+   */
+  template <typename T>
+  ORC_TARGET("sse4.2")
+  static void unpack64Sse42(const unsigned char* input,
+                            unsigned long count,
+                            unsigned int width,
+                            T* output) {
+    unsigned int offsets[8];
+    __m128i shifts[8];
+    for (unsigned int lane = 0; lane < 8; ++lane) {
+      offsets[lane] = lane * width / 8;
+      shifts[lane] = _mm_cvtsi32_si128(static_cast<int>(lane * width % 8));
+    }
+    const __m128i swap = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+                                       15, 14, 13, 12, 11, 10, 9, 8);
+    const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(64 - width));
+    for (unsigned long i = 0; i < count; i += 8, input += width) {
+      int64_t windows[8];
+      for (unsigned int lane = 0; lane < 8; ++lane) {
+        memcpy(windows + lane, input + offsets[lane], sizeof(int64_t));
+      }
+      for (unsigned int lane = 0; lane < 8; lane += 2) {
+        __m128i values = _mm_shuffle_epi8(
+            _mm_loadu_si128(reinterpret_cast<__m128i*>(windows + lane)),
+            swap);
+        values = _mm_blend_epi16(_mm_sll_epi64(values, shifts[lane]),
+                                 _mm_sll_epi64(values, shifts[lane + 1]),
+                                 0xf0);
+        store2(_mm_srl_epi64(values, shift), output + i + lane);
+      }
+    }
+  }
+
+  ORC_TARGET("avx2")
+  static void store8(__m256i values, long* output) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output),
+                        _mm256_cvtepu32_epi64(
+                            _mm256_castsi256_si128(values)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 4),
+                        _mm256_cvtepu32_epi64(
+                            _mm256_extracti128_si256(values, 1)));
+  }
+
+  ORC_TARGET("avx2")
+  static void store8(__m256i values, int32_t* output) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), values);
+  }
+
+  ORC_TARGET("avx2")
+  static void store8(__m256i values, int16_t* output) {
+    const __m256i lowHalves = _mm256_setr_epi8(
+        0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    values = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(values, lowHalves),
+                                      _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output),
+                     _mm256_castsi256_si128(values));
+  }
+
+  ORC_TARGET("avx2")
+  static void store8(__m256i values, int8_t* output) {
+    const __m256i lowBytes = _mm256_setr_epi8(
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    values = _mm256_permutevar8x32_epi32(
+        _mm256_shuffle_epi8(values, lowBytes),
+        _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(output),
+                     _mm256_castsi256_si128(values));
+  }
+
+  /**
+   * Unpack widths up to 25 bits with a gather of 8 32 bit windows.
+   */
+  template <typename T>
+  ORC_TARGET("avx2")
+  static void unpack32Avx2(const unsigned char* input,
+                           unsigned long count,
+                           unsigned int width,
+                           T* output) {
+    const int w = static_cast<int>(width);
+    const __m256i bits = _mm256_setr_epi32(0, w, 2 * w, 3 * w, 4 * w,
+                                           5 * w, 6 * w, 7 * w);
+    const __m256i offsets = _mm256_srli_epi32(bits, 3);
+    const __m256i shifts = _mm256_and_si256(bits, _mm256_set1_epi32(7));
+    const __m256i swap = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m128i shift = _mm_cvtsi32_si128(32 - w);
+    for (unsigned long i = 0; i < count; i += 8, input += width) {
+      __m256i values = _mm256_i32gather_epi32(
+          reinterpret_cast<const int*>(input), offsets, 1);
+      values = _mm256_sllv_epi32(_mm256_shuffle_epi8(values, swap), shifts);
+      store8(_mm256_srl_epi32(values, shift), output + i);
+    }
+  }
+
+  ORC_TARGET("avx2")
+  static void store4x64(__m256i values, long* output) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), values);
+  }
+
+  ORC_TARGET("avx2")
+  static void store4x64(__m256i values, int32_t* output) {
+    values = _mm256_permutevar8x32_epi32(
+        values, _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output),
+                     _mm256_castsi256_si128(values));
+  }
+
+  /**
+   * Unpack wider values with gathers of 4 64 bit windows.
+   */
+  template <typename T>
+  ORC_TARGET("avx2")
+  static void unpack64Avx2(const unsigned char* input,
+                           unsigned long count,
+                           unsigned int width,
+                           T* output) {
+    const long long w = width;
+    const __m256i lowBits = _mm256_setr_epi64x(0, w, 2 * w, 3 * w);
+    const __m256i highBits = _mm256_add_epi64(lowBits,
+                                              _mm256_set1_epi64x(4 * w));
+    const __m256i lowOffsets = _mm256_srli_epi64(lowBits, 3);
+    const __m256i highOffsets = _mm256_srli_epi64(highBits, 3);
+    const __m256i seven = _mm256_set1_epi64x(7);
+    const __m256i lowShifts = _mm256_and_si256(lowBits, seven);
+    const __m256i highShifts = _mm256_and_si256(highBits, seven);
+    const __m256i swap = _mm256_setr_epi8(
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(64 - width));
+    for (unsigned long i = 0; i < count; i += 8, input += width) {
+      const long long* base = reinterpret_cast<const long long*>(input);
+      __m256i low = _mm256_i64gather_epi64(base, lowOffsets, 1);
+      __m256i high = _mm256_i64gather_epi64(base, highOffsets, 1);
+      low = _mm256_sllv_epi64(_mm256_shuffle_epi8(low, swap), lowShifts);
+      high = _mm256_sllv_epi64(_mm256_shuffle_epi8(high, swap), highShifts);
+      store4x64(_mm256_srl_epi64(low, shift), output + i);
+      store4x64(_mm256_srl_epi64(high, shift), output + i + 4);
+    }
+  }
+
+  ORC_TARGET("avx512f,avx512bw")
+  static void store16(__m512i values, long* output) {
+    _mm512_storeu_si512(output, _mm512_cvtepu32_epi64(
+                                    _mm512_castsi512_si256(values)));
+    _mm512_storeu_si512(output + 8, _mm512_cvtepu32_epi64(
+                                        _mm512_extracti64x4_epi64(values, 1)));
+  }
+
+  ORC_TARGET("avx512f,avx512bw")
+  static void store16(__m512i values, int32_t* output) {
+    _mm512_storeu_si512(output, values);
+  }
+
+  ORC_TARGET("avx512f,avx512bw")
+  static void store16(__m512i values, int16_t* output) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output),
+                        _mm512_cvtepi32_epi16(values));
+  }
+
+  ORC_TARGET("avx512f,avx512bw")
+  static void store16(__m512i values, int8_t* output) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output),
+                     _mm512_cvtepi32_epi8(values));
+  }
+
+  /**
+   * Unpack widths up to 25 bits with a gather of 16 32 bit windows.
+   */
+  template <typename T>
+  ORC_TARGET("avx512f,avx512bw")
+  static void unpack32Avx512(const unsigned char* input,
+                             unsigned long count,
+                             unsigned int width,
+                             T* output) {
+    const __m512i bits = _mm512_mullo_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                          8, 9, 10, 11, 12, 13, 14, 15),
+        _mm512_set1_epi32(static_cast<int>(width)));
+    const __m512i offsets = _mm512_srli_epi32(bits, 3);
+    const __m512i shifts = _mm512_and_si512(bits, _mm512_set1_epi32(7));
+    const __m512i swap = _mm512_set4_epi32(0x0c0d0e0f, 0x08090a0b,
+                                           0x04050607, 0x00010203);
+    const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(32 - width));
+    for (unsigned long i = 0; i < count; i += 16, input += 2 * width) {
+      __m512i values = _mm512_i32gather_epi32(offsets, input, 1);
+      values = _mm512_sllv_epi32(_mm512_shuffle_epi8(values, swap), shifts);
+      store16(_mm512_srl_epi32(values, shift), output + i);
+    }
+  }
+
+  ORC_TARGET("avx512f,avx512bw")
+  static void store8x64(__m512i values, long* output) {
+    _mm512_storeu_si512(output, values);
+  }
+
+  ORC_TARGET("avx512f,avx512bw")
+  static void store8x64(__m512i values, int32_t* output) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output),
+                        _mm512_cvtepi64_epi32(values));
+  }
+
+  /**
+   * Unpack wider values with a gather of 8 64 bit windows.
+   */
+  template <typename T>
+  ORC_TARGET("avx512f,avx512bw")
+  static void unpack64Avx512(const unsigned char* input,
+                             unsigned long count,
+                             unsigned int width,
+                             T* output) {
+    const long long w = width;
+    const __m512i bits = _mm512_setr_epi64(0, w, 2 * w, 3 * w, 4 * w, 5 * w,
+                                           6 * w, 7 * w);
+    const __m512i offsets = _mm512_srli_epi64(bits, 3);
+    const __m512i shifts = _mm512_and_si512(bits, _mm512_set1_epi64(7));
+    const __m512i swap = _mm512_set4_epi32(0x08090a0b, 0x0c0d0e0f,
+                                           0x00010203, 0x04050607);
+    const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(64 - width));
+    for (unsigned long i = 0; i < count; i += 8, input += width) {
+      __m512i values = _mm512_i64gather_epi64(offsets, input, 1);
+      values = _mm512_sllv_epi64(_mm512_shuffle_epi8(values, swap), shifts);
+      store8x64(_mm512_srl_epi64(values, shift), output + i);
+    }
+  }
+
+  /**
+   * The 64 bit lane kernels only produce 64 and 32 bit outputs, since the
+   * narrower outputs never have more than 25 bits.
+   */
+  template <typename T>
+  static unsigned long unpackWide(const unsigned char*, unsigned long,
+                                  unsigned int, T*, BitUnpackLevel) {
+    return 0;
+  }
+
+  template <typename T>
+  static unsigned long unpackWideValues(const unsigned char* input,
+                                        unsigned long count,
+                                        unsigned int width,
+                                        T* output,
+                                        BitUnpackLevel level) {
+    // the window must hold the value after shifting out up to 7 bits
+    if (width > 57 && width != 64) {
+      return 0;
+    }
+    const unsigned long vectorCount = getVectorCount(count, width, 8);
+    if (vectorCount == 0) {
+      return 0;
+    }
+    switch (level) {
+    case BitUnpackLevel_AVX512:
+      unpack64Avx512(input, vectorCount, width, output);
+      break;
+    case BitUnpackLevel_AVX2:
+      unpack64Avx2(input, vectorCount, width, output);
+      break;
+    default:
+      unpack64Sse42(input, vectorCount, width, output);
+      break;
+    }
+    return vectorCount;
+  }
+
+  static unsigned long unpackWide(const unsigned char* input,
+                                  unsigned long count,
+                                  unsigned int width,
+                                  long* output,
+                                  BitUnpackLevel level) {
+    return unpackWideValues(input, count, width, output, level);
+  }
+
+  static unsigned long unpackWide(const unsigned char* input,
+                                  unsigned long count,
+                                  unsigned int width,
+                                  int32_t* output,
+                                  BitUnpackLevel level) {
+    return unpackWideValues(input, count, width, output, level);
+  }
+
+  /**
+   * Unpack as many values as possible with the vector kernels.
+   * @return the number of values unpacked
+   */
+  template <typename T>
+  static unsigned long unpackVector(const unsigned char* input,
+                                    unsigned long count,
+                                    unsigned int width,
+                                    T* output,
+                                    BitUnpackLevel level) {
+    if (width > 25) {
+      return unpackWide(input, count, width, output, level);
+    }
+    const unsigned long vectorCount = getVectorCount(count, width, 4);
+    if (vectorCount == 0) {
+      return 0;
+    }
+    switch (level) {
+    case BitUnpackLevel_AVX512:
+      unpack32Avx512(input, vectorCount, width, output);
+      break;
+    case BitUnpackLevel_AVX2:
+      unpack32Avx2(input, vectorCount, width, output);
+      break;
+    default:
+      unpack32Sse42(input, vectorCount, width, output);
+      break;
+    }
+    return vectorCount;
+  }
+#endif
+
+  template <typename T>
+  static void unpackValues(const unsigned char* input,
+                           unsigned long count,
+                           unsigned int width,
+                           T* output,
+                           BitUnpackLevel level) {
+    checkWidth<T>(width);
+    unsigned long done = 0;
+#ifdef ORC_X86_KERNELS
+    level = std::min(level, getBitUnpackLevel());
+    if (level != BitUnpackLevel_SCALAR) {
+      done = unpackVector(input, count, width, output, level);
+    }
+#else
+    (void) level;
+#endif
+    if (done < count) {
+      unpackScalar(input + done * width / 8, count - done, width,
+                   output + done);
+    }
+  }
+
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, long* output) {
+    unpackValues(input, count, width, output, getBitUnpackLevel());
+  }
+
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int32_t* output) {
+    unpackValues(input, count, width, output, getBitUnpackLevel());
+  }
+
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int16_t* output) {
+    unpackValues(input, count, width, output, getBitUnpackLevel());
+  }
+
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int8_t* output) {
+    unpackValues(input, count, width, output, getBitUnpackLevel());
+  }
+
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, long* output, BitUnpackLevel level) {
+    unpackValues(input, count, width, output, level);
+  }
+
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int32_t* output, BitUnpackLevel level) {
+    unpackValues(input, count, width, output, level);
+  }
+
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int16_t* output, BitUnpackLevel level) {
+    unpackValues(input, count, width, output, level);
+  }
+
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int8_t* output, BitUnpackLevel level) {
+    unpackValues(input, count, width, output, level);
+  }
+
+  template <typename T>
+  static unsigned long packValues(const T* values,
+                                  unsigned long count,
+                                  unsigned int width,
+                                  unsigned char* output) {
+    checkWidth<T>(width);
+    unsigned char* const start = output;
+    unsigned int current = 0;
+    unsigned int used = 0;
+    for (unsigned long i = 0; i < count; ++i) {
+      const uint64_t value = static_cast<uint64_t>(values[i]);
+      unsigned int remaining = width;
+      while (remaining > 0) {
+        const unsigned int taken = std::min(8 - used, remaining);
+        remaining -= taken;
+        current |= static_cast<unsigned int>(
+            value >> remaining & ((1U << taken) - 1)) << (8 - used - taken);
+        used += taken;
+        if (used == 8) {
+          *(output++) = static_cast<unsigned char>(current);
+          current = 0;
+          used = 0;
+        }
+      }
+    }
+    if (used > 0) {
+      *(output++) = static_cast<unsigned char>(current);
+    }
+    return static_cast<unsigned long>(output - start);
+  }
+
+  unsigned long packBits(const long* values, unsigned long count,
+                         unsigned int width, unsigned char* output) {
+    return packValues(values, count, width, output);
+  }
+
+  unsigned long packBits(const int32_t* values, unsigned long count,
+                         unsigned int width, unsigned char* output) {
+    return packValues(values, count, width, output);
+  }
+
+  unsigned long packBits(const int16_t* values, unsigned long count,
+                         unsigned int width, unsigned char* output) {
+    return packValues(values, count, width, output);
+  }
+
+  unsigned long packBits(const int8_t* values, unsigned long count,
+                         unsigned int width, unsigned char* output) {
+    return packValues(values, count, width, output);
+  }
+}
@@ -0,0 +1,110 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ORC_BITUNPACK_HH
+#define ORC_BITUNPACK_HH
+
+#include <stdint.h>
+
+namespace orc {
+
+  /**
+   * The instruction sets that the bit packing kernels can use, from the
+   * slowest to the fastest.
+   */
+  enum BitUnpackLevel {
+    BitUnpackLevel_SCALAR = 0,
+    BitUnpackLevel_SSE42 = 1,
+    BitUnpackLevel_AVX2 = 2,
+    BitUnpackLevel_AVX512 = 3
+  };
+
+  /**
+   * Get the fastest level that this CPU supports. It is detected the first
+   * time that it is needed.
+   */
+  BitUnpackLevel getBitUnpackLevel();
+
+  /**
+   * Get the name of a level for messages.
+   */
+  const char* getBitUnpackLevelName(BitUnpackLevel level);
+
+  /**
+   * Get the number of bytes that count packed values of the given width
+   * take.
+   */
+  inline unsigned long getPackedLength(unsigned long count,
+                                       unsigned int width) {
+    return (count * width + 7) / 8;
+  }
+
+  /**
+   * Unpack values that were packed most significant bit first without any
+   * padding between them, which is how ORC stores fixed width integers
+   * and booleans. Narrower values are zero extended into the output and
+   * values as wide as the output keep their bits unchanged.
+   * @param input the packed bytes, which must be at least
+   *    getPackedLength(count, width) long
+   * @param count the number of values to unpack
+   * @param width the number of bits per value, from 1 to the number of
+   *    bits in the output type
+   * @param output the array to unpack into
+   */
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, long* output);
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int32_t* output);
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int16_t* output);
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int8_t* output);
+
+  /**
+   * Unpack values with the kernels of a given level. Levels above
+   * getBitUnpackLevel() are limited to it.
+   */
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, long* output, BitUnpackLevel level);
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int32_t* output, BitUnpackLevel level);
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int16_t* output, BitUnpackLevel level);
+  void unpackBits(const unsigned char* input, unsigned long count,
+                  unsigned int width, int8_t* output, BitUnpackLevel level);
+
+  /**
+   * Pack the low width bits of each value most significant bit first.
+   * @param values the values to pack
+   * @param count the number of values
+   * @param width the number of bits per value
+   * @param output the buffer to pack into, which must be at least
+   *    getPackedLength(count, width) long
+   * @return the number of bytes written
+   */
+  unsigned long packBits(const long* values, unsigned long count,
+                         unsigned int width, unsigned char* output);
+  unsigned long packBits(const int32_t* values, unsigned long count,
+                         unsigned int width, unsigned char* output);
+  unsigned long packBits(const int16_t* values, unsigned long count,
+                         unsigned int width, unsigned char* output);
+  unsigned long packBits(const int8_t* values, unsigned long count,
+                         unsigned int width, unsigned char* output);
+}
+
+#endif
@@ -0,0 +1,250 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "orc/OrcFile.hh"
+#include "Exceptions.hh"
+#include "LruCache.hh"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+#include <utility>
+
+namespace orc {
+
+  typedef std::shared_ptr<const std::vector<char> > Block;
+
+  static unsigned long weighBlock(const Block& block) {
+    return block->size();
+  }
+
+  struct BlockCachePrivate {
+    unsigned long blockSize;
+    LruCache<std::string, Block> blocks;
+
+    BlockCachePrivate(unsigned long capacity, unsigned long _blockSize
+                      ): blockSize(_blockSize),
+                         blocks(capacity, weighBlock) {
+      // PASS
+    }
+  };
+
+  BlockCache::BlockCache(unsigned long capacity,
+                         unsigned long blockSize
+                         ): privateBits(new BlockCachePrivate(capacity,
+                                                              blockSize)) {
+    if (blockSize == 0) {
+      throw std::logic_error("block size must be positive");
+    }
+  }
+
+  BlockCache::~BlockCache() {
+    // PASS
+  }
+
+  unsigned long BlockCache::getCapacity() const {
+    return privateBits->blocks.getCapacity();
+  }
+
+  unsigned long BlockCache::getBlockSize() const {
+    return privateBits->blockSize;
+  }
+
+  unsigned long BlockCache::size() const {
+    return privateBits->blocks.size();
+  }
+
+  unsigned long BlockCache::getHits() const {
+    return privateBits->blocks.getHits();
+  }
+
+  unsigned long BlockCache::getMisses() const {
+    return privateBits->blocks.getMisses();
+  }
+
+  void BlockCache::clear() {
+    privateBits->blocks.clear();
+  }
+
+  std::shared_ptr<const std::vector<char> >
+      BlockCache::get(const std::string& key) {
+    return privateBits->blocks.get(key);
+  }
+
+  void BlockCache::put(const std::string& key,
+                       std::shared_ptr<const std::vector<char> > block) {
+    privateBits->blocks.put(key, block);
+  }
+
+  class CachedInputStream: public InputStream {
+  private:
+    std::unique_ptr<InputStream> input;
+    std::shared_ptr<BlockCache> cache;
+    unsigned long blockSize;
+    unsigned long totalLength;
+    // the name, length, and modification time of the file
+    std::string fileKey;
+
+    std::string getKey(unsigned long block) const {
+      std::ostringstream key;
+      key << fileKey << block;
+      return key.str();
+    }
+
+  public:
+    CachedInputStream(std::unique_ptr<InputStream> input,
+                      std::shared_ptr<BlockCache> cache);
+    ~CachedInputStream();
+
+    long getLength() const override {
+      return input->getLength();
+    }
+
+    void read(void* buffer, unsigned long offset,
+              unsigned long length) override {
+      readRanges({{buffer, offset, length}});
+    }
+
+    const std::string& getName() const override {
+      return input->getName();
+    }
+
+    const char* getData() const override {
+      return input->getData();
+    }
+
+    long getModificationTime() const override {
+      return input->getModificationTime();
+    }
+
+    void advise(unsigned long offset, unsigned long length,
+                ReadAdvice advice) override {
+      input->advise(offset, length, advice);
+    }
+
+    void readRanges(const std::vector<ReadRequest>& requests) override;
+  };
+
+  CachedInputStream::CachedInputStream(std::unique_ptr<InputStream> _input,
+                                       std::shared_ptr<BlockCache> _cache
+                                       ): input(std::move(_input)),
+                                          cache(_cache),
+                                          blockSize(_cache->getBlockSize()) {
+    totalLength = static_cast<unsigned long>(input->getLength());
+    std::ostringstream key;
+    key << input->getName() << '\0' << totalLength << '\0'
+        << input->getModificationTime() << '\0';
+    fileKey = key.str();
+  }
+
+  CachedInputStream::~CachedInputStream() {
+    // PASS
+  }
+
+  void CachedInputStream::readRanges(const std::vector<ReadRequest>&
+                                       requests) {
+    // without a modification time, the blocks could be stale
+    if (input->getModificationTime() == 0 || input->getData()) {
+      input->readRanges(requests);
+      return;
+    }
+
+    // find the blocks and note the missing ones
+    std::map<unsigned long, std::shared_ptr<const std::vector<char> > > blocks;
+    std::vector<unsigned long> missing;
+    for(const ReadRequest& request: requests) {
+      if (request.length == 0) {
+        continue;
+      }
+      if (request.offset > totalLength ||
+          request.length > totalLength - request.offset) {
+        throw ParseError("Bad read of " + getName());
+      }
+      unsigned long last = (request.offset + request.length - 1) / blockSize;
+      for(unsigned long block = request.offset / blockSize; block <= last;
+          ++block) {
+        if (blocks.find(block) == blocks.end()) {
+          blocks[block] = cache->get(getKey(block));
+          if (!blocks[block]) {
+            missing.push_back(block);
+          }
+        }
+      }
+    }
+
+    // read each run of adjacent missing blocks with one request
+    std::sort(missing.begin(), missing.end());
+    std::vector<ReadRequest> reads;
+    std::vector<std::unique_ptr<char[]> > readBuffers;
+    for(size_t i=0; i < missing.size(); ) {
+      size_t end = i + 1;
+      while (end < missing.size() && missing[end] == missing[end - 1] + 1) {
+        end += 1;
+      }
+      unsigned long offset = missing[i] * blockSize;
+      unsigned long length =
+        std::min(totalLength, missing[end - 1] * blockSize + blockSize) -
+        offset;
+      readBuffers.push_back(std::unique_ptr<char[]>(new char[length]));
+      reads.push_back({readBuffers.back().get(), offset, length});
+      i = end;
+    }
+    if (!reads.empty()) {
+      input->readRanges(reads);
+    }
+    for(size_t i=0; i < reads.size(); ++i) {
+      const char* data = static_cast<const char*>(reads[i].buffer);
+      for(unsigned long position = 0; position < reads[i].length;
+          position += blockSize) {
+        unsigned long block = (reads[i].offset + position) / blockSize;
+        unsigned long size = std::min(blockSize, reads[i].length - position);
+        std::shared_ptr<const std::vector<char> > contents =
+          std::make_shared<const std::vector<char> >(data + position,
+                                                     data + position + size);
+        cache->put(getKey(block), contents);
+        blocks[block] = contents;
+      }
+    }
+
+    // copy the requested bytes out of the blocks
+    for(const ReadRequest& request: requests) {
+      char* output = static_cast<char*>(request.buffer);
+      unsigned long offset = request.offset;
+      unsigned long remaining = request.length;
+      while (remaining > 0) {
+        unsigned long block = offset / blockSize;
+        unsigned long start = offset - block * blockSize;
+        const std::vector<char>& contents = *(blocks[block]);
+        unsigned long size = std::min(remaining, contents.size() - start);
+        memcpy(output, contents.data() + start, size);
+        output += size;
+        offset += size;
+        remaining -= size;
+      }
+    }
+  }
+
+  std::unique_ptr<InputStream>
+      createCachedInputStream(std::unique_ptr<InputStream> input,
+                              std::shared_ptr<BlockCache> cache) {
+    return std::unique_ptr<InputStream>
+      (new CachedInputStream(std::move(input), cache));
+  }
+}
@@ -0,0 +1,184 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BufferPool.hh"
+
+#include <stdlib.h>
+
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace orc {
+
+  // buffers smaller than this are all rounded up to it
+  static const unsigned int MIN_SIZE_CLASS = 12;
+  static const unsigned int SIZE_CLASSES = 64;
+  // buffers start on a page boundary, so that direct reads can go
+  // straight into them
+  static const unsigned long BUFFER_ALIGNMENT = 4096;
+
+  struct BufferPoolPrivate {
+    mutable std::mutex lock;
+    unsigned long maxRetainedBytes;
+    unsigned long retainedBytes;
+    unsigned long allocations;
+    unsigned long reuses;
+    std::vector<char*> freeBuffers[SIZE_CLASSES];
+  };
+
+  /**
+   * Get the power of two that a request is rounded up to.
+   */
+  static unsigned int getSizeClass(unsigned long size) {
+    unsigned int result = MIN_SIZE_CLASS;
+    while (result < SIZE_CLASSES - 1 && (1UL << result) < size) {
+      result += 1;
+    }
+    return result;
+  }
+
+  /**
+   * Allocate a page aligned buffer, which is freed with free.
+   */
+  static char* allocateBuffer(unsigned long size) {
+    void* result;
+    if (posix_memalign(&result, BUFFER_ALIGNMENT, size) != 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<char*>(result);
+  }
+
+  BufferPool::BufferPool(unsigned long maxRetainedBytes
+                         ): privateBits(new BufferPoolPrivate()) {
+    privateBits->maxRetainedBytes = maxRetainedBytes;
+    privateBits->retainedBytes = 0;
+    privateBits->allocations = 0;
+    privateBits->reuses = 0;
+  }
+
+  BufferPool::~BufferPool() {
+    for(unsigned int i=0; i < SIZE_CLASSES; ++i) {
+      for(char* buffer: privateBits->freeBuffers[i]) {
+        free(buffer);
+      }
+    }
+  }
+
+  char* BufferPool::acquire(unsigned long size) {
+    unsigned int sizeClass = getSizeClass(size);
+    {
+      std::lock_guard<std::mutex> guard(privateBits->lock);
+      std::vector<char*>& freeList = privateBits->freeBuffers[sizeClass];
+      if (!freeList.empty()) {
+        char* result = freeList.back();
+        freeList.pop_back();
+        privateBits->retainedBytes -= 1UL << sizeClass;
+        privateBits->reuses += 1;
+        return result;
+      }
+      privateBits->allocations += 1;
+    }
+    return allocateBuffer(1UL << sizeClass);
+  }
+
+  void BufferPool::release(char* buffer, unsigned long size) {
+    if (buffer == nullptr) {
+      return;
+    }
+    unsigned int sizeClass = getSizeClass(size);
+    {
+      std::lock_guard<std::mutex> guard(privateBits->lock);
+      unsigned long bytes = 1UL << sizeClass;
+      if (privateBits->retainedBytes + bytes <=
+            privateBits->maxRetainedBytes) {
+        privateBits->freeBuffers[sizeClass].push_back(buffer);
+        privateBits->retainedBytes += bytes;
+        return;
+      }
+    }
+    free(buffer);
+  }
+
+  unsigned long BufferPool::getRetainedBytes() const {
+    std::lock_guard<std::mutex> guard(privateBits->lock);
+    return privateBits->retainedBytes;
+  }
+
+  unsigned long BufferPool::getAllocationCount() const {
+    std::lock_guard<std::mutex> guard(privateBits->lock);
+    return privateBits->allocations;
+  }
+
+  unsigned long BufferPool::getReuseCount() const {
+    std::lock_guard<std::mutex> guard(privateBits->lock);
+    return privateBits->reuses;
+  }
+
+  PooledBuffer::PooledBuffer(): pool(nullptr), data(nullptr), length(0) {
+    // PASS
+  }
+
+  PooledBuffer::PooledBuffer(BufferPool* _pool, unsigned long size
+                             ): pool(nullptr), data(nullptr), length(0) {
+    reset(_pool, size);
+  }
+
+  PooledBuffer::PooledBuffer(PooledBuffer&& other
+                             ): pool(other.pool),
+                                data(other.data),
+                                length(other.length) {
+    other.data = nullptr;
+    other.length = 0;
+  }
+
+  PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) {
+    if (this != &other) {
+      reset();
+      pool = other.pool;
+      data = other.data;
+      length = other.length;
+      other.data = nullptr;
+      other.length = 0;
+    }
+    return *this;
+  }
+
+  PooledBuffer::~PooledBuffer() {
+    reset();
+  }
+
+  void PooledBuffer::reset(BufferPool* _pool, unsigned long size) {
+    reset();
+    pool = _pool;
+    length = size;
+    data = pool ? pool->acquire(size) : allocateBuffer(size);
+  }
+
+  void PooledBuffer::reset() {
+    if (data) {
+      if (pool) {
+        pool->release(data, length);
+      } else {
+        free(data);
+      }
+    }
+    data = nullptr;
+    length = 0;
+  }
+}
@@ -0,0 +1,67 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ORC_BUFFER_POOL_HH
+#define ORC_BUFFER_POOL_HH
+
+#include "orc/Reader.hh"
+
+namespace orc {
+
+  /**
+   * A buffer that is taken from a BufferPool and given back when it is
+   * destroyed. Without a pool, the memory comes from the heap.
+   */
+  class PooledBuffer {
+  private:
+    BufferPool* pool;
+    char* data;
+    unsigned long length;
+
+  public:
+    PooledBuffer();
+    PooledBuffer(BufferPool* pool, unsigned long size);
+    PooledBuffer(PooledBuffer&& other);
+    PooledBuffer& operator=(PooledBuffer&& other);
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+    ~PooledBuffer();
+
+    /**
+     * Replace the contents with a new buffer.
+     * @param pool the pool to take it from, which may be null
+     * @param size the number of bytes needed
+     */
+    void reset(BufferPool* pool, unsigned long size);
+
+    /**
+     * Give the buffer back.
+     */
+    void reset();
+
+    char* get() const {
+      return data;
+    }
+
+    unsigned long size() const {
+      return length;
+    }
+  };
+}
+
+#endif
@@ -20,9 +20,12 @@
 #include <iostream>
 #include <string.h>
 #include <utility>
+#include <vector>
 
+#include "BitUnpack.hh"
 #include "ByteRLE.hh"
 #include "Exceptions.hh"
+#include "NullExpand.hh"
 
 namespace orc {
 
@@ -32,7 +35,11 @@ namespace orc {
     // PASS
   }
 
-  class ByteRleDecoderImpl: public ByteRleDecoder {
+  BooleanRleDecoder::~BooleanRleDecoder() {
+    // PASS
+  }
+
+  class ByteRleDecoderImpl: public virtual ByteRleDecoder {
   public:
     ByteRleDecoderImpl(std::unique_ptr<SeekableInputStream> input);
 
@@ -57,6 +64,12 @@ namespace orc {
     inline void nextBuffer();
     inline signed char readByte();
     inline void readHeader();
+    inline void readBytes(char* data, unsigned long count);
+
+    /**
+     * Read values without nulls.
+     */
+    void nextValues(char* data, unsigned long numValues);
 
     std::unique_ptr<SeekableInputStream> inputStream;
     size_t remainingValues;
@@ -64,6 +77,8 @@ namespace orc {
     const char* bufferStart;
     const char* bufferEnd;
     bool repeating;
+    // the non-null values of the current batch before they are expanded
+    std::vector<char> nonNulls;
   };
 
   void ByteRleDecoderImpl::nextBuffer() {
@@ -146,13 +161,34 @@ namespace orc {
     }
   }
 
+  void ByteRleDecoderImpl::readBytes(char* data, unsigned long count) {
+    unsigned long i = 0;
+    while (i < count) {
+      if (bufferStart == bufferEnd) {
+        nextBuffer();
+      }
+      unsigned long copyBytes = std::min(count - i,
+                       static_cast<unsigned long>(bufferEnd - bufferStart));
+      memcpy(data + i, bufferStart, copyBytes);
+      bufferStart += copyBytes;
+      i += copyBytes;
+    }
+  }
+
   void ByteRleDecoderImpl::next(char* data, unsigned long numValues,
                                 char* notNull) {
-    unsigned long position = 0;
-    // skip over null values
-    while (notNull && position < numValues && !notNull[position]) {
-      position += 1;
+    if (notNull) {
+      readNonNulls(data, numValues, notNull, nonNulls,
+                   [this](char* values, unsigned long count) {
+                     nextValues(values, count);
+                   });
+    } else {
+      nextValues(data, numValues);
     }
+  }
+
+  void ByteRleDecoderImpl::nextValues(char* data, unsigned long numValues) {
+    unsigned long position = 0;
     while (position < numValues) {
       // if we are out of values, read more
       if (remainingValues == 0) {
@@ -160,48 +196,13 @@ namespace orc {
       }
       // how many do we read out of this block?
       unsigned long count = std::min(numValues - position, remainingValues);
-      unsigned long consumed = 0;
       if (repeating) {
-        if (notNull) {
-          for(unsigned long i=0; i < count; ++i) {
-            if (notNull[position + i]) {
-              data[position + i] = value;
-              consumed += 1;
-            }
-          }
-        } else {
-          memset(data + position, value, count);
-          consumed = count;
-        }
+        memset(data + position, value, count);
       } else {
-        if (notNull) {
-          for(unsigned long i=0; i < count; ++i) {
-            if (notNull[i]) {
-              data[position + i] = readByte();
-              consumed += 1;
-            }
-          }
-        } else {
-          unsigned long i = 0;
-          while (i < count) {
-            if (bufferStart == bufferEnd) {
-              nextBuffer();
-            }
-            unsigned long copyBytes = std::min(count,
-                       static_cast<unsigned long>(bufferEnd - bufferStart));
-            memcpy(data + position + i, bufferStart, copyBytes);
-            bufferStart += copyBytes;
-            i += copyBytes;
-          }
-          consumed = count;
-        }
+        readBytes(data + position, count);
       }
-      remainingValues -= consumed;
+      remainingValues -= count;
       position += count;
-      // skip over any null values
-      while (notNull && position < numValues && !notNull[position]) {
-        position += 1;
-      }
     }
   }
 
@@ -211,7 +212,8 @@ namespace orc {
       (new ByteRleDecoderImpl(std::move(input)));
   }
 
-  class BooleanRleDecoderImpl: public ByteRleDecoderImpl {
+  class BooleanRleDecoderImpl: public ByteRleDecoderImpl,
+                               public BooleanRleDecoder {
   public:
     BooleanRleDecoderImpl(std::unique_ptr<SeekableInputStream> input);
 
@@ -232,9 +234,21 @@ namespace orc {
      */
     virtual void next(char* data, unsigned long numValues, char* notNull);
 
+    /**
+     * Read a number of values packed 8 to a byte.
+     */
+    virtual void nextPacked(unsigned char* data, unsigned long numValues);
+
   protected:
+    /**
+     * Read bits without nulls.
+     */
+    void nextBits(char* data, unsigned long numValues);
+
     size_t remainingBits;
     char lastByte;
+    // the packed bytes of the current batch
+    std::vector<char> packedBits;
   };
 
   BooleanRleDecoderImpl::BooleanRleDecoderImpl
@@ -274,74 +288,81 @@ namespace orc {
 
   void BooleanRleDecoderImpl::next(char* data, unsigned long numValues,
                                    char* notNull) {
+    if (notNull) {
+      // nulls read as false
+      memset(data, 0, numValues);
+      readNonNulls(data, numValues, notNull, nonNulls,
+                   [this](char* values, unsigned long count) {
+                     nextBits(values, count);
+                   });
+    } else {
+      nextBits(data, numValues);
+    }
+  }
+
+  void BooleanRleDecoderImpl::nextBits(char* data, unsigned long numValues) {
     // next spot to fill in
     unsigned long position = 0;
 
     // use up any remaining bits
-    if (notNull) {
-      while(remainingBits > 0 && position < numValues) {
-        if (notNull[position]) {
-          remainingBits -= 1;
-          data[position] = (static_cast<unsigned char>(lastByte) >>
-                            remainingBits) & 0x1;
-        } else {
-          data[position] = 0;
-        }
-        position += 1;
-      }
-    } else {
-      while(remainingBits > 0 && position < numValues) {
-        remainingBits -= 1;
-        data[position++] = (static_cast<unsigned char>(lastByte) >>
-                            remainingBits) & 0x1;
-      }
+    while(remainingBits > 0 && position < numValues) {
+      remainingBits -= 1;
+      data[position++] = (static_cast<unsigned char>(lastByte) >>
+                          remainingBits) & 0x1;
     }
 
-    // count the number of nonNulls remaining
-    unsigned long nonNulls = numValues - position;
-    if (notNull) {
-      for(unsigned long i=position; i < numValues; ++i) {
-        if (!notNull[i]) {
-          nonNulls -= 1;
-        }
-      }
+    // read the new bytes aside and unpack them into the array
+    unsigned long count = numValues - position;
+    if (count > 0) {
+      unsigned long bytesRead = getPackedLength(count, 1);
+      packedBits.resize(bytesRead);
+      ByteRleDecoderImpl::next(packedBits.data(), bytesRead, 0);
+      lastByte = packedBits[bytesRead - 1];
+      remainingBits = bytesRead * 8 - count;
+      unpackBits(reinterpret_cast<const unsigned char*>(packedBits.data()),
+                 count, 1, reinterpret_cast<int8_t*>(data + position));
     }
+  }
 
-    // fill in the remaining values
-    if (nonNulls == 0) {
-      while (position < numValues) {
-	data[position++] = 0;
+  void BooleanRleDecoderImpl::nextPacked(unsigned char* data,
+                                         unsigned long numValues) {
+    const unsigned long fromLast = std::min(numValues,
+                                   static_cast<unsigned long>(remainingBits));
+    const unsigned long count = numValues - fromLast;
+    const unsigned long bytesRead = getPackedLength(count, 1);
+    const unsigned long bytesWritten = getPackedLength(numValues, 1);
+    if (remainingBits == 0) {
+      // the bytes of the stream are already in place
+      ByteRleDecoderImpl::next(reinterpret_cast<char*>(data), bytesRead, 0);
+      if (bytesRead > 0) {
+        lastByte = static_cast<char>(data[bytesRead - 1]);
       }
-    } else if (position < numValues) {
-      // read the new bytes into the array
-      unsigned long bytesRead = (nonNulls + 7) / 8;
-      ByteRleDecoderImpl::next(data + position, bytesRead, 0);
-      lastByte = data[position + bytesRead - 1];
-      remainingBits = bytesRead * 8 - nonNulls;
-      // expand the array backwards so that we don't clobber the data
-      unsigned long bitsLeft = bytesRead * 8 - remainingBits;
-      if (notNull) {
-        for(long i=static_cast<long>(numValues) - 1;
-            i >= static_cast<long>(position); --i) {
-          if (notNull[i]) {
-            unsigned long shiftPosn = (-bitsLeft) % 8;
-            data[i] = (data[position + (bitsLeft - 1) / 8] >> shiftPosn) & 0x1;
-            bitsLeft -= 1;
-          } else {
-            data[i] = 0;
-          }
-        }
-      } else {
-        for(long i=static_cast<long>(numValues) - 1;
-            i >= static_cast<long>(position); --i, --bitsLeft) {
-          unsigned long shiftPosn = (-bitsLeft) % 8;
-          data[i] = (data[position + (bitsLeft - 1) / 8] >> shiftPosn) & 0x1;
-        }
+    } else {
+      // shift the bits left over in the last byte in ahead of the new bytes
+      packedBits.resize(bytesRead + 2);
+      packedBits[0] = lastByte;
+      ByteRleDecoderImpl::next(packedBits.data() + 1, bytesRead, 0);
+      packedBits[bytesRead + 1] = 0;
+      const unsigned int shift = static_cast<unsigned int>(remainingBits);
+      for(unsigned long i=0; i < bytesWritten; ++i) {
+        data[i] = static_cast<unsigned char>(
+          static_cast<unsigned char>(packedBits[i]) << (8 - shift) |
+          static_cast<unsigned char>(packedBits[i + 1]) >> shift);
       }
+      lastByte = packedBits[bytesRead];
+    }
+    if (bytesRead > 0) {
+      remainingBits = bytesRead * 8 - count;
+    } else {
+      remainingBits -= fromLast;
+    }
+    if (numValues % 8 != 0) {
+      data[bytesWritten - 1] &= static_cast<unsigned char>(
+        0xff << (8 - numValues % 8));
     }
   }
 
-  std::unique_ptr<ByteRleDecoder> createBooleanRleDecoder
+  std::unique_ptr<BooleanRleDecoder> createBooleanRleDecoder
                                  (std::unique_ptr<SeekableInputStream> input) {
     return std::unique_ptr<BooleanRleDecoderImpl>
       (new BooleanRleDecoderImpl(std::move(input)));
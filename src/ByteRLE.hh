@@ -49,6 +49,21 @@ namespace orc {
     virtual void next(char* data, unsigned long numValues, char* notNull) = 0;
   };
 
+  class BooleanRleDecoder: public virtual ByteRleDecoder {
+  public:
+    virtual ~BooleanRleDecoder();
+
+    /**
+     * Read a number of values without nulls, packed 8 to a byte with the
+     * first value in the most significant bit as the stream stores them.
+     * The unused bits of the last byte are cleared.
+     * @param data the array to read into, which must be at least
+     *    (numValues + 7) / 8 bytes long
+     * @param numValues the number of values to read
+     */
+    virtual void nextPacked(unsigned char* data, unsigned long numValues) = 0;
+  };
+
   /**
    * Create a byte RLE decoder.
    * @param input the input stream to read from
@@ -64,7 +79,7 @@ namespace orc {
    * processing to properly apply multiple masks from nested types.
    * @param input the input stream to read from
    */
-  std::unique_ptr<ByteRleDecoder> createBooleanRleDecoder
+  std::unique_ptr<BooleanRleDecoder> createBooleanRleDecoder
                                  (std::unique_ptr<SeekableInputStream> input);
 }
 
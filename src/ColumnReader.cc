@@ -16,11 +16,18 @@
  * limitations under the License.
  */
 
+#include "BitUnpack.hh"
 #include "ByteRLE.hh"
 #include "ColumnReader.hh"
 #include "Exceptions.hh"
+#include "Metrics.hh"
+#include "NullExpand.hh"
 #include "RLEs.hh"
 
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
 namespace orc {
 
   StripeStreams::~StripeStreams() {
@@ -37,28 +44,31 @@ namespace orc {
     }
   }
 
+  ColumnReader::ColumnReader(int _columnId): columnId(_columnId) {
+    // PASS
+  }
+
   ColumnReader::~ColumnReader() {
     // PASS
   }
 
   unsigned long ColumnReader::skip(unsigned long numValues) {
-    ByteRleDecoder* decoder = notNullDecoder.get();
+    BooleanRleDecoder* decoder = notNullDecoder.get();
     if (decoder) {
       // page through the values that we want to skip
       // and count how many are non-null
       unsigned long bufferSize = std::min(32768UL, numValues);
-      char* buffer = new char[bufferSize];
+      std::unique_ptr<unsigned char[]> buffer(
+        new unsigned char[getPackedLength(bufferSize, 1)]);
       unsigned long remaining = numValues;
+      unsigned long nonNulls = 0;
       while (remaining > 0) {
         unsigned long chunkSize = std::min(remaining, bufferSize);
-        decoder->next(buffer, chunkSize, 0);
+        decoder->nextPacked(buffer.get(), chunkSize);
         remaining -= chunkSize;
-        for(unsigned long i=0; i < chunkSize; ++i) {
-          if (!buffer[i]) {
-            numValues -= 1;
-          }
-        }
+        nonNulls += countNonNullBits(buffer.get(), chunkSize);
       }
+      return nonNulls;
     }
     return numValues;
   }
@@ -67,19 +77,38 @@ namespace orc {
                           unsigned long numValues,
                           char* incomingMask) {
     rowBatch.numElements = numValues;
-    ByteRleDecoder* decoder = notNullDecoder.get();
+    BooleanRleDecoder* decoder = notNullDecoder.get();
     if (decoder) {
       char* notNullArray = rowBatch.notNull.get();
-      decoder->next(notNullArray, numValues, incomingMask);
-      // check to see if there are nulls in this batch
-      for(unsigned long i=0; i < numValues; ++i) {
-        if (!notNullArray[i]) {
-          rowBatch.hasNulls = true;
-          return;
+      unsigned char* notNullBits = rowBatch.notNullBits.get();
+      if (incomingMask) {
+        // the stream only has values for the parent's non-null rows
+        decoder->next(notNullArray, numValues, incomingMask);
+        rowBatch.nullCount = numValues - countNonNulls(notNullArray,
+                                                       numValues);
+        packBits(reinterpret_cast<const int8_t*>(notNullArray), numValues, 1,
+                 notNullBits);
+      } else {
+        // read the bits as they are stored and only unpack them into
+        // bytes when there are nulls
+        decoder->nextPacked(notNullBits, numValues);
+        rowBatch.nullCount = numValues - countNonNullBits(notNullBits,
+                                                          numValues);
+        if (rowBatch.nullCount != 0) {
+          unpackBits(notNullBits, numValues, 1,
+                     reinterpret_cast<int8_t*>(notNullArray));
+        } else {
+          memset(notNullArray, 1, numValues);
         }
       }
+      rowBatch.hasNulls = rowBatch.nullCount != 0;
+      return;
     }
+    // without a PRESENT stream every value is present
+    memset(rowBatch.notNull.get(), 1, numValues);
+    memset(rowBatch.notNullBits.get(), 0xff, getPackedLength(numValues, 1));
     rowBatch.hasNulls = false;
+    rowBatch.nullCount = 0;
   }
 
   class IntegerColumnReader: public ColumnReader {
@@ -137,10 +166,17 @@ namespace orc {
 
   class StringDictionaryColumnReader: public ColumnReader {
   private:
-    std::unique_ptr<char[]> dictionaryBlob;
-    std::unique_ptr<long[]> dictionaryOffset;
+    // the dictionary stream is kept open when the blob points into it
+    std::unique_ptr<SeekableInputStream> blobStream;
+    PooledBuffer dictionaryBuffer;
+    const char* dictionaryBlob;
+    PooledBuffer dictionaryOffsetBuffer;
+    long* dictionaryOffset;
     std::unique_ptr<RleDecoder> rle;
     unsigned int dictionaryCount;
+    // the non-null values of the current batch before they are expanded
+    std::vector<long> nonNullLengths;
+    std::vector<char*> nonNullStarts;
     
   public:
     StringDictionaryColumnReader(const Type& type, StripeStreams& stipe);
@@ -161,8 +197,9 @@ namespace orc {
       if (!stream->Next(&chunk, &length)) {
         throw ParseError("bad read in readFully");
       }
-      memcpy(buffer + posn, chunk, static_cast<size_t>(length));
-      posn += length;
+      long copyLength = std::min(static_cast<long>(length), bufferSize - posn);
+      memcpy(buffer + posn, chunk, static_cast<size_t>(copyLength));
+      posn += copyLength;
     }
   }
 
@@ -190,18 +227,34 @@ namespace orc {
       createRleDecoder(stripe.getStream(columnId,
                                         proto::Stream_Kind_LENGTH),
                        false, rleVersion);
-    dictionaryOffset = std::unique_ptr<long[]>(new long[dictionaryCount+1]);
-    long* lengthArray = dictionaryOffset.get();
+    dictionaryOffsetBuffer.reset(stripe.getBufferPool(),
+                                 (dictionaryCount + 1) * sizeof(long));
+    dictionaryOffset = reinterpret_cast<long*>(dictionaryOffsetBuffer.get());
+    long* lengthArray = dictionaryOffset;
     lengthDecoder->next(lengthArray + 1, dictionaryCount, 0);
     lengthArray[0] = 0;
     for(unsigned int i=1; i < dictionaryCount + 1; ++i) {
       lengthArray[i] += lengthArray[i-1];
     }
     long blobSize = lengthArray[dictionaryCount];
-    dictionaryBlob = std::unique_ptr<char[]>(new char[blobSize]);
-    std::unique_ptr<SeekableInputStream> blobStream =
-      stripe.getStream(columnId, proto::Stream_Kind_DICTIONARY_DATA);
-    readFully(dictionaryBlob.get(), blobSize, blobStream.get());
+    blobStream = stripe.getStream(columnId,
+                                  proto::Stream_Kind_DICTIONARY_DATA);
+    const void* chunk = nullptr;
+    int chunkLength = 0;
+    if (blobSize > 0 && !blobStream->Next(&chunk, &chunkLength)) {
+      throw ParseError("bad read in readFully");
+    }
+    if (chunkLength >= blobSize) {
+      // the whole dictionary is contiguous in the stream, so use it in place
+      dictionaryBlob = static_cast<const char*>(chunk);
+    } else {
+      dictionaryBuffer.reset(stripe.getBufferPool(),
+                             static_cast<unsigned long>(blobSize));
+      memcpy(dictionaryBuffer.get(), chunk, static_cast<size_t>(chunkLength));
+      readFully(dictionaryBuffer.get() + chunkLength, blobSize - chunkLength,
+                blobStream.get());
+      dictionaryBlob = dictionaryBuffer.get();
+    }
   }
 
   StringDictionaryColumnReader::~StringDictionaryColumnReader() {
@@ -221,21 +274,30 @@ namespace orc {
     // update the notNull from the parent class
     notNull = rowBatch.hasNulls ? rowBatch.notNull.get() : 0;
     StringVectorBatch& byteBatch = dynamic_cast<StringVectorBatch&>(rowBatch);
-    char *blob = dictionaryBlob.get();
-    long *dictionaryOffsets = dictionaryOffset.get();
+    // the batch's strings are read-only views of the dictionary
+    char *blob = const_cast<char*>(dictionaryBlob);
+    long *dictionaryOffsets = dictionaryOffset;
     char **outputStarts = byteBatch.data.get();
     long *outputLengths = byteBatch.length.get();
-    rle->next(outputLengths, numValues, notNull);
     if (notNull) {
-      for(unsigned int i=0; i < numValues; ++i) {
-        if (notNull[i]) {
-          long entry = outputLengths[i];
-          outputStarts[i] = blob + dictionaryOffsets[entry];
-          outputLengths[i] = dictionaryOffsets[entry+1] - 
-            dictionaryOffsets[entry];
-        }
+      // look up the non-null entries densely and then expand them
+      unsigned long nonNullCount = countNonNulls(notNull, numValues);
+      if (nonNullLengths.size() < nonNullCount) {
+        nonNullLengths.resize(nonNullCount);
+        nonNullStarts.resize(nonNullCount);
+      }
+      rle->next(nonNullLengths.data(), nonNullCount, 0);
+      for(unsigned long i=0; i < nonNullCount; ++i) {
+        long entry = nonNullLengths[i];
+        nonNullStarts[i] = blob + dictionaryOffsets[entry];
+        nonNullLengths[i] = dictionaryOffsets[entry+1] -
+          dictionaryOffsets[entry];
       }
+      expandNonNulls(nonNullStarts.data(), notNull, numValues, outputStarts);
+      expandNonNulls(nonNullLengths.data(), notNull, numValues,
+                     outputLengths);
     } else {
+      rle->next(outputLengths, numValues, 0);
       for(unsigned int i=0; i < numValues; ++i) {
         long entry = outputLengths[i];
         outputStarts[i] = blob + dictionaryOffsets[entry];
@@ -316,10 +378,61 @@ namespace orc {
   }
 
   /**
-   * Create a reader for the given stripe.
+   * Wraps another reader to count the values that it returns and the time
+   * that it takes.
    */
-  std::unique_ptr<ColumnReader> buildReader(const Type& type,
-                                            StripeStreams& stripe) {
+  class MeteredColumnReader: public ColumnReader {
+  private:
+    std::unique_ptr<ColumnReader> reader;
+    ColumnMetrics& metrics;
+
+  public:
+    MeteredColumnReader(int columnId,
+                        std::unique_ptr<ColumnReader> reader,
+                        ColumnMetrics& metrics);
+    ~MeteredColumnReader();
+
+    unsigned long skip(unsigned long numValues) override;
+
+    void next(ColumnVectorBatch& rowBatch, 
+              unsigned long numValues,
+              char* notNull) override;
+  };
+
+  MeteredColumnReader::MeteredColumnReader(int _columnId,
+                                           std::unique_ptr<ColumnReader>
+                                             _reader,
+                                           ColumnMetrics& _metrics
+                                           ): ColumnReader(_columnId),
+                                              reader(std::move(_reader)),
+                                              metrics(_metrics) {
+    // PASS
+  }
+
+  MeteredColumnReader::~MeteredColumnReader() {
+    // PASS
+  }
+
+  unsigned long MeteredColumnReader::skip(unsigned long numValues) {
+    unsigned long start = getNanoTime();
+    unsigned long result = reader->skip(numValues);
+    metrics.decodeNanos += getNanoTime() - start;
+    return result;
+  }
+
+  void MeteredColumnReader::next(ColumnVectorBatch& rowBatch, 
+                                 unsigned long numValues,
+                                 char* notNull) {
+    unsigned long start = getNanoTime();
+    reader->next(rowBatch, numValues, notNull);
+    metrics.decodeNanos += getNanoTime() - start;
+    metrics.rows += numValues;
+    metrics.nulls += rowBatch.nullCount;
+  }
+
+  static std::unique_ptr<ColumnReader> buildUnmeteredReader
+                                          (const Type& type,
+                                           StripeStreams& stripe) {
     switch (type.getKind()) {
     case BYTE:
     case SHORT:
@@ -358,4 +471,20 @@ namespace orc {
     throw NotImplementedYet("buildReader unhandled type");
   }
 
+  /**
+   * Create a reader for the given stripe.
+   */
+  std::unique_ptr<ColumnReader> buildReader(const Type& type,
+                                            StripeStreams& stripe) {
+    std::unique_ptr<ColumnReader> result = buildUnmeteredReader(type, stripe);
+    MetricsCollector* metrics = stripe.getMetrics();
+    if (metrics) {
+      int columnId = type.getColumnId();
+      result.reset(new MeteredColumnReader
+                   (columnId, std::move(result),
+                    metrics->columns[static_cast<size_t>(columnId)]));
+    }
+    return result;
+  }
+
 }
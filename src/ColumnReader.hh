@@ -26,6 +26,8 @@
 
 namespace orc {
 
+  struct MetricsCollector;
+
   class StripeStreams {
   public:
     virtual ~StripeStreams();
@@ -48,6 +50,18 @@ namespace orc {
     virtual std::unique_ptr<SeekableInputStream> 
                     getStream(int columnId,
                               proto::Stream_Kind kind) const = 0;
+
+    /**
+     * Get the pool that column readers should take their buffers from.
+     * @return the pool, which may be null
+     */
+    virtual BufferPool* getBufferPool() const = 0;
+
+    /**
+     * Get the counters that column readers should update.
+     * @return the counters, which may be null
+     */
+    virtual MetricsCollector* getMetrics() const = 0;
   };
 
   /**
@@ -55,9 +69,14 @@ namespace orc {
    */
   class ColumnReader {
   protected:
-    std::unique_ptr<ByteRleDecoder> notNullDecoder;
+    std::unique_ptr<BooleanRleDecoder> notNullDecoder;
     int columnId;
 
+    /**
+     * Create a reader that doesn't read a PRESENT stream.
+     */
+    ColumnReader(int columnId);
+
   public:
     ColumnReader(const Type& type, StripeStreams& stipe);
 
@@ -18,11 +18,22 @@
 
 #include "Compression.hh"
 #include "Exceptions.hh"
+#include "Metrics.hh"
 
 #include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
+#include <string.h>
+
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 namespace orc {
 
@@ -74,7 +85,7 @@ namespace orc {
     blockSize = blkSize == -1 ? length : static_cast<unsigned long>(blkSize);
   }
 
-  SeekableArrayInputStream::SeekableArrayInputStream(char* values, 
+  SeekableArrayInputStream::SeekableArrayInputStream(const char* values,
                                                      unsigned long size,
                                                      long blkSize
                                                      ): ownedData(0),
@@ -138,7 +149,8 @@ namespace orc {
   SeekableFileInputStream::SeekableFileInputStream(InputStream* _input,
                                                    unsigned long _offset,
                                                    unsigned long _length,
-                                                   long _blockSize) {
+                                                   long _blockSize,
+                                                   BufferPool* pool) {
     input = _input;
     offset = _offset;
     length = _length;
@@ -146,7 +158,7 @@ namespace orc {
     blockSize = std::min(length,
                          static_cast<unsigned long>(_blockSize < 0 ? 
                                                     256 * 1024 : _blockSize));
-    buffer.reset(new char[blockSize]);
+    buffer.reset(pool, blockSize);
     remainder = 0;
   }
 
@@ -222,19 +234,943 @@ namespace orc {
     return result.str();
   }
 
+  std::unique_ptr<SeekableInputStream>
+     createSeekableFileStream(InputStream* input,
+                              unsigned long offset,
+                              unsigned long length,
+                              long blockSize,
+                              BufferPool* pool) {
+    const char* data = input->getData();
+    if (data) {
+      // the range comes from the file, so check it before using it in place
+      const unsigned long fileLength =
+        static_cast<unsigned long>(input->getLength());
+      if (offset > fileLength || length > fileLength - offset) {
+        std::ostringstream message;
+        message << "stream from " << offset << " for " << length
+                << " is past the end of " << input->getName();
+        throw ParseError(message.str());
+      }
+      // protobuf limits each buffer to an int, but otherwise hand out the
+      // whole range at once so that readers can use it in place
+      unsigned long chunkSize =
+        std::min(length, static_cast<unsigned long>
+                            (std::numeric_limits<int>::max()));
+      return std::unique_ptr<SeekableInputStream>
+        (new SeekableArrayInputStream(data + offset, length,
+                                      static_cast<long>(chunkSize)));
+    }
+    return std::unique_ptr<SeekableInputStream>
+      (new SeekableFileInputStream(input, offset, length, blockSize, pool));
+  }
+
+  // the size of the header at the start of each compression chunk
+  static const unsigned int CHUNK_HEADER_SIZE = 3;
+
+  /**
+   * Parse a chunk header.
+   * @param header the header's bytes
+   * @param isOriginal set to whether the chunk is stored uncompressed
+   * @return the length of the chunk after the header
+   */
+  static unsigned long parseChunkHeader(const unsigned char* header,
+                                        bool& isOriginal) {
+    isOriginal = (header[0] & 1) != 0;
+    return (header[0] | (header[1] << 8) | (header[2] << 16)) >> 1;
+  }
+
+  Decompressor::~Decompressor() {
+    // PASS
+  }
+
+  DecompressionStream::DecompressionStream
+       (std::unique_ptr<SeekableInputStream> _input,
+        unsigned long _bufferSize,
+        std::unique_ptr<Decompressor> _decompressor
+        ): input(std::move(_input)),
+           decompressor(std::move(_decompressor)),
+           bufferSize(_bufferSize),
+           inputPointer(nullptr),
+           inputEnd(nullptr),
+           originalRemaining(0),
+           outputPointer(nullptr),
+           outputRemaining(0),
+           lastSize(0),
+           bytesReturned(0) {
+    // PASS
+  }
+
+  DecompressionStream::~DecompressionStream() {
+    // PASS
+  }
+
+  bool DecompressionStream::fillInput() {
+    while (inputPointer == inputEnd) {
+      const void* data;
+      int size;
+      if (!input->Next(&data, &size)) {
+        return false;
+      }
+      inputPointer = static_cast<const char*>(data);
+      inputEnd = inputPointer + size;
+    }
+    return true;
+  }
+
+  bool DecompressionStream::startChunk() {
+    unsigned char header[CHUNK_HEADER_SIZE];
+    for(unsigned int i=0; i < CHUNK_HEADER_SIZE; ++i) {
+      if (!fillInput()) {
+        if (i == 0) {
+          return false;
+        }
+        throw ParseError("truncated chunk header in " + getName());
+      }
+      header[i] = static_cast<unsigned char>(*(inputPointer++));
+    }
+    bool isOriginal;
+    unsigned long chunkLength = parseChunkHeader(header, isOriginal);
+    if (isOriginal) {
+      // original chunks are handed out from the input's buffers
+      originalRemaining = chunkLength;
+      return true;
+    }
+
+    // use the compressed bytes in place unless they are split up
+    const char* compressed;
+    unsigned long available = static_cast<unsigned long>(inputEnd -
+                                                         inputPointer);
+    if (available >= chunkLength) {
+      compressed = inputPointer;
+      inputPointer += chunkLength;
+    } else {
+      compressedBuffer.resize(chunkLength);
+      unsigned long copied = 0;
+      while (copied < chunkLength) {
+        if (!fillInput()) {
+          throw ParseError("truncated chunk in " + getName());
+        }
+        unsigned long size =
+          std::min(chunkLength - copied,
+                   static_cast<unsigned long>(inputEnd - inputPointer));
+        memcpy(compressedBuffer.data() + copied, inputPointer, size);
+        inputPointer += size;
+        copied += size;
+      }
+      compressed = compressedBuffer.data();
+    }
+    if (outputBuffer.size() < bufferSize) {
+      outputBuffer.resize(bufferSize);
+    }
+    outputPointer = outputBuffer.data();
+    try {
+      outputRemaining = decompressor->decompress(compressed, chunkLength,
+                                                 outputBuffer.data(),
+                                                 bufferSize);
+    } catch (ParseError& err) {
+      throw ParseError(std::string(err.what()) + " in " + getName());
+    }
+    return true;
+  }
+
+  bool DecompressionStream::Next(const void** data, int*size) {
+    while (outputRemaining == 0) {
+      if (originalRemaining == 0) {
+        if (!startChunk()) {
+          *size = 0;
+          return false;
+        }
+      } else {
+        if (!fillInput()) {
+          throw ParseError("truncated chunk in " + getName());
+        }
+        unsigned long size =
+          std::min(originalRemaining,
+                   static_cast<unsigned long>(inputEnd - inputPointer));
+        outputPointer = inputPointer;
+        outputRemaining = size;
+        inputPointer += size;
+        originalRemaining -= size;
+      }
+    }
+    *data = outputPointer;
+    *size = static_cast<int>(outputRemaining);
+    outputPointer += outputRemaining;
+    bytesReturned += outputRemaining;
+    lastSize = outputRemaining;
+    outputRemaining = 0;
+    return true;
+  }
+
+  void DecompressionStream::BackUp(int count) {
+    unsigned long amount = static_cast<unsigned long>(count);
+    if (count < 0 || amount > lastSize - outputRemaining) {
+      throw std::logic_error("can't backup that much!");
+    }
+    outputPointer -= amount;
+    outputRemaining += amount;
+    bytesReturned -= amount;
+  }
+
+  bool DecompressionStream::Skip(int count) {
+    unsigned long remaining = static_cast<unsigned long>(count);
+    while (remaining > 0) {
+      const void* data;
+      int size;
+      if (!Next(&data, &size)) {
+        return false;
+      }
+      unsigned long used = std::min(remaining,
+                                    static_cast<unsigned long>(size));
+      BackUp(static_cast<int>(static_cast<unsigned long>(size) - used));
+      remaining -= used;
+    }
+    return true;
+  }
+
+  google::protobuf::int64 DecompressionStream::ByteCount() const {
+    return static_cast<google::protobuf::int64>(bytesReturned);
+  }
+
+  void DecompressionStream::seek(PositionProvider& position) {
+    input->seek(position);
+    inputPointer = nullptr;
+    inputEnd = nullptr;
+    originalRemaining = 0;
+    outputRemaining = 0;
+    lastSize = 0;
+    unsigned long offset = position.next();
+    if (!Skip(static_cast<int>(offset))) {
+      throw ParseError("seek past the end of " + getName());
+    }
+  }
+
+  std::string DecompressionStream::getName() const {
+    return decompressor->getName() + "(" + input->getName() + ")";
+  }
+
+  std::vector<DecompressedChunk> findChunks(const char* data,
+                                            unsigned long length,
+                                            const std::string& name) {
+    std::vector<DecompressedChunk> result;
+    unsigned long position = 0;
+    while (position < length) {
+      if (length - position < CHUNK_HEADER_SIZE) {
+        throw ParseError("truncated chunk header in " + name);
+      }
+      DecompressedChunk chunk;
+      chunk.compressedOffset = position;
+      chunk.inputLength =
+        parseChunkHeader(reinterpret_cast<const unsigned char*>
+                           (data + position), chunk.isOriginal);
+      position += CHUNK_HEADER_SIZE;
+      if (length - position < chunk.inputLength) {
+        throw ParseError("truncated chunk in " + name);
+      }
+      chunk.input = data + position;
+      position += chunk.inputLength;
+      if (chunk.isOriginal) {
+        chunk.data = chunk.input;
+        chunk.length = chunk.inputLength;
+      } else {
+        chunk.data = nullptr;
+        chunk.length = 0;
+      }
+      result.push_back(std::move(chunk));
+    }
+    return result;
+  }
+
+  void decompressChunk(Decompressor& decompressor,
+                       DecompressedChunk& chunk,
+                       unsigned long bufferSize,
+                       BufferPool* pool,
+                       const std::string& name) {
+    chunk.buffer.reset(pool, bufferSize);
+    try {
+      chunk.length = decompressor.decompress(chunk.input, chunk.inputLength,
+                                             chunk.buffer.get(), bufferSize);
+    } catch (ParseError& err) {
+      throw ParseError(std::string(err.what()) + " in " +
+                       decompressor.getName() + "(" + name + ")");
+    }
+    chunk.data = chunk.buffer.get();
+  }
+
+  DecompressedInputStream::DecompressedInputStream
+       (const std::vector<DecompressedChunk>& _chunks,
+        const std::string& _name
+        ): chunks(_chunks),
+           name(_name),
+           chunk(0),
+           offset(0),
+           lastSize(0),
+           bytesReturned(0) {
+    // PASS
+  }
+
+  DecompressedInputStream::~DecompressedInputStream() {
+    // PASS
+  }
+
+  bool DecompressedInputStream::Next(const void** data, int*size) {
+    while (chunk < chunks.size() && offset == chunks[chunk].length) {
+      chunk += 1;
+      offset = 0;
+    }
+    if (chunk == chunks.size()) {
+      *size = 0;
+      lastSize = 0;
+      return false;
+    }
+    lastSize = chunks[chunk].length - offset;
+    *data = chunks[chunk].data + offset;
+    *size = static_cast<int>(lastSize);
+    offset += lastSize;
+    bytesReturned += lastSize;
+    return true;
+  }
+
+  void DecompressedInputStream::BackUp(int count) {
+    unsigned long amount = static_cast<unsigned long>(count);
+    if (count < 0 || amount > lastSize) {
+      throw std::logic_error("can't backup that much!");
+    }
+    offset -= amount;
+    lastSize -= amount;
+    bytesReturned -= amount;
+  }
+
+  bool DecompressedInputStream::Skip(int count) {
+    unsigned long remaining = static_cast<unsigned long>(count);
+    lastSize = 0;
+    while (remaining > 0) {
+      if (chunk == chunks.size()) {
+        return false;
+      }
+      unsigned long used = std::min(remaining, chunks[chunk].length - offset);
+      offset += used;
+      bytesReturned += used;
+      remaining -= used;
+      if (offset == chunks[chunk].length) {
+        chunk += 1;
+        offset = 0;
+      }
+    }
+    return true;
+  }
+
+  google::protobuf::int64 DecompressedInputStream::ByteCount() const {
+    return static_cast<google::protobuf::int64>(bytesReturned);
+  }
+
+  void DecompressedInputStream::seek(PositionProvider& position) {
+    unsigned long compressedOffset = position.next();
+    auto found =
+      std::lower_bound(chunks.begin(), chunks.end(), compressedOffset,
+                       [](const DecompressedChunk& left, unsigned long right) {
+                         return left.compressedOffset < right;
+                       });
+    chunk = static_cast<unsigned long>(found - chunks.begin());
+    offset = 0;
+    if (chunk < chunks.size() &&
+        chunks[chunk].compressedOffset != compressedOffset) {
+      throw ParseError("seek to the middle of a chunk in " + getName());
+    }
+    if (!Skip(static_cast<int>(position.next()))) {
+      throw ParseError("seek past the end of " + getName());
+    }
+  }
+
+  std::string DecompressedInputStream::getName() const {
+    return "decompressed(" + name + ")";
+  }
+
+  class ZlibDecompressor: public Decompressor {
+  private:
+    z_stream zstream;
+
+  public:
+    ZlibDecompressor();
+    ~ZlibDecompressor() override;
+
+    unsigned long decompress(const char* input,
+                             unsigned long length,
+                             char* output,
+                             unsigned long maxOutputLength) override;
+
+    std::string getName() const override {
+      return "zlib";
+    }
+  };
+
+  ZlibDecompressor::ZlibDecompressor() {
+    memset(&zstream, 0, sizeof(zstream));
+    // ORC stores raw deflate data without the zlib header
+    if (inflateInit2(&zstream, -15) != Z_OK) {
+      throw std::logic_error("can't initialize zlib");
+    }
+  }
+
+  ZlibDecompressor::~ZlibDecompressor() {
+    inflateEnd(&zstream);
+  }
+
+  unsigned long ZlibDecompressor::decompress(const char* input,
+                                             unsigned long length,
+                                             char* output,
+                                             unsigned long
+                                               maxOutputLength) {
+    if (inflateReset(&zstream) != Z_OK) {
+      throw std::logic_error("can't reset zlib");
+    }
+    zstream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(input));
+    zstream.avail_in = static_cast<uInt>(length);
+    zstream.next_out = reinterpret_cast<Bytef*>(output);
+    zstream.avail_out = static_cast<uInt>(maxOutputLength);
+    int result = inflate(&zstream, Z_FINISH);
+    if (result != Z_STREAM_END) {
+      if (result == Z_BUF_ERROR && zstream.avail_out == 0) {
+        throw ParseError("zlib chunk is larger than the buffer");
+      }
+      throw ParseError(std::string("bad zlib data: ") +
+                       (zstream.msg ? zstream.msg : "truncated chunk"));
+    }
+    return zstream.total_out;
+  }
+
+  /**
+   * Copy size bytes that start offset bytes before out to out.
+   * When the ranges overlap, the last offset bytes are repeated.
+   */
+  static void copyBackReference(char* out,
+                                unsigned long offset,
+                                unsigned long size) {
+    const char* from = out - offset;
+    if (offset >= size) {
+      memcpy(out, from, size);
+    } else {
+      for(unsigned long i=0; i < size; ++i) {
+        out[i] = from[i];
+      }
+    }
+  }
+
+  class SnappyDecompressor: public Decompressor {
+  private:
+    void throwCorrupt() const {
+      throw ParseError("bad snappy data");
+    }
+
+  public:
+    SnappyDecompressor();
+    ~SnappyDecompressor() override;
+
+    unsigned long decompress(const char* input,
+                             unsigned long length,
+                             char* output,
+                             unsigned long maxOutputLength) override;
+
+    std::string getName() const override {
+      return "snappy";
+    }
+  };
+
+  SnappyDecompressor::SnappyDecompressor() {
+    // PASS
+  }
+
+  SnappyDecompressor::~SnappyDecompressor() {
+    // PASS
+  }
+
+  /**
+   * Read a little endian integer of the given number of bytes.
+   */
+  static unsigned long readLittleEndian(const unsigned char* input,
+                                        unsigned int bytes) {
+    unsigned long result = 0;
+    for(unsigned int i=0; i < bytes; ++i) {
+      result |= static_cast<unsigned long>(input[i]) << (8 * i);
+    }
+    return result;
+  }
+
+  unsigned long SnappyDecompressor::decompress(const char* input,
+                                               unsigned long length,
+                                               char* output,
+                                               unsigned long
+                                                 maxOutputLength) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(input);
+    const unsigned char* inEnd = in + length;
+
+    // the chunk starts with the uncompressed length as a varint
+    unsigned long outputLength = 0;
+    for(unsigned int shift = 0; ; shift += 7) {
+      if (in == inEnd || shift > 28) {
+        throwCorrupt();
+      }
+      unsigned char byte = *(in++);
+      outputLength |= static_cast<unsigned long>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        break;
+      }
+    }
+    if (outputLength > maxOutputLength) {
+      throw ParseError("snappy chunk is larger than the buffer");
+    }
+
+    // each element is a literal or a copy of earlier output
+    char* out = output;
+    char* outEnd = output + outputLength;
+    while (in < inEnd) {
+      unsigned char tag = *(in++);
+      unsigned long size;
+      unsigned long offset;
+      switch (tag & 3) {
+      case 0: {
+        size = tag >> 2;
+        if (size >= 60) {
+          // the length is in the next 1 to 4 bytes
+          unsigned int bytes = static_cast<unsigned int>(size) - 59;
+          if (static_cast<unsigned long>(inEnd - in) < bytes) {
+            throwCorrupt();
+          }
+          size = readLittleEndian(in, bytes);
+          in += bytes;
+        }
+        size += 1;
+        if (static_cast<unsigned long>(inEnd - in) < size ||
+            static_cast<unsigned long>(outEnd - out) < size) {
+          throwCorrupt();
+        }
+        memcpy(out, in, size);
+        in += size;
+        out += size;
+        continue;
+      }
+      case 1:
+        if (in == inEnd) {
+          throwCorrupt();
+        }
+        size = 4 + ((tag >> 2) & 7);
+        offset = (static_cast<unsigned long>(tag >> 5) << 8) | *(in++);
+        break;
+      case 2:
+        if (inEnd - in < 2) {
+          throwCorrupt();
+        }
+        size = (tag >> 2) + 1UL;
+        offset = readLittleEndian(in, 2);
+        in += 2;
+        break;
+      default:
+        if (inEnd - in < 4) {
+          throwCorrupt();
+        }
+        size = (tag >> 2) + 1UL;
+        offset = readLittleEndian(in, 4);
+        in += 4;
+        break;
+      }
+      if (offset == 0 || offset > static_cast<unsigned long>(out - output) ||
+          size > static_cast<unsigned long>(outEnd - out)) {
+        throwCorrupt();
+      }
+      copyBackReference(out, offset, size);
+      out += size;
+    }
+    if (out != outEnd) {
+      throwCorrupt();
+    }
+    return outputLength;
+  }
+
+  class LzoDecompressor: public Decompressor {
+  private:
+    const unsigned char* in;
+    const unsigned char* inEnd;
+    char* outStart;
+    char* out;
+    char* outEnd;
+
+    void throwCorrupt() const {
+      throw ParseError("bad lzo data");
+    }
+
+    unsigned long readByte() {
+      if (in == inEnd) {
+        throwCorrupt();
+      }
+      return *(in++);
+    }
+
+    /**
+     * Read the extension of a length field, which is a run of zero bytes
+     * that each add 255 followed by a non-zero byte.
+     */
+    unsigned long readLengthExtension() {
+      unsigned long result = 0;
+      unsigned long byte;
+      while ((byte = readByte()) == 0) {
+        result += 255;
+      }
+      return result + byte;
+    }
+
+    void copyLiterals(unsigned long size);
+    void copyMatch(unsigned long distance, unsigned long size);
+
+  public:
+    LzoDecompressor();
+    ~LzoDecompressor() override;
+
+    unsigned long decompress(const char* input,
+                             unsigned long length,
+                             char* output,
+                             unsigned long maxOutputLength) override;
+
+    std::string getName() const override {
+      return "lzo";
+    }
+  };
+
+  LzoDecompressor::LzoDecompressor(): in(nullptr),
+                                      inEnd(nullptr),
+                                      outStart(nullptr),
+                                      out(nullptr),
+                                      outEnd(nullptr) {
+    // PASS
+  }
+
+  LzoDecompressor::~LzoDecompressor() {
+    // PASS
+  }
+
+  void LzoDecompressor::copyLiterals(unsigned long size) {
+    if (static_cast<unsigned long>(inEnd - in) < size) {
+      throwCorrupt();
+    }
+    if (static_cast<unsigned long>(outEnd - out) < size) {
+      throw ParseError("lzo chunk is larger than the buffer");
+    }
+    memcpy(out, in, size);
+    in += size;
+    out += size;
+  }
+
+  void LzoDecompressor::copyMatch(unsigned long distance,
+                                         unsigned long size) {
+    if (distance > static_cast<unsigned long>(out - outStart)) {
+      throwCorrupt();
+    }
+    if (static_cast<unsigned long>(outEnd - out) < size) {
+      throw ParseError("lzo chunk is larger than the buffer");
+    }
+    copyBackReference(out, distance, size);
+    out += size;
+  }
+
+  unsigned long LzoDecompressor::decompress(const char* input,
+                                            unsigned long length,
+                                            char* output,
+                                            unsigned long
+                                              maxOutputLength) {
+    in = reinterpret_cast<const unsigned char*>(input);
+    inEnd = in + length;
+    outStart = output;
+    out = output;
+    outEnd = output + maxOutputLength;
+
+    // LZO1X's meaning of a small instruction depends on what came before
+    // it: 0 after a match with no trailing literals, 1 to 3 after a match
+    // with that many trailing literals, and 4 after a run of literals.
+    unsigned long state = 0;
+    if (in != inEnd && *in > 17) {
+      unsigned long size = readByte() - 17;
+      copyLiterals(size);
+      state = std::min(size, 4UL);
+    }
+    while (true) {
+      unsigned long instruction = readByte();
+      unsigned long distance;
+      unsigned long size;
+      unsigned long trailing;
+      if (instruction < 16) {
+        if (state == 0) {
+          // a run of literals
+          size = instruction;
+          if (size == 0) {
+            size = 15 + readLengthExtension();
+          }
+          copyLiterals(size + 3);
+          state = 4;
+          continue;
+        }
+        distance = 1 + (instruction >> 2) + (readByte() << 2);
+        if (state == 4) {
+          distance += 0x800;
+          size = 3;
+        } else {
+          size = 2;
+        }
+        trailing = instruction & 3;
+      } else if (instruction >= 64) {
+        // a short match within 2k
+        distance = 1 + ((instruction >> 2) & 7) + (readByte() << 3);
+        size = (instruction >> 5) + 1;
+        trailing = instruction & 3;
+      } else {
+        size = instruction & (instruction >= 32 ? 31 : 7);
+        if (size == 0) {
+          size = (instruction >= 32 ? 31 : 7) + readLengthExtension();
+        }
+        size += 2;
+        unsigned long low = readByte();
+        distance = (low >> 2) + (readByte() << 6);
+        trailing = low & 3;
+        if (instruction >= 32) {
+          // a match within 16k
+          distance += 1;
+        } else {
+          // a distant match or the end of the chunk
+          distance += (instruction & 8) << 11;
+          if (distance == 0) {
+            break;
+          }
+          distance += 0x4000;
+        }
+      }
+      copyMatch(distance, size);
+      copyLiterals(trailing);
+      state = trailing;
+    }
+    if (in != inEnd) {
+      throwCorrupt();
+    }
+    return static_cast<unsigned long>(out - output);
+  }
+
+  class Lz4Decompressor: public Decompressor {
+  private:
+    void throwCorrupt() const {
+      throw ParseError("bad lz4 data");
+    }
+
+  public:
+    Lz4Decompressor();
+    ~Lz4Decompressor() override;
+
+    unsigned long decompress(const char* input,
+                             unsigned long length,
+                             char* output,
+                             unsigned long maxOutputLength) override;
+
+    std::string getName() const override {
+      return "lz4";
+    }
+  };
+
+  Lz4Decompressor::Lz4Decompressor() {
+    // PASS
+  }
+
+  Lz4Decompressor::~Lz4Decompressor() {
+    // PASS
+  }
+
+  unsigned long Lz4Decompressor::decompress(const char* input,
+                                            unsigned long length,
+                                            char* output,
+                                            unsigned long
+                                              maxOutputLength) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(input);
+    const unsigned char* inEnd = in + length;
+    char* out = output;
+    char* outEnd = output + maxOutputLength;
+
+    // each sequence is a run of literals and a match, except for the last
+    // one, which only has literals
+    while (in < inEnd) {
+      unsigned long token = *(in++);
+      unsigned long size = token >> 4;
+      if (size == 15) {
+        unsigned long byte;
+        do {
+          if (in == inEnd) {
+            throwCorrupt();
+          }
+          byte = *(in++);
+          size += byte;
+        } while (byte == 255);
+      }
+      if (static_cast<unsigned long>(inEnd - in) < size) {
+        throwCorrupt();
+      }
+      if (static_cast<unsigned long>(outEnd - out) < size) {
+        throw ParseError("lz4 chunk is larger than the buffer");
+      }
+      memcpy(out, in, size);
+      in += size;
+      out += size;
+      if (in == inEnd) {
+        break;
+      }
+
+      if (inEnd - in < 2) {
+        throwCorrupt();
+      }
+      unsigned long offset = readLittleEndian(in, 2);
+      in += 2;
+      size = (token & 15) + 4;
+      if ((token & 15) == 15) {
+        unsigned long byte;
+        do {
+          if (in == inEnd) {
+            throwCorrupt();
+          }
+          byte = *(in++);
+          size += byte;
+        } while (byte == 255);
+      }
+      if (offset == 0 || offset > static_cast<unsigned long>(out - output)) {
+        throwCorrupt();
+      }
+      if (static_cast<unsigned long>(outEnd - out) < size) {
+        throw ParseError("lz4 chunk is larger than the buffer");
+      }
+      copyBackReference(out, offset, size);
+      out += size;
+    }
+    return static_cast<unsigned long>(out - output);
+  }
+
+#ifdef HAVE_ZSTD
+  class ZstdDecompressor: public Decompressor {
+  private:
+    // reused across chunks to avoid reallocating the decoder's tables
+    ZSTD_DCtx* context;
+
+  public:
+    ZstdDecompressor();
+    ~ZstdDecompressor() override;
+
+    unsigned long decompress(const char* input,
+                             unsigned long length,
+                             char* output,
+                             unsigned long maxOutputLength) override;
+
+    std::string getName() const override {
+      return "zstd";
+    }
+  };
+
+  ZstdDecompressor::ZstdDecompressor() {
+    context = ZSTD_createDCtx();
+    if (context == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+
+  ZstdDecompressor::~ZstdDecompressor() {
+    ZSTD_freeDCtx(context);
+  }
+
+  unsigned long ZstdDecompressor::decompress(const char* input,
+                                             unsigned long length,
+                                             char* output,
+                                             unsigned long
+                                               maxOutputLength) {
+    size_t result = ZSTD_decompressDCtx(context, output, maxOutputLength,
+                                        input, length);
+    if (ZSTD_isError(result)) {
+      throw ParseError(std::string("bad zstd data: ") +
+                       ZSTD_getErrorName(result));
+    }
+    return result;
+  }
+#endif
+
+  /**
+   * The factories that were registered at runtime by compression kind.
+   */
+  static std::map<CompressionKind, DecompressorFactory>& getRegistry() {
+    static std::map<CompressionKind, DecompressorFactory> registry;
+    return registry;
+  }
+
+  static std::mutex registryLock;
+
+  void registerDecompressor(CompressionKind kind,
+                            DecompressorFactory factory) {
+    if (kind == CompressionKind_NONE) {
+      throw std::logic_error("can't register a decompressor for NONE");
+    }
+    if (!factory) {
+      throw std::logic_error("can't register an empty decompressor factory");
+    }
+    std::lock_guard<std::mutex> guard(registryLock);
+    getRegistry()[kind] = factory;
+  }
+
+  void unregisterDecompressor(CompressionKind kind) {
+    std::lock_guard<std::mutex> guard(registryLock);
+    getRegistry().erase(kind);
+  }
+
+  std::unique_ptr<Decompressor> createDecompressor(CompressionKind kind) {
+    DecompressorFactory factory;
+    {
+      std::lock_guard<std::mutex> guard(registryLock);
+      auto registered = getRegistry().find(kind);
+      if (registered != getRegistry().end()) {
+        factory = registered->second;
+      }
+    }
+    if (factory) {
+      std::unique_ptr<Decompressor> result = factory();
+      if (!result) {
+        throw std::logic_error("decompressor factory returned nothing");
+      }
+      return result;
+    }
+    switch (kind) {
+    case CompressionKind_ZLIB:
+      return std::unique_ptr<Decompressor>(new ZlibDecompressor());
+    case CompressionKind_SNAPPY:
+      return std::unique_ptr<Decompressor>(new SnappyDecompressor());
+    case CompressionKind_LZO:
+      return std::unique_ptr<Decompressor>(new LzoDecompressor());
+    case CompressionKind_LZ4:
+      return std::unique_ptr<Decompressor>(new Lz4Decompressor());
+    case CompressionKind_ZSTD:
+#ifdef HAVE_ZSTD
+      return std::unique_ptr<Decompressor>(new ZstdDecompressor());
+#else
+      break;
+#endif
+    case CompressionKind_NONE:
+      break;
+    }
+    throw NotImplementedYet("compression codec");
+  }
+
   std::unique_ptr<SeekableInputStream> 
      createCodec(CompressionKind kind,
                  std::unique_ptr<SeekableInputStream> input,
-                 unsigned long) {
-    switch (kind) {
-    case CompressionKind_NONE:
+                 unsigned long bufferSize,
+                 MetricsCollector* metrics) {
+    if (kind == CompressionKind_NONE) {
       return std::move(input);
-    case CompressionKind_LZO:
-    case CompressionKind_SNAPPY:
-    case CompressionKind_ZLIB: {
-      // PASS
     }
+    std::unique_ptr<SeekableInputStream> result
+      (new DecompressionStream(std::move(input), bufferSize,
+                               createDecompressor(kind)));
+    if (metrics) {
+      result.reset(new MeteredSeekableInputStream(std::move(result),
+                                                  *metrics));
     }
-    throw NotImplementedYet("compression codec");
+    return result;
   }
 }
@@ -20,14 +20,18 @@
 #define ORC_COMPRESSION_HH
 
 #include "orc/OrcFile.hh"
+#include "BufferPool.hh"
 #include "wrap/zero-copy-stream-wrapper.h"
 
 #include <initializer_list>
 #include <list>
 #include <memory>
+#include <vector>
 
 namespace orc {
 
+  struct MetricsCollector;
+
   void printBuffer(std::ostream& out,
                    const char *buffer,
                    unsigned long length);
@@ -58,7 +62,7 @@ namespace orc {
   class SeekableArrayInputStream: public SeekableInputStream {
   private:
     std::vector<char> ownedData;
-    char* data;
+    const char* data;
     unsigned long length;
     unsigned long position;
     unsigned long blockSize;
@@ -66,7 +70,7 @@ namespace orc {
   public:
     SeekableArrayInputStream(std::initializer_list<unsigned char> list,
                              long block_size = -1);
-    SeekableArrayInputStream(char* list,
+    SeekableArrayInputStream(const char* list,
                              unsigned long length,
                              long block_size = -1);
     virtual ~SeekableArrayInputStream();
@@ -84,7 +88,7 @@ namespace orc {
   class SeekableFileInputStream: public SeekableInputStream {
   private:
     InputStream* input;
-    std::unique_ptr<char[]> buffer;
+    PooledBuffer buffer;
     unsigned long offset;
     unsigned long length;
     unsigned long position;
@@ -95,7 +99,8 @@ namespace orc {
     SeekableFileInputStream(InputStream* input,
                             unsigned long offset,
                             unsigned long length,
-                            long blockSize = -1);
+                            long blockSize = -1,
+                            BufferPool* pool = nullptr);
     virtual ~SeekableFileInputStream();
 
     virtual bool Next(const void** data, int*size) override;
@@ -107,15 +112,179 @@ namespace orc {
   };
 
   /**
-   * Create a codec for the given compression kind.
+   * Create a decompressor for a compression kind other than NONE. A
+   * registered factory takes precedence over the built-in codec. The
+   * built-in ZSTD is only available when the library was built with zstd.
+   * @throws NotImplementedYet if the kind isn't supported
+   */
+  std::unique_ptr<Decompressor> createDecompressor(CompressionKind kind);
+
+  /**
+   * The stream that decompresses ORC's compression chunks. Each
+   * chunk starts with a 3 byte little endian header that holds the length
+   * of the chunk shifted left one bit and a low bit that is set when the
+   * chunk was stored without compression. Those original chunks are
+   * returned as pointers into the underlying stream, while compressed
+   * chunks are expanded into a buffer that is reused for every chunk.
+   */
+  class DecompressionStream: public SeekableInputStream {
+  private:
+    std::unique_ptr<SeekableInputStream> input;
+    std::unique_ptr<Decompressor> decompressor;
+    unsigned long bufferSize;
+    // the expanded bytes of the current compressed chunk
+    std::vector<char> outputBuffer;
+    // a compressed chunk that is split across the input's buffers
+    std::vector<char> compressedBuffer;
+    // the part of the input's buffer that hasn't been used
+    const char* inputPointer;
+    const char* inputEnd;
+    // the bytes of the current original chunk that are still in the input
+    unsigned long originalRemaining;
+    // the bytes that are ready to be returned by Next
+    const char* outputPointer;
+    unsigned long outputRemaining;
+    // the size of the last buffer returned by Next, which bounds BackUp
+    unsigned long lastSize;
+    unsigned long bytesReturned;
+
+    /**
+     * Make sure that there are input bytes available.
+     * @return false if the input is finished
+     */
+    bool fillInput();
+
+    /**
+     * Read the header of the next chunk and decompress it if needed.
+     * @return false if the input is finished
+     */
+    bool startChunk();
+
+  public:
+    DecompressionStream(std::unique_ptr<SeekableInputStream> input,
+                        unsigned long bufferSize,
+                        std::unique_ptr<Decompressor> decompressor);
+    virtual ~DecompressionStream();
+    virtual bool Next(const void** data, int*size) override;
+    virtual void BackUp(int count) override;
+    virtual bool Skip(int count) override;
+    virtual google::protobuf::int64 ByteCount() const override;
+
+    /**
+     * Seek to a position that is given as the offset of the chunk in the
+     * compressed stream and then the offset of the byte in the chunk.
+     */
+    virtual void seek(PositionProvider& position) override;
+    virtual std::string getName() const override;
+  };
+
+  /**
+   * A chunk of a compressed stream that is in memory, which can be
+   * decompressed ahead of the reader that will use it.
+   */
+  struct DecompressedChunk {
+    // the offset of the chunk's header in the compressed stream
+    unsigned long compressedOffset;
+    // the chunk's bytes after the header
+    const char* input;
+    unsigned long inputLength;
+    bool isOriginal;
+    // the decompressed bytes, which are the input for original chunks
+    const char* data;
+    unsigned long length;
+    // holds the decompressed bytes of a compressed chunk
+    PooledBuffer buffer;
+  };
+
+  /**
+   * Find the chunks of a compressed stream without decompressing them.
+   * @param data the compressed stream
+   * @param length the length of the compressed stream
+   * @param name the name of the stream for error messages
+   * @return the chunks in order, with only the original chunks' data set
+   * @throws ParseError if a chunk runs past the end of the stream
+   */
+  std::vector<DecompressedChunk> findChunks(const char* data,
+                                            unsigned long length,
+                                            const std::string& name);
+
+  /**
+   * Decompress a compressed chunk into a buffer from the pool.
+   * @param decompressor the codec for the chunk
+   * @param chunk the chunk from findChunks to fill in
+   * @param bufferSize the largest size that the chunk can expand to
+   * @param pool the pool to take the buffer from, which may be null
+   * @param name the name of the stream for error messages
+   */
+  void decompressChunk(Decompressor& decompressor,
+                       DecompressedChunk& chunk,
+                       unsigned long bufferSize,
+                       BufferPool* pool,
+                       const std::string& name);
+
+  /**
+   * A stream over chunks that were already decompressed. It returns each
+   * chunk in place and seeks with the same positions as a
+   * DecompressionStream over the compressed bytes.
+   */
+  class DecompressedInputStream: public SeekableInputStream {
+  private:
+    const std::vector<DecompressedChunk>& chunks;
+    std::string name;
+    // the current chunk and the offset of the next byte in it
+    unsigned long chunk;
+    unsigned long offset;
+    unsigned long lastSize;
+    unsigned long bytesReturned;
+
+  public:
+    /**
+     * @param chunks the decompressed chunks, which must outlive the stream
+     * @param name the name of the stream
+     */
+    DecompressedInputStream(const std::vector<DecompressedChunk>& chunks,
+                            const std::string& name);
+    virtual ~DecompressedInputStream();
+    virtual bool Next(const void** data, int*size) override;
+    virtual void BackUp(int count) override;
+    virtual bool Skip(int count) override;
+    virtual google::protobuf::int64 ByteCount() const override;
+    virtual void seek(PositionProvider& position) override;
+    virtual std::string getName() const override;
+  };
+
+  /**
+   * Create a seekable input stream for a range of an input stream. If the
+   * input stream keeps the file in memory, the result returns pointers
+   * straight into that memory instead of copying the bytes into a buffer.
+   * @param input the underlying file
+   * @param offset the first byte of the range
+   * @param length the number of bytes in the range
+   * @param blockSize the buffer size to use when the bytes must be read
+   * @param pool the pool to take the buffer from, which may be null
+   */
+  std::unique_ptr<SeekableInputStream>
+     createSeekableFileStream(InputStream* input,
+                              unsigned long offset,
+                              unsigned long length,
+                              long blockSize = -1,
+                              BufferPool* pool = nullptr);
+
+  /**
+   * Create a codec for the given compression kind using
+   * createDecompressor, which throws NotImplementedYet for kinds that
+   * aren't available.
    * @param kind the compression type to implement
    * @param input the input stream that is the underlying source
    * @param bufferSize the maximum size of the buffer
+   * @param metrics the counters to add the decompression time to, which
+   *    may be null
    */
   std::unique_ptr<SeekableInputStream> 
      createCodec(CompressionKind kind,
                  std::unique_ptr<SeekableInputStream> input,
-                 unsigned long bufferSize);
+                 unsigned long bufferSize,
+                 MetricsCollector* metrics = nullptr);
 }
 
 #endif
@@ -0,0 +1,75 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "orc/Reader.hh"
+#include "LruCache.hh"
+
+namespace orc {
+
+  static unsigned long weighTail(const std::shared_ptr<const FileTail>&) {
+    return 1;
+  }
+
+  struct FileTailCachePrivate {
+    LruCache<std::string, std::shared_ptr<const FileTail> > tails;
+
+    FileTailCachePrivate(unsigned long capacity
+                         ): tails(capacity, weighTail) {
+      // PASS
+    }
+  };
+
+  FileTailCache::FileTailCache(unsigned long capacity
+                               ): privateBits(new FileTailCachePrivate
+                                              (capacity)) {
+    // PASS
+  }
+
+  FileTailCache::~FileTailCache() {
+    // PASS
+  }
+
+  unsigned long FileTailCache::getCapacity() const {
+    return privateBits->tails.getCapacity();
+  }
+
+  unsigned long FileTailCache::size() const {
+    return privateBits->tails.size();
+  }
+
+  unsigned long FileTailCache::getHits() const {
+    return privateBits->tails.getHits();
+  }
+
+  unsigned long FileTailCache::getMisses() const {
+    return privateBits->tails.getMisses();
+  }
+
+  void FileTailCache::clear() {
+    privateBits->tails.clear();
+  }
+
+  std::shared_ptr<const FileTail> FileTailCache::get(const std::string& key) {
+    return privateBits->tails.get(key);
+  }
+
+  void FileTailCache::put(const std::string& key,
+                          std::shared_ptr<const FileTail> tail) {
+    privateBits->tails.put(key, tail);
+  }
+}
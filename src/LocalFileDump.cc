@@ -86,6 +86,10 @@ int main(int argc, char* argv[])
             //codec = SnappyCodec(); break;
         case LZO:
             //codec = LzoCodec(); break;
+        case LZ4:
+            //codec = Lz4Codec(); break;
+        case ZSTD:
+            //codec = ZstdCodec(); break;
         default:
             std::cout << "Unsupported compression!" << std::endl ;
             input.close();
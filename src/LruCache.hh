@@ -0,0 +1,137 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ORC_LRU_CACHE_HH
+#define ORC_LRU_CACHE_HH
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace orc {
+
+  /**
+   * A thread-safe map that drops the least recently used entries once the
+   * weights of its values add up to more than its capacity.
+   */
+  template <typename K, typename V>
+  class LruCache {
+  public:
+    typedef unsigned long (*Weigher)(const V& value);
+
+  private:
+    typedef std::pair<K, V> Entry;
+
+    mutable std::mutex lock;
+    const unsigned long capacity;
+    const Weigher weigh;
+    unsigned long weight;
+    unsigned long hits;
+    unsigned long misses;
+    // the most recently used entries are at the front
+    std::list<Entry> entries;
+    std::unordered_map<K, typename std::list<Entry>::iterator> index;
+
+  public:
+    /**
+     * Create a cache.
+     * @param _capacity the most weight to keep
+     * @param _weigh how much of the capacity a value uses
+     */
+    LruCache(unsigned long _capacity, Weigher _weigh
+             ): capacity(_capacity), weigh(_weigh), weight(0), hits(0),
+                misses(0) {
+      // PASS
+    }
+
+    unsigned long getCapacity() const {
+      return capacity;
+    }
+
+    /**
+     * Get the total weight of the values in the cache.
+     */
+    unsigned long size() const {
+      std::lock_guard<std::mutex> guard(lock);
+      return weight;
+    }
+
+    unsigned long getHits() const {
+      std::lock_guard<std::mutex> guard(lock);
+      return hits;
+    }
+
+    unsigned long getMisses() const {
+      std::lock_guard<std::mutex> guard(lock);
+      return misses;
+    }
+
+    void clear() {
+      std::lock_guard<std::mutex> guard(lock);
+      index.clear();
+      entries.clear();
+      weight = 0;
+    }
+
+    /**
+     * Find the value for a key and mark it as the most recently used.
+     * @return the value or a default constructed one if it isn't cached
+     */
+    V get(const K& key) {
+      std::lock_guard<std::mutex> guard(lock);
+      auto position = index.find(key);
+      if (position == index.end()) {
+        misses += 1;
+        return V();
+      }
+      hits += 1;
+      entries.splice(entries.begin(), entries, position->second);
+      return position->second->second;
+    }
+
+    /**
+     * Add or replace the value for a key. Values that weigh more than the
+     * capacity are not kept.
+     */
+    void put(const K& key, const V& value) {
+      const unsigned long valueWeight = weigh(value);
+      std::lock_guard<std::mutex> guard(lock);
+      if (valueWeight > capacity) {
+        return;
+      }
+      auto position = index.find(key);
+      if (position != index.end()) {
+        weight -= weigh(position->second->second);
+        position->second->second = value;
+        entries.splice(entries.begin(), entries, position->second);
+      } else {
+        entries.push_front(std::make_pair(key, value));
+        index[key] = entries.begin();
+      }
+      weight += valueWeight;
+      while (weight > capacity) {
+        weight -= weigh(entries.back().second);
+        index.erase(entries.back().first);
+        entries.pop_back();
+      }
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,156 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Metrics.hh"
+
+#include <chrono>
+
+namespace orc {
+
+  unsigned long getNanoTime() {
+    return static_cast<unsigned long>
+      (std::chrono::duration_cast<std::chrono::nanoseconds>
+       (std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  MetricsCollector::MetricsCollector(unsigned long columnCount
+                                     ): readCalls(0),
+                                        readBytes(0),
+                                        readNanos(0),
+                                        decompressionNanos(0),
+                                        decompressedBytes(0),
+                                        columns(columnCount,
+                                                ColumnMetrics()) {
+    // PASS
+  }
+
+  ReaderMetrics MetricsCollector::getMetrics() const {
+    ReaderMetrics result;
+    result.readCalls = readCalls;
+    result.readBytes = readBytes;
+    result.readNanos = readNanos;
+    result.decompressionNanos = decompressionNanos;
+    result.decompressedBytes = decompressedBytes;
+    result.columns = columns;
+    return result;
+  }
+
+  MeteredInputStream::MeteredInputStream(std::unique_ptr<InputStream> _input,
+                                         MetricsCollector& _metrics
+                                         ): input(std::move(_input)),
+                                            metrics(_metrics) {
+    // PASS
+  }
+
+  MeteredInputStream::~MeteredInputStream() {
+    // PASS
+  }
+
+  long MeteredInputStream::getLength() const {
+    return input->getLength();
+  }
+
+  void MeteredInputStream::read(void* buffer, unsigned long offset,
+                                unsigned long length) {
+    unsigned long start = getNanoTime();
+    input->read(buffer, offset, length);
+    metrics.readNanos += getNanoTime() - start;
+    metrics.readCalls += 1;
+    metrics.readBytes += length;
+  }
+
+  const std::string& MeteredInputStream::getName() const {
+    return input->getName();
+  }
+
+  const char* MeteredInputStream::getData() const {
+    return input->getData();
+  }
+
+  long MeteredInputStream::getModificationTime() const {
+    return input->getModificationTime();
+  }
+
+  void MeteredInputStream::advise(unsigned long offset, unsigned long length,
+                                  ReadAdvice advice) {
+    input->advise(offset, length, advice);
+  }
+
+  unsigned long MeteredInputStream::getReadAlignment() const {
+    return input->getReadAlignment();
+  }
+
+  void MeteredInputStream::readRanges(const std::vector<ReadRequest>&
+                                        requests) {
+    unsigned long start = getNanoTime();
+    input->readRanges(requests);
+    metrics.readNanos += getNanoTime() - start;
+    for(const ReadRequest& request: requests) {
+      metrics.readCalls += 1;
+      metrics.readBytes += request.length;
+    }
+  }
+
+  MeteredSeekableInputStream::MeteredSeekableInputStream
+       (std::unique_ptr<SeekableInputStream> _input,
+        MetricsCollector& _metrics
+        ): input(std::move(_input)),
+           metrics(_metrics) {
+    // PASS
+  }
+
+  MeteredSeekableInputStream::~MeteredSeekableInputStream() {
+    // PASS
+  }
+
+  bool MeteredSeekableInputStream::Next(const void** data, int*size) {
+    unsigned long start = getNanoTime();
+    bool result = input->Next(data, size);
+    metrics.decompressionNanos += getNanoTime() - start;
+    if (result) {
+      metrics.decompressedBytes += static_cast<unsigned long>(*size);
+    }
+    return result;
+  }
+
+  void MeteredSeekableInputStream::BackUp(int count) {
+    input->BackUp(count);
+    metrics.decompressedBytes -= static_cast<unsigned long>(count);
+  }
+
+  bool MeteredSeekableInputStream::Skip(int count) {
+    unsigned long start = getNanoTime();
+    bool result = input->Skip(count);
+    metrics.decompressionNanos += getNanoTime() - start;
+    return result;
+  }
+
+  google::protobuf::int64 MeteredSeekableInputStream::ByteCount() const {
+    return input->ByteCount();
+  }
+
+  void MeteredSeekableInputStream::seek(PositionProvider& position) {
+    unsigned long start = getNanoTime();
+    input->seek(position);
+    metrics.decompressionNanos += getNanoTime() - start;
+  }
+
+  std::string MeteredSeekableInputStream::getName() const {
+    return input->getName();
+  }
+}
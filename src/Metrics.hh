@@ -0,0 +1,103 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ORC_METRICS_HH
+#define ORC_METRICS_HH
+
+#include "orc/Reader.hh"
+#include "Compression.hh"
+
+#include <atomic>
+
+namespace orc {
+
+  /**
+   * Get a monotonic clock reading for timing work.
+   * @return the time in nanoseconds since an arbitrary point
+   */
+  unsigned long getNanoTime();
+
+  /**
+   * The counters that a reader updates as it works. The file counters are
+   * atomic because prefetching reads from another thread. The column
+   * counters are only updated by the thread calling Reader::next.
+   */
+  struct MetricsCollector {
+    std::atomic<unsigned long> readCalls;
+    std::atomic<unsigned long> readBytes;
+    std::atomic<unsigned long> readNanos;
+    std::atomic<unsigned long> decompressionNanos;
+    std::atomic<unsigned long> decompressedBytes;
+    std::vector<ColumnMetrics> columns;
+
+    MetricsCollector(unsigned long columnCount);
+
+    /**
+     * Copy the counters into the public form.
+     */
+    ReaderMetrics getMetrics() const;
+  };
+
+  /**
+   * An InputStream that counts and times the reads of another one. Reads
+   * that the caller does straight from getData's memory aren't counted.
+   */
+  class MeteredInputStream: public InputStream {
+  private:
+    std::unique_ptr<InputStream> input;
+    MetricsCollector& metrics;
+
+  public:
+    MeteredInputStream(std::unique_ptr<InputStream> input,
+                       MetricsCollector& metrics);
+    ~MeteredInputStream();
+
+    long getLength() const override;
+    void read(void* buffer, unsigned long offset,
+              unsigned long length) override;
+    const std::string& getName() const override;
+    const char* getData() const override;
+    long getModificationTime() const override;
+    void advise(unsigned long offset, unsigned long length,
+                ReadAdvice advice) override;
+    unsigned long getReadAlignment() const override;
+    void readRanges(const std::vector<ReadRequest>& requests) override;
+  };
+
+  /**
+   * A stream that times the work done by a decompression stream.
+   */
+  class MeteredSeekableInputStream: public SeekableInputStream {
+  private:
+    std::unique_ptr<SeekableInputStream> input;
+    MetricsCollector& metrics;
+
+  public:
+    MeteredSeekableInputStream(std::unique_ptr<SeekableInputStream> input,
+                               MetricsCollector& metrics);
+    virtual ~MeteredSeekableInputStream();
+    virtual bool Next(const void** data, int*size) override;
+    virtual void BackUp(int count) override;
+    virtual bool Skip(int count) override;
+    virtual google::protobuf::int64 ByteCount() const override;
+    virtual void seek(PositionProvider& position) override;
+    virtual std::string getName() const override;
+  };
+}
+
+#endif
@@ -0,0 +1,323 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NullExpand.hh"
+
+#include <algorithm>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ORC_X86_KERNELS
+#include <immintrin.h>
+#define ORC_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace orc {
+
+  unsigned long countNonNulls(const char* notNull, unsigned long count) {
+    unsigned long nulls = 0;
+    unsigned long i = 0;
+#ifdef ORC_X86_KERNELS
+    // sum the null flags 16 at a time with psadbw
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i sums = zero;
+    for (; i + 16 <= count; i += 16) {
+      const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(notNull + i));
+      const __m128i isNull = _mm_and_si128(_mm_cmpeq_epi8(bytes, zero), one);
+      sums = _mm_add_epi64(sums, _mm_sad_epu8(isNull, zero));
+    }
+    nulls = static_cast<unsigned long>(
+      _mm_cvtsi128_si64(_mm_add_epi64(sums, _mm_unpackhi_epi64(sums, sums))));
+#endif
+    for (; i < count; ++i) {
+      nulls += notNull[i] == 0;
+    }
+    return count - nulls;
+  }
+
+  unsigned long countNonNullBits(const unsigned char* bits,
+                                 unsigned long count) {
+    unsigned long result = 0;
+    unsigned long i = 0;
+    // popcount 64 values at a time
+    for (; i + 64 <= count; i += 64) {
+      uint64_t word;
+      memcpy(&word, bits + i / 8, sizeof(word));
+      result += static_cast<unsigned long>(__builtin_popcountll(word));
+    }
+    for (; i < count; ++i) {
+      result += (bits[i / 8] >> (7 - i % 8)) & 1;
+    }
+    return result;
+  }
+
+  /**
+   * Expand without a branch per value. At nulls past the last value the
+   * last value is read again rather than reading past the end.
+   * @param available the number of values left, which must be the number
+   *    of non-null positions
+   */
+  template <typename T>
+  static void expandScalar(const T* values,
+                           unsigned long available,
+                           const char* notNull,
+                           unsigned long count,
+                           T* output) {
+    if (available == 0) {
+      return;
+    }
+    const unsigned long last = available - 1;
+    unsigned long used = 0;
+    for (unsigned long i = 0; i < count; ++i) {
+      const bool isSet = notNull[i] != 0;
+      const T value = values[std::min(used, last)];
+      output[i] = isSet ? value : output[i];
+      used += isSet;
+    }
+  }
+
+#ifdef ORC_X86_KERNELS
+  /**
+   * Get the mask of the non-null positions among the next 8.
+   */
+  static inline unsigned int getNonNullMask(const char* notNull) {
+    const __m128i bytes =
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(notNull));
+    const int nulls =
+      _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+    return ~static_cast<unsigned int>(nulls) & 0xff;
+  }
+
+  /**
+   * For each mask of 8 positions, the pshufb indices that move the dense
+   * values to the non-null positions.
+   */
+  struct ByteShuffles {
+    uint64_t entries[256];
+
+    ByteShuffles() {
+      for (unsigned int mask = 0; mask < 256; ++mask) {
+        uint64_t entry = 0;
+        unsigned int used = 0;
+        for (unsigned int lane = 0; lane < 8; ++lane) {
+          const uint64_t index = mask & (1U << lane) ? used++ : 0x80;
+          entry |= index << (8 * lane);
+        }
+        entries[mask] = entry;
+      }
+    }
+  };
+
+  /**
+   * For each mask of 4 positions, the vpermd indices that move the dense
+   * 64 bit values to the non-null positions.
+   */
+  struct WideShuffles {
+    int32_t entries[16][8];
+
+    WideShuffles() {
+      for (int mask = 0; mask < 16; ++mask) {
+        int used = 0;
+        for (int lane = 0; lane < 4; ++lane) {
+          const int index = mask & (1 << lane) ? used++ : 0;
+          entries[mask][2 * lane] = 2 * index;
+          entries[mask][2 * lane + 1] = 2 * index + 1;
+        }
+      }
+    }
+  };
+
+  /**
+   * The vector kernels expand 8 positions at a time while there are at
+   * least 8 values left, so that they never load past the last value.
+   * @param used set to the number of values used
+   * @return the number of positions done
+   */
+  ORC_TARGET("sse4.2")
+  static unsigned long expand8Sse42(const char* values,
+                                    unsigned long available,
+                                    const char* notNull,
+                                    unsigned long count,
+                                    char* output,
+                                    unsigned long& used) {
+    static const ByteShuffles shuffles;
+    unsigned long i = 0;
+    used = 0;
+    for (; i + 8 <= count && used + 8 <= available; i += 8) {
+      const unsigned int mask = getNonNullMask(notNull + i);
+      const __m128i dense =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(values + used));
+      const __m128i expanded = _mm_shuffle_epi8(
+        dense, _mm_cvtsi64_si128(static_cast<long long>(
+                 shuffles.entries[mask])));
+      const __m128i old =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(output + i));
+      const __m128i isNull = _mm_cmpeq_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(notNull + i)),
+        _mm_setzero_si128());
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(output + i),
+                       _mm_blendv_epi8(expanded, old, isNull));
+      used += static_cast<unsigned long>(__builtin_popcount(mask));
+    }
+    return i;
+  }
+
+  // the 64 bit lanes are stored straight into the long outputs
+  static_assert(sizeof(long) == 8, "the 64 bit kernels need 64 bit longs");
+
+  ORC_TARGET("avx2")
+  static unsigned long expand64Avx2(const long* values,
+                                    unsigned long available,
+                                    const char* notNull,
+                                    unsigned long count,
+                                    long* output,
+                                    unsigned long& used) {
+    static const WideShuffles shuffles;
+    const __m256i bits = _mm256_setr_epi64x(1, 2, 4, 8);
+    unsigned long i = 0;
+    used = 0;
+    for (; i + 8 <= count && used + 8 <= available; i += 8) {
+      const unsigned int mask = getNonNullMask(notNull + i);
+      for (unsigned int half = 0; half < 2; ++half) {
+        const unsigned int quarter = mask >> (4 * half) & 0xf;
+        const __m256i dense = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(values + used));
+        const __m256i indexes = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(shuffles.entries[quarter]));
+        const __m256i isSet = _mm256_cmpeq_epi64(
+          _mm256_and_si256(_mm256_set1_epi64x(quarter), bits), bits);
+        _mm256_maskstore_epi64(reinterpret_cast<long long*>(output + i +
+                                                            4 * half),
+                               isSet,
+                               _mm256_permutevar8x32_epi32(dense, indexes));
+        used += static_cast<unsigned long>(__builtin_popcount(quarter));
+      }
+    }
+    return i;
+  }
+
+  ORC_TARGET("avx512f,avx512bw")
+  static unsigned long expand64Avx512(const long* values,
+                                      unsigned long available,
+                                      const char* notNull,
+                                      unsigned long count,
+                                      long* output,
+                                      unsigned long& used) {
+    unsigned long i = 0;
+    used = 0;
+    for (; i + 8 <= count && used + 8 <= available; i += 8) {
+      const __mmask8 mask =
+        static_cast<__mmask8>(getNonNullMask(notNull + i));
+      const __m512i expanded =
+        _mm512_maskz_expandloadu_epi64(mask, values + used);
+      _mm512_mask_storeu_epi64(output + i, mask, expanded);
+      used += static_cast<unsigned long>(__builtin_popcount(mask));
+    }
+    return i;
+  }
+
+  /**
+   * The 64 bit values have no kernel below avx2, since two lanes don't
+   * pay for the shuffle.
+   */
+  static unsigned long expandVector(const long* values,
+                                    unsigned long available,
+                                    const char* notNull,
+                                    unsigned long count,
+                                    long* output,
+                                    BitUnpackLevel level,
+                                    unsigned long& used) {
+    switch (level) {
+    case BitUnpackLevel_AVX512:
+      return expand64Avx512(values, available, notNull, count, output, used);
+    case BitUnpackLevel_AVX2:
+      return expand64Avx2(values, available, notNull, count, output, used);
+    default:
+      used = 0;
+      return 0;
+    }
+  }
+
+  /**
+   * The byte values use the same pshufb kernel at every level.
+   */
+  static unsigned long expandVector(const char* values,
+                                    unsigned long available,
+                                    const char* notNull,
+                                    unsigned long count,
+                                    char* output,
+                                    BitUnpackLevel,
+                                    unsigned long& used) {
+    return expand8Sse42(values, available, notNull, count, output, used);
+  }
+#endif
+
+  template <typename T>
+  static void expandValues(const T* values,
+                           const char* notNull,
+                           unsigned long count,
+                           T* output,
+                           BitUnpackLevel level) {
+    unsigned long available = countNonNulls(notNull, count);
+    unsigned long done = 0;
+#ifdef ORC_X86_KERNELS
+    level = std::min(level, getBitUnpackLevel());
+    if (level != BitUnpackLevel_SCALAR) {
+      unsigned long used;
+      done = expandVector(values, available, notNull, count, output, level,
+                          used);
+      values += used;
+      available -= used;
+    }
+#else
+    (void) level;
+#endif
+    expandScalar(values, available, notNull + done, count - done,
+                 output + done);
+  }
+
+  void expandNonNulls(const long* values, const char* notNull,
+                      unsigned long count, long* output) {
+    expandValues(values, notNull, count, output, getBitUnpackLevel());
+  }
+
+  void expandNonNulls(const char* values, const char* notNull,
+                      unsigned long count, char* output) {
+    expandValues(values, notNull, count, output, getBitUnpackLevel());
+  }
+
+  void expandNonNulls(char* const* values, const char* notNull,
+                      unsigned long count, char** output) {
+    expandScalar(values, countNonNulls(notNull, count), notNull, count,
+                 output);
+  }
+
+  void expandNonNulls(const long* values, const char* notNull,
+                      unsigned long count, long* output,
+                      BitUnpackLevel level) {
+    expandValues(values, notNull, count, output, level);
+  }
+
+  void expandNonNulls(const char* values, const char* notNull,
+                      unsigned long count, char* output,
+                      BitUnpackLevel level) {
+    expandValues(values, notNull, count, output, level);
+  }
+}
@@ -0,0 +1,91 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ORC_NULLEXPAND_HH
+#define ORC_NULLEXPAND_HH
+
+#include "BitUnpack.hh"
+
+#include <stdint.h>
+#include <vector>
+
+namespace orc {
+
+  /**
+   * Count the non-null entries of a notNull array.
+   */
+  unsigned long countNonNulls(const char* notNull, unsigned long count);
+
+  /**
+   * Count the set bits among the first count bits of a packed bitmap.
+   */
+  unsigned long countNonNullBits(const unsigned char* bits,
+                                 unsigned long count);
+
+  /**
+   * Scatter densely decoded values, in order, over the non-null positions
+   * of the output. The null positions of the output are left untouched.
+   * @param values the non-null values, which must hold
+   *    countNonNulls(notNull, count) entries
+   * @param notNull the mask of non-null positions
+   * @param count the number of positions
+   * @param output the array to expand into
+   */
+  void expandNonNulls(const long* values, const char* notNull,
+                      unsigned long count, long* output);
+  void expandNonNulls(const char* values, const char* notNull,
+                      unsigned long count, char* output);
+  void expandNonNulls(char* const* values, const char* notNull,
+                      unsigned long count, char** output);
+
+  /**
+   * Expand values with the kernels of a given level. Levels above
+   * getBitUnpackLevel() are limited to it.
+   */
+  void expandNonNulls(const long* values, const char* notNull,
+                      unsigned long count, long* output,
+                      BitUnpackLevel level);
+  void expandNonNulls(const char* values, const char* notNull,
+                      unsigned long count, char* output,
+                      BitUnpackLevel level);
+
+  /**
+   * Read the values of a nullable column the way the decoders share:
+   * decode the non-null values densely into the scratch buffer and then
+   * expand them into place, so that the decoding loops never look at the
+   * nulls.
+   * @param data the array to read into
+   * @param numValues the number of positions to fill
+   * @param notNull the mask of non-null positions
+   * @param scratch the buffer for the dense values
+   * @param readDense a function (T* values, unsigned long count) that
+   *    decodes count values without nulls
+   */
+  template <typename T, typename READ>
+  void readNonNulls(T* data, unsigned long numValues, const char* notNull,
+                    std::vector<T>& scratch, READ readDense) {
+    const unsigned long count = countNonNulls(notNull, numValues);
+    if (scratch.size() < count) {
+      scratch.resize(count);
+    }
+    readDense(scratch.data(), count);
+    expandNonNulls(scratch.data(), notNull, numValues, data);
+  }
+}
+
+#endif
@@ -17,48 +17,578 @@
  */
 
 #include "orc/OrcFile.hh"
+#include "Exceptions.hh"
+#include "StripePlanner.hh"
 
-#include <fstream>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
 
 namespace orc {
 
+  InputStream::~InputStream() {
+    // PASS
+  }
+
+  const char* InputStream::getData() const {
+    return nullptr;
+  }
+
+  long InputStream::getModificationTime() const {
+    return 0;
+  }
+
+  void InputStream::advise(unsigned long, unsigned long, ReadAdvice) {
+    // PASS
+  }
+
+  unsigned long InputStream::getReadAlignment() const {
+    return 1;
+  }
+
+  void InputStream::readRanges(const std::vector<ReadRequest>& requests) {
+    for(const ReadRequest& request: requests) {
+      read(request.buffer, request.offset, request.length);
+    }
+  }
+
+  /**
+   * A stream to a local file that uses positional reads, so it keeps no
+   * per-read state and can be shared by several threads.
+   */
   class FileInputStream : public InputStream {
   private:
-    std::string filename ;
-    std::ifstream file;
-    long totalLength;
+    std::string filename;
+    int file;
+    unsigned long totalLength;
+    long modificationTime;
 
   public:
-    FileInputStream(std::string _filename) {
-      filename = _filename ;
-      file.open(filename.c_str(), std::ios::in | std::ios::binary);
-      file.seekg(0,file.end);
-      totalLength = file.tellg();
+    FileInputStream(std::string _filename);
+    ~FileInputStream();
+
+    long getLength() const override {
+      return static_cast<long>(totalLength);
     }
 
-    ~FileInputStream();
+    void read(void* buffer, unsigned long offset,
+              unsigned long length) override;
+
+    const std::string& getName() const override {
+      return filename;
+    }
 
-    long getLength() const {
-      return totalLength;
+    long getModificationTime() const override {
+      return modificationTime;
+    }
+
+    void advise(unsigned long offset, unsigned long length,
+                ReadAdvice advice) override;
+  };
+
+  static long getModificationNanos(const struct stat& fileStat) {
+#ifdef __APPLE__
+    const struct timespec& modified = fileStat.st_mtimespec;
+#else
+    const struct timespec& modified = fileStat.st_mtim;
+#endif
+    return modified.tv_sec * 1000000000L + modified.tv_nsec;
+  }
+
+  FileInputStream::FileInputStream(std::string _filename
+                                   ): filename(_filename) {
+    file = open(filename.c_str(), O_RDONLY);
+    if (file == -1) {
+      throw ParseError("Can't open " + filename);
+    }
+    struct stat fileStat;
+    if (fstat(file, &fileStat) == -1) {
+      close(file);
+      throw ParseError("Can't stat " + filename);
+    }
+    totalLength = static_cast<unsigned long>(fileStat.st_size);
+    modificationTime = getModificationNanos(fileStat);
+  }
+
+  FileInputStream::~FileInputStream() {
+    close(file);
+  }
+
+  void FileInputStream::read(void* buffer, unsigned long offset,
+                             unsigned long length) {
+    char* output = static_cast<char*>(buffer);
+    while (length > 0) {
+      ssize_t bytesRead = pread(file, output, length,
+                                static_cast<off_t>(offset));
+      if (bytesRead == -1 && errno == EINTR) {
+        continue;
+      }
+      if (bytesRead <= 0) {
+        throw ParseError("Bad read of " + filename);
+      }
+      output += bytesRead;
+      offset += static_cast<unsigned long>(bytesRead);
+      length -= static_cast<unsigned long>(bytesRead);
+    }
+  }
+
+  void FileInputStream::advise(unsigned long offset, unsigned long length,
+                               ReadAdvice advice) {
+#ifdef POSIX_FADV_WILLNEED
+    int fileAdvice;
+    switch (advice) {
+    case ReadAdvice_WILL_NEED:
+      fileAdvice = POSIX_FADV_WILLNEED;
+      break;
+    case ReadAdvice_DONT_NEED:
+      fileAdvice = POSIX_FADV_DONTNEED;
+      break;
+    case ReadAdvice_SEQUENTIAL:
+      fileAdvice = POSIX_FADV_SEQUENTIAL;
+      break;
+    case ReadAdvice_RANDOM:
+      fileAdvice = POSIX_FADV_RANDOM;
+      break;
+    default:
+      return;
+    }
+    // advice is only a hint, so failures are ignored
+    posix_fadvise(file, static_cast<off_t>(offset),
+                  static_cast<off_t>(length), fileAdvice);
+#else
+    // advice is only a hint, so it is dropped without posix_fadvise
+    (void) offset;
+    (void) length;
+    (void) advice;
+#endif
+  }
+
+  std::unique_ptr<InputStream> readLocalFile(const std::string& path) {
+    return std::unique_ptr<InputStream>(new FileInputStream(path));
+  }
+
+  class MappedFileInputStream : public InputStream {
+  private:
+    std::string filename;
+    // kept open so that advice can reach the page cache as well as the
+    // mapping
+    int file;
+    char* data;
+    unsigned long totalLength;
+    long modificationTime;
+
+  public:
+    MappedFileInputStream(std::string _filename);
+    ~MappedFileInputStream();
+
+    long getLength() const override {
+      return static_cast<long>(totalLength);
     }
 
     void read(void* buffer, unsigned long offset,
               unsigned long length) override {
-      file.seekg(static_cast<std::streamoff>(offset));
-      file.read(static_cast<char*>(buffer), 
-                static_cast<std::streamsize>(length));
+      if (offset > totalLength || length > totalLength - offset) {
+        throw ParseError("Bad read of " + filename);
+      }
+      memcpy(buffer, data + offset, length);
     }
 
-    const std::string& getName() const override { 
+    const std::string& getName() const override {
       return filename;
     }
+
+    const char* getData() const override {
+      return data;
+    }
+
+    long getModificationTime() const override {
+      return modificationTime;
+    }
+
+    void advise(unsigned long offset, unsigned long length,
+                ReadAdvice advice) override;
   };
 
-  FileInputStream::~FileInputStream() { 
-    file.close();
+  MappedFileInputStream::MappedFileInputStream(std::string _filename
+                                               ): filename(_filename),
+                                                  data(nullptr),
+                                                  totalLength(0) {
+    file = open(filename.c_str(), O_RDONLY);
+    if (file == -1) {
+      throw ParseError("Can't open " + filename);
+    }
+    struct stat fileStat;
+    if (fstat(file, &fileStat) == -1) {
+      close(file);
+      throw ParseError("Can't stat " + filename);
+    }
+    totalLength = static_cast<unsigned long>(fileStat.st_size);
+    modificationTime = getModificationNanos(fileStat);
+    if (totalLength > 0) {
+      void* mapping = mmap(nullptr, totalLength, PROT_READ, MAP_PRIVATE,
+                           file, 0);
+      if (mapping == MAP_FAILED) {
+        close(file);
+        throw ParseError("Can't map " + filename);
+      }
+      data = static_cast<char*>(mapping);
+    }
   }
 
-  std::unique_ptr<InputStream> readLocalFile(const std::string& path) {
-    return std::unique_ptr<InputStream>(new FileInputStream(path));
+  MappedFileInputStream::~MappedFileInputStream() {
+    if (data) {
+      munmap(data, totalLength);
+    }
+    close(file);
+  }
+
+  void MappedFileInputStream::advise(unsigned long offset,
+                                     unsigned long length,
+                                     ReadAdvice advice) {
+    if (data == nullptr || offset >= totalLength) {
+      return;
+    }
+    int memoryAdvice;
+    switch (advice) {
+    case ReadAdvice_WILL_NEED:
+      memoryAdvice = MADV_WILLNEED;
+      break;
+    case ReadAdvice_DONT_NEED:
+      memoryAdvice = MADV_DONTNEED;
+      break;
+    case ReadAdvice_SEQUENTIAL:
+      memoryAdvice = MADV_SEQUENTIAL;
+      break;
+    case ReadAdvice_RANDOM:
+      memoryAdvice = MADV_RANDOM;
+      break;
+    default:
+      return;
+    }
+    // madvise needs a page aligned start
+    unsigned long pageSize = static_cast<unsigned long>(sysconf(_SC_PAGESIZE));
+    unsigned long start = offset - offset % pageSize;
+    unsigned long end = std::min(totalLength, offset + length);
+    // advice is only a hint, so failures are ignored
+    madvise(data + start, end - start, memoryAdvice);
+#ifdef POSIX_FADV_DONTNEED
+    if (advice == ReadAdvice_DONT_NEED) {
+      // MADV_DONTNEED only drops this process's private mapping of the
+      // pages, so the page cache has to be told separately
+      posix_fadvise(file, static_cast<off_t>(start),
+                    static_cast<off_t>(end - start), POSIX_FADV_DONTNEED);
+    }
+#endif
+  }
+
+  std::unique_ptr<InputStream> readLocalFileMapped(const std::string& path) {
+    return std::unique_ptr<InputStream>(new MappedFileInputStream(path));
+  }
+
+  class MemoryInputStream : public InputStream {
+  private:
+    std::string name;
+    const char* data;
+    unsigned long totalLength;
+
+  public:
+    MemoryInputStream(const char* _data, unsigned long _length,
+                      const std::string& _name
+                      ): name(_name), data(_data), totalLength(_length) {
+      // PASS
+    }
+
+    ~MemoryInputStream();
+
+    long getLength() const override {
+      return static_cast<long>(totalLength);
+    }
+
+    void read(void* buffer, unsigned long offset,
+              unsigned long length) override {
+      if (offset > totalLength || length > totalLength - offset) {
+        throw ParseError("Bad read of " + name);
+      }
+      memcpy(buffer, data + offset, length);
+    }
+
+    const std::string& getName() const override {
+      return name;
+    }
+
+    const char* getData() const override {
+      return data;
+    }
+  };
+
+  MemoryInputStream::~MemoryInputStream() {
+    // PASS
+  }
+
+  std::unique_ptr<InputStream> readMemory(const char* data,
+                                          unsigned long length,
+                                          const std::string& name) {
+    return std::unique_ptr<InputStream>(new MemoryInputStream(data, length,
+                                                              name));
+  }
+
+  // the offsets, lengths, and buffers of direct reads must be multiples
+  // of the device's logical block size, which is at most a page
+  static const unsigned long DIRECT_ALIGNMENT = 4096;
+  // the size of the bounce buffers used for unaligned direct reads
+  static const unsigned long DIRECT_BUFFER_SIZE = 1024 * 1024;
+
+  static unsigned long alignDown(unsigned long value) {
+    return value & ~(DIRECT_ALIGNMENT - 1);
+  }
+
+  static unsigned long alignUp(unsigned long value) {
+    return alignDown(value + DIRECT_ALIGNMENT - 1);
+  }
+
+  static bool isAligned(unsigned long value) {
+    return (value & (DIRECT_ALIGNMENT - 1)) == 0;
+  }
+
+  class DirectFileInputStream : public InputStream {
+  private:
+    std::string filename;
+    int file;
+    // whether the file was opened with O_DIRECT
+    bool direct;
+    unsigned long totalLength;
+    long modificationTime;
+    // the bounce buffers that aren't in use, which are kept for the next
+    // unaligned reads rather than allocated each time
+    std::mutex bufferLock;
+    std::vector<char*> bounceBuffers;
+
+    char* acquireBounceBuffer();
+    void releaseBounceBuffer(char* buffer);
+
+    /**
+     * Read an aligned range, stopping early at the end of the file.
+     * @return the number of bytes read
+     */
+    unsigned long readAligned(char* buffer, unsigned long offset,
+                              unsigned long length);
+
+  public:
+    DirectFileInputStream(std::string _filename);
+    ~DirectFileInputStream();
+
+    long getLength() const override {
+      return static_cast<long>(totalLength);
+    }
+
+    void read(void* buffer, unsigned long offset,
+              unsigned long length) override;
+
+    const std::string& getName() const override {
+      return filename;
+    }
+
+    long getModificationTime() const override {
+      return modificationTime;
+    }
+
+    unsigned long getReadAlignment() const override {
+      return direct ? DIRECT_ALIGNMENT : 1;
+    }
+  };
+
+  DirectFileInputStream::DirectFileInputStream(std::string _filename
+                                               ): filename(_filename),
+                                                  direct(true) {
+#ifdef O_DIRECT
+    file = open(filename.c_str(), O_RDONLY | O_DIRECT);
+    if (file == -1 && errno == EINVAL) {
+      // the file system doesn't support direct I/O
+      file = open(filename.c_str(), O_RDONLY);
+      direct = false;
+    }
+#else
+    // without O_DIRECT, keep the reads out of the cache where possible
+    file = open(filename.c_str(), O_RDONLY);
+    direct = false;
+#ifdef F_NOCACHE
+    if (file != -1) {
+      fcntl(file, F_NOCACHE, 1);
+    }
+#endif
+#endif
+    if (file == -1) {
+      throw ParseError("Can't open " + filename);
+    }
+    struct stat fileStat;
+    if (fstat(file, &fileStat) == -1) {
+      close(file);
+      throw ParseError("Can't stat " + filename);
+    }
+    totalLength = static_cast<unsigned long>(fileStat.st_size);
+    modificationTime = getModificationNanos(fileStat);
+  }
+
+  DirectFileInputStream::~DirectFileInputStream() {
+    close(file);
+    for(char* buffer: bounceBuffers) {
+      free(buffer);
+    }
+  }
+
+  char* DirectFileInputStream::acquireBounceBuffer() {
+    {
+      std::lock_guard<std::mutex> guard(bufferLock);
+      if (!bounceBuffers.empty()) {
+        char* result = bounceBuffers.back();
+        bounceBuffers.pop_back();
+        return result;
+      }
+    }
+    void* result;
+    if (posix_memalign(&result, DIRECT_ALIGNMENT, DIRECT_BUFFER_SIZE) != 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<char*>(result);
+  }
+
+  void DirectFileInputStream::releaseBounceBuffer(char* buffer) {
+    std::lock_guard<std::mutex> guard(bufferLock);
+    bounceBuffers.push_back(buffer);
+  }
+
+  unsigned long DirectFileInputStream::readAligned(char* buffer,
+                                                   unsigned long offset,
+                                                   unsigned long length) {
+    unsigned long total = 0;
+    while (total < length) {
+      ssize_t bytesRead = pread(file, buffer + total, length - total,
+                                static_cast<off_t>(offset + total));
+      if (bytesRead == -1 && errno == EINTR) {
+        continue;
+      }
+      if (bytesRead < 0) {
+        throw ParseError("Bad read of " + filename);
+      }
+      total += static_cast<unsigned long>(bytesRead);
+      // a short read only happens at the end of the file and leaves the
+      // position unaligned, so stop here
+      if (bytesRead == 0 || !isAligned(static_cast<unsigned long>(bytesRead))) {
+        break;
+      }
+    }
+    return total;
+  }
+
+  void DirectFileInputStream::read(void* buffer, unsigned long offset,
+                                   unsigned long length) {
+    if (offset > totalLength || length > totalLength - offset) {
+      throw ParseError("Bad read of " + filename);
+    }
+    char* output = static_cast<char*>(buffer);
+    if (isAligned(reinterpret_cast<unsigned long>(output)) &&
+        isAligned(offset) && isAligned(length)) {
+      if (readAligned(output, offset, length) != length) {
+        throw ParseError("Bad read of " + filename);
+      }
+      return;
+    }
+
+    // read through an aligned buffer and trim the head and tail
+    char* bounce = acquireBounceBuffer();
+    try {
+      while (length > 0) {
+        unsigned long start = alignDown(offset);
+        unsigned long head = offset - start;
+        unsigned long request = std::min(DIRECT_BUFFER_SIZE,
+                                         alignUp(head + length));
+        unsigned long bytesRead = readAligned(bounce, start, request);
+        if (bytesRead <= head) {
+          throw ParseError("Bad read of " + filename);
+        }
+        unsigned long bytesUsed = std::min(length, bytesRead - head);
+        memcpy(output, bounce + head, bytesUsed);
+        output += bytesUsed;
+        offset += bytesUsed;
+        length -= bytesUsed;
+      }
+    } catch (...) {
+      releaseBounceBuffer(bounce);
+      throw;
+    }
+    releaseBounceBuffer(bounce);
+  }
+
+  std::unique_ptr<InputStream> readLocalFileDirect(const std::string& path) {
+    return std::unique_ptr<InputStream>(new DirectFileInputStream(path));
+  }
+
+  class DelayedInputStream : public InputStream {
+  private:
+    std::unique_ptr<InputStream> input;
+    unsigned long latencyMicros;
+    unsigned int maxParallelReads;
+
+  public:
+    DelayedInputStream(std::unique_ptr<InputStream> _input,
+                       unsigned long _latencyMicros,
+                       unsigned int _maxParallelReads
+                       ): input(std::move(_input)),
+                          latencyMicros(_latencyMicros),
+                          maxParallelReads(_maxParallelReads) {
+      // PASS
+    }
+
+    ~DelayedInputStream();
+
+    long getLength() const override {
+      return input->getLength();
+    }
+
+    void read(void* buffer, unsigned long offset,
+              unsigned long length) override {
+      std::this_thread::sleep_for(std::chrono::microseconds(latencyMicros));
+      input->read(buffer, offset, length);
+    }
+
+    const std::string& getName() const override {
+      return input->getName();
+    }
+
+    long getModificationTime() const override {
+      return input->getModificationTime();
+    }
+
+    unsigned long getReadAlignment() const override {
+      return input->getReadAlignment();
+    }
+
+    void readRanges(const std::vector<ReadRequest>& requests) override {
+      readRangesInParallel(*this, requests, maxParallelReads);
+    }
+  };
+
+  DelayedInputStream::~DelayedInputStream() {
+    // PASS
+  }
+
+  std::unique_ptr<InputStream>
+      createDelayedInputStream(std::unique_ptr<InputStream> input,
+                               unsigned long latencyMicros,
+                               unsigned int maxParallelReads) {
+    return std::unique_ptr<InputStream>
+      (new DelayedInputStream(std::move(input), latencyMicros,
+                              maxParallelReads));
   }
 }
@@ -26,6 +26,10 @@ namespace orc {
 class PositionProvider;
 class SeekableInputStream;
 
+inline long unZigZag(unsigned long value) {
+  return value >> 1 ^ -(value & 1);
+}
+
 class RleDecoder {
 public:
   // must be non-inline!
@@ -19,17 +19,24 @@
 #include "RLEv1.hh"
 #include "Compression.hh"
 #include "Exceptions.hh"
+#include "NullExpand.hh"
 
 #include <algorithm>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace orc {
 
 const unsigned long MINIMUM_REPEAT = 3;
 const unsigned long BASE_128_MASK = 0x7f;
-
-inline long unZigZag(unsigned long value) {
-  return value >> 1 ^ -(value & 1);
-}
+const unsigned long MAX_LITERAL_SIZE = 128;
+const unsigned long MAX_VARINT_LENGTH = 10;
+// the continuation bits of 8 varint bytes
+const uint64_t HIGH_BITS = 0x8080808080808080UL;
 
 signed char RleDecoderV1::readByte() {
   if (bufferStart == bufferEnd) {
@@ -61,8 +68,123 @@ unsigned long RleDecoderV1::readLong() {
   return result;
 }
 
+/**
+ * Decode a varint of more than one byte from a buffer that is known to
+ * hold at least MAX_VARINT_LENGTH bytes.
+ */
+static inline unsigned long readLongUnchecked(const char*& pointer) {
+  const char* const end = pointer + MAX_VARINT_LENGTH;
+  unsigned long result = static_cast<unsigned char>(*(pointer++)) &
+    BASE_128_MASK;
+  for (unsigned int offset = 7; pointer != end; offset += 7) {
+    const unsigned char ch = static_cast<unsigned char>(*(pointer++));
+    result |= (ch & BASE_128_MASK) << offset;
+    if (ch < 0x80) {
+      return result;
+    }
+  }
+  throw ParseError("varint is too long in RleDecoderV1");
+}
+
+#ifdef __SSE2__
+/**
+ * Store 16 single byte varints as longs. The bytes are sign extended
+ * a step at a time, which also zero extends unsigned values since
+ * their top bit is clear.
+ */
+template <bool SIGNED>
+static inline void storeSmallLongs(__m128i bytes, long* data) {
+  const __m128i zero = _mm_setzero_si128();
+  if (SIGNED) {
+    // unZigZag within the bytes
+    const __m128i low = _mm_and_si128(bytes, _mm_set1_epi8(1));
+    const __m128i half = _mm_and_si128(_mm_srli_epi16(bytes, 1),
+                                       _mm_set1_epi8(0x7f));
+    bytes = _mm_xor_si128(half, _mm_sub_epi8(zero, low));
+  }
+  const __m128i byteSigns = _mm_cmpgt_epi8(zero, bytes);
+  const __m128i shorts[2] = {_mm_unpacklo_epi8(bytes, byteSigns),
+                             _mm_unpackhi_epi8(bytes, byteSigns)};
+  for (unsigned int half = 0; half < 2; ++half) {
+    const __m128i shortSigns = _mm_srai_epi16(shorts[half], 15);
+    const __m128i ints[2] = {_mm_unpacklo_epi16(shorts[half], shortSigns),
+                             _mm_unpackhi_epi16(shorts[half], shortSigns)};
+    for (unsigned int quarter = 0; quarter < 2; ++quarter) {
+      const __m128i intSigns = _mm_srai_epi32(ints[quarter], 31);
+      long* const output = data + 8 * half + 4 * quarter;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(output),
+                       _mm_unpacklo_epi32(ints[quarter], intSigns));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2),
+                       _mm_unpackhi_epi32(ints[quarter], intSigns));
+    }
+  }
+}
+#endif
+
+template <bool SIGNED>
+unsigned long RleDecoderV1::readLongsFast(long* data, unsigned long count) {
+  if (bufferEnd - bufferStart < static_cast<long>(MAX_VARINT_LENGTH)) {
+    return 0;
+  }
+  // keep the position in a local so that it stays in a register
+  const char* pointer = bufferStart;
+  const char* const last = bufferEnd - MAX_VARINT_LENGTH;
+  unsigned long i = 0;
+  while (i < count && pointer <= last) {
+    const unsigned char ch = static_cast<unsigned char>(*pointer);
+    if (ch < 0x80) {
+#ifdef __SSE2__
+      // small values tend to come together, so try 16 of them at once
+      if (count - i >= 16 && bufferEnd - pointer >= 16) {
+        const __m128i bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pointer));
+        if (_mm_movemask_epi8(bytes) == 0) {
+          storeSmallLongs<SIGNED>(bytes, data + i);
+          i += 16;
+          pointer += 16;
+          continue;
+        }
+      }
+#endif
+      data[i++] = SIGNED ? unZigZag(ch) : ch;
+      ++pointer;
+    } else {
+      const unsigned long value = readLongUnchecked(pointer);
+      data[i++] = SIGNED ? unZigZag(value) : static_cast<long>(value);
+    }
+  }
+  bufferStart = pointer;
+  return i;
+}
+
+template <bool SIGNED>
+void RleDecoderV1::readLongs(long* data, unsigned long count) {
+  unsigned long done = 0;
+  while (done < count) {
+    done += readLongsFast<SIGNED>(data + done, count - done);
+    if (done < count) {
+      // the varint may span buffers, so read it a byte at a time
+      data[done++] = SIGNED
+          ? unZigZag(readLong())
+          : static_cast<long>(readLong());
+    }
+  }
+}
+
 void RleDecoderV1::skipLongs(unsigned long numValues) {
   while (numValues > 0) {
+    // count the last bytes of the varints a word at a time
+    while (bufferEnd - bufferStart >= 8) {
+      uint64_t word;
+      memcpy(&word, bufferStart, sizeof(word));
+      const unsigned long ends = static_cast<unsigned long>(
+          __builtin_popcountll(~word & HIGH_BITS));
+      if (ends >= numValues) {
+        break;
+      }
+      bufferStart += 8;
+      numValues -= ends;
+    }
     if (readByte() >= 0) {
       --numValues;
     }
@@ -123,16 +245,27 @@ void RleDecoderV1::skip(unsigned long numValues) {
 void RleDecoderV1::next(long* const data,
                         const unsigned long numValues,
                         const char* const notNull) {
+  // pick the loop once per call rather than testing per value
+  if (notNull) {
+    readNonNulls(data, numValues, notNull, nonNulls,
+                 [this](long* values, unsigned long count) {
+                   if (isSigned) {
+                     nextValues<true>(values, count);
+                   } else {
+                     nextValues<false>(values, count);
+                   }
+                 });
+  } else if (isSigned) {
+    nextValues<true>(data, numValues);
+  } else {
+    nextValues<false>(data, numValues);
+  }
+}
+
+template <bool SIGNED>
+void RleDecoderV1::nextValues(long* const data,
+                              const unsigned long numValues) {
   unsigned long position = 0;
-  const auto skipNulls =[&position, numValues, notNull] {
-    if (notNull) {
-      // Skip over null values.
-      while (position < numValues && !notNull[position]) {
-        ++position;
-      }
-    }
-  };
-  skipNulls();
   while (position < numValues) {
     // If we are out of values, read more.
     if (remainingValues == 0) {
@@ -140,48 +273,21 @@ void RleDecoderV1::next(long* const data,
     }
     // How many do we read out of this block?
     unsigned long count = std::min(numValues - position, remainingValues);
-    unsigned long consumed = 0;
     if (repeating) {
-      if (notNull) {
-        for (unsigned long i = 0; i < count; ++i) {
-          if (notNull[position + i]) {
-            data[position + i] = value + static_cast<long>(consumed) * delta;
-            consumed += 1;
-          }
-        }
-      } else {
-        for (unsigned long i = 0; i < count; ++i) {
-          data[position + i] = value + static_cast<long>(i) * delta;
-        }
-        consumed = count;
+      // a plain induction on locals, which vectorizes
+      long* const run = data + position;
+      long next = value;
+      const long step = delta;
+      for (unsigned long i = 0; i < count; ++i) {
+        run[i] = next;
+        next += step;
       }
-      value += static_cast<long>(consumed) * delta;
+      value = next;
     } else {
-      if (notNull) {
-        for (unsigned long i = 0 ; i < count; ++i) {
-          if (notNull[i]) {
-            data[position + i] = isSigned
-                ? unZigZag(readLong())
-                : static_cast<long>(readLong());
-            ++consumed;
-          }
-        }
-      } else {
-        if (isSigned) {
-          for (unsigned long i = 0; i < count; ++i) {
-            data[position + i] = unZigZag(readLong());
-          }
-        } else {
-          for (unsigned long i = 0; i < count; ++i) {
-            data[position + i] = static_cast<long>(readLong());
-          }
-        }
-        consumed = count;
-      }
+      readLongs<SIGNED>(data + position, count);
     }
-    remainingValues -= consumed;
+    remainingValues -= count;
     position += count;
-    skipNulls();
   }
 }
 
@@ -22,6 +22,7 @@
 #include "RLE.hh"
 
 #include <memory>
+#include <vector>
 
 namespace orc {
 
@@ -52,8 +53,29 @@ private:
 
     inline unsigned long readLong();
 
+    /**
+    * Decode literals while the buffer holds enough bytes for a whole
+    * varint, without checking for the end of the buffer on each byte.
+    * @return the number of values decoded
+    */
+    template <bool SIGNED>
+    unsigned long readLongsFast(long* data, unsigned long count);
+
+    /**
+    * Decode count literals of the current run, unZigZagging signed values.
+    */
+    template <bool SIGNED>
+    void readLongs(long* data, unsigned long count);
+
     inline void skipLongs(unsigned long numValues);
 
+    /**
+    * Read values without nulls, instantiated for signed and unsigned
+    * values.
+    */
+    template <bool SIGNED>
+    void nextValues(long* data, unsigned long numValues);
+
     const std::unique_ptr<SeekableInputStream> inputStream;
     const bool isSigned;
     unsigned long remainingValues;
@@ -62,6 +84,8 @@ private:
     const char *bufferEnd;
     int delta;
     bool repeating;
+    // the non-null values of the current batch before they are expanded
+    std::vector<long> nonNulls;
 };
 }  // namespace orc
 
@@ -0,0 +1,325 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RLEv2.hh"
+#include "BitUnpack.hh"
+#include "Compression.hh"
+#include "Exceptions.hh"
+#include "NullExpand.hh"
+
+#include <algorithm>
+#include <string.h>
+
+namespace orc {
+
+enum EncodingType { SHORT_REPEAT=0, DIRECT=1, PATCHED_BASE=2, DELTA=3 };
+
+const unsigned long BASE_128_MASK = 0x7f;
+const unsigned int MINIMUM_REPEAT = 3;
+
+/**
+ * Map the 5 bit width code of a run header to the number of bits.
+ */
+static unsigned int decodeBitWidth(unsigned int code) {
+  static const unsigned int WIDTHS[] = {
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+    17, 18, 19, 20, 21, 22, 23, 24, 26, 28, 30, 32, 40, 48, 56, 64};
+  return WIDTHS[code & 0x1f];
+}
+
+/**
+ * Round a bit width up to the next width that the writer can encode.
+ */
+static unsigned int getClosestFixedBits(unsigned int width) {
+  if (width == 0) {
+    return 1;
+  } else if (width <= 24) {
+    return width;
+  } else if (width <= 26) {
+    return 26;
+  } else if (width <= 28) {
+    return 28;
+  } else if (width <= 30) {
+    return 30;
+  } else if (width <= 32) {
+    return 32;
+  } else if (width <= 40) {
+    return 40;
+  } else if (width <= 48) {
+    return 48;
+  } else if (width <= 56) {
+    return 56;
+  } else {
+    return 64;
+  }
+}
+
+unsigned char RleDecoderV2::readByte() {
+  if (bufferStart == bufferEnd) {
+    int bufferLength;
+    const void* bufferPointer;
+    if (!inputStream->Next(&bufferPointer, &bufferLength)) {
+      throw ParseError("bad read in RleDecoderV2::readByte");
+    }
+    bufferStart = static_cast<const char*>(bufferPointer);
+    bufferEnd = bufferStart + bufferLength;
+  }
+  return static_cast<unsigned char>(*(bufferStart++));
+}
+
+unsigned long RleDecoderV2::readVulong() {
+  unsigned long result = 0;
+  unsigned int offset = 0;
+  unsigned char ch;
+  do {
+    ch = readByte();
+    if (offset < 64) {
+      result |= (ch & BASE_128_MASK) << offset;
+    }
+    offset += 7;
+  } while (ch & 0x80);
+  return result;
+}
+
+long RleDecoderV2::readVslong() {
+  return unZigZag(readVulong());
+}
+
+unsigned long RleDecoderV2::readLongBE(unsigned int numBytes) {
+  unsigned long result = 0;
+  for (unsigned int i = 0; i < numBytes; ++i) {
+    result = result << 8 | readByte();
+  }
+  return result;
+}
+
+const unsigned char* RleDecoderV2::readBytes(unsigned long length) {
+  if (static_cast<unsigned long>(bufferEnd - bufferStart) >= length) {
+    const unsigned char* result =
+        reinterpret_cast<const unsigned char*>(bufferStart);
+    bufferStart += length;
+    return result;
+  }
+  scratch.resize(length);
+  unsigned long filled = 0;
+  while (filled < length) {
+    if (bufferStart == bufferEnd) {
+      int bufferLength;
+      const void* bufferPointer;
+      if (!inputStream->Next(&bufferPointer, &bufferLength)) {
+        throw ParseError("bad read in RleDecoderV2::readBytes");
+      }
+      bufferStart = static_cast<const char*>(bufferPointer);
+      bufferEnd = bufferStart + bufferLength;
+    }
+    unsigned long count =
+        std::min(length - filled,
+                 static_cast<unsigned long>(bufferEnd - bufferStart));
+    memcpy(scratch.data() + filled, bufferStart, count);
+    bufferStart += count;
+    filled += count;
+  }
+  return scratch.data();
+}
+
+void RleDecoderV2::unpack(long* data,
+                          unsigned long count,
+                          unsigned int width) {
+  unpackBits(readBytes(getPackedLength(count, width)), count, width, data);
+}
+
+RleDecoderV2::RleDecoderV2(std::unique_ptr<SeekableInputStream> input,
+                           bool hasSigned)
+    : inputStream(std::move(input)),
+      isSigned(hasSigned),
+      bufferStart(nullptr),
+      bufferEnd(bufferStart),
+      numLiterals(0),
+      usedLiterals(0) {
+}
+
+void RleDecoderV2::readRun() {
+  const unsigned char header = readByte();
+  usedLiterals = 0;
+  switch (static_cast<EncodingType>(header >> 6)) {
+    case SHORT_REPEAT:
+      readShortRepeat(header);
+      break;
+    case DIRECT:
+      readDirect(header);
+      break;
+    case PATCHED_BASE:
+      readPatchedBase(header);
+      break;
+    case DELTA:
+      readDelta(header);
+      break;
+  }
+}
+
+void RleDecoderV2::readShortRepeat(unsigned char header) {
+  const unsigned int numBytes = ((header >> 3) & 0x07) + 1;
+  numLiterals = (header & 0x07) + MINIMUM_REPEAT;
+  const unsigned long value = readLongBE(numBytes);
+  std::fill(literals, literals + numLiterals,
+            isSigned ? unZigZag(value) : static_cast<long>(value));
+}
+
+void RleDecoderV2::readDirect(unsigned char header) {
+  const unsigned int width = decodeBitWidth(header >> 1);
+  numLiterals = ((header & 0x01UL) << 8 | readByte()) + 1;
+  unpack(literals, numLiterals, width);
+  if (isSigned) {
+    for (unsigned long i = 0; i < numLiterals; ++i) {
+      literals[i] = unZigZag(static_cast<unsigned long>(literals[i]));
+    }
+  }
+}
+
+void RleDecoderV2::readPatchedBase(unsigned char header) {
+  const unsigned int width = decodeBitWidth(header >> 1);
+  numLiterals = ((header & 0x01UL) << 8 | readByte()) + 1;
+  const unsigned char third = readByte();
+  const unsigned int baseBytes = ((third >> 5) & 0x07) + 1;
+  const unsigned int patchWidth = decodeBitWidth(third);
+  const unsigned char fourth = readByte();
+  const unsigned int gapWidth = ((fourth >> 5) & 0x07) + 1;
+  const unsigned long patchCount = fourth & 0x1f;
+  if (patchWidth + gapWidth > 64) {
+    throw ParseError("patch is wider than 64 bits in RleDecoderV2");
+  }
+
+  // the base is stored in sign-magnitude form
+  unsigned long magnitude = readLongBE(baseBytes);
+  const unsigned long signBit = 1UL << (baseBytes * 8 - 1);
+  const long base = (magnitude & signBit)
+      ? -static_cast<long>(magnitude & ~signBit)
+      : static_cast<long>(magnitude);
+
+  unpack(literals, numLiterals, width);
+  long patches[32];
+  unpack(patches, patchCount, getClosestFixedBits(patchWidth + gapWidth));
+
+  // each patch holds the gap to the previous patch above the patch bits;
+  // gaps of more than 255 are chained through entries with empty patches
+  const unsigned long patchMask =
+      patchWidth == 64 ? ~0UL : (1UL << patchWidth) - 1;
+  unsigned long position = 0;
+  for (unsigned long i = 0; i < patchCount; ++i) {
+    const unsigned long entry = static_cast<unsigned long>(patches[i]);
+    const unsigned long gap = patchWidth == 64 ? 0 : entry >> patchWidth;
+    const unsigned long patch = entry & patchMask;
+    position += gap;
+    if (gap == 255 && patch == 0) {
+      continue;
+    }
+    if (position >= numLiterals) {
+      throw ParseError("patch is out of range in RleDecoderV2");
+    }
+    literals[position] = static_cast<long>(
+        static_cast<unsigned long>(literals[position]) | patch << width);
+  }
+  for (unsigned long i = 0; i < numLiterals; ++i) {
+    literals[i] += base;
+  }
+}
+
+void RleDecoderV2::readDelta(unsigned char header) {
+  const unsigned int widthCode = (header >> 1) & 0x1f;
+  const unsigned long length = (header & 0x01UL) << 8 | readByte();
+  literals[0] = isSigned
+      ? readVslong()
+      : static_cast<long>(readVulong());
+  const long deltaBase = readVslong();
+  if (widthCode == 0) {
+    // a fixed delta between all of the values
+    numLiterals = length + 1;
+    for (unsigned long i = 1; i < numLiterals; ++i) {
+      literals[i] = literals[i - 1] + deltaBase;
+    }
+  } else {
+    // the first delta carries the sign of all of the packed deltas
+    literals[1] = literals[0] + deltaBase;
+    const unsigned long packed = length == 0 ? 0 : length - 1;
+    numLiterals = packed + 2;
+    unpack(literals + 2, packed, decodeBitWidth(widthCode));
+    if (deltaBase < 0) {
+      for (unsigned long i = 2; i < numLiterals; ++i) {
+        literals[i] = literals[i - 1] - literals[i];
+      }
+    } else {
+      for (unsigned long i = 2; i < numLiterals; ++i) {
+        literals[i] = literals[i - 1] + literals[i];
+      }
+    }
+  }
+}
+
+void RleDecoderV2::seek(PositionProvider& location) {
+  // move the input stream
+  inputStream->seek(location);
+  // force a re-read from the stream
+  bufferEnd = bufferStart;
+  // drop the rest of the current run
+  numLiterals = 0;
+  usedLiterals = 0;
+  // skip ahead the given number of records
+  skip(location.next());
+}
+
+void RleDecoderV2::skip(unsigned long numValues) {
+  while (numValues > 0) {
+    if (usedLiterals == numLiterals) {
+      readRun();
+    }
+    unsigned long count = std::min(numValues, numLiterals - usedLiterals);
+    usedLiterals += count;
+    numValues -= count;
+  }
+}
+
+void RleDecoderV2::next(long* const data,
+                        const unsigned long numValues,
+                        const char* const notNull) {
+  if (notNull) {
+    readNonNulls(data, numValues, notNull, nonNulls,
+                 [this](long* values, unsigned long count) {
+                   nextValues(values, count);
+                 });
+  } else {
+    nextValues(data, numValues);
+  }
+}
+
+void RleDecoderV2::nextValues(long* const data,
+                              const unsigned long numValues) {
+  unsigned long position = 0;
+  while (position < numValues) {
+    // If we are out of values, read more.
+    if (usedLiterals == numLiterals) {
+      readRun();
+    }
+    unsigned long count =
+        std::min(numValues - position, numLiterals - usedLiterals);
+    memcpy(data + position, literals + usedLiterals, count * sizeof(long));
+    usedLiterals += count;
+    position += count;
+  }
+}
+
+}  // namespace orc
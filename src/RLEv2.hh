@@ -0,0 +1,108 @@
+/**
+* Licensed to the Apache Software Foundation (ASF) under one
+* or more contributor license agreements.  See the NOTICE file
+* distributed with this work for additional information
+* regarding copyright ownership.  The ASF licenses this file
+* to you under the Apache License, Version 2.0 (the
+* "License"); you may not use this file except in compliance
+* with the License.  You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef ORC_RLEV2_HH
+#define ORC_RLEV2_HH
+
+#include "RLE.hh"
+
+#include <memory>
+#include <vector>
+
+namespace orc {
+
+class RleDecoderV2 : public RleDecoder {
+public:
+    RleDecoderV2(std::unique_ptr<SeekableInputStream> input,
+                 bool isSigned);
+
+    /**
+    * Seek to a particular spot.
+    */
+    void seek(PositionProvider&) override;
+
+    /**
+    * Seek over a given number of values.
+    */
+    void skip(unsigned long numValues) override;
+
+    /**
+    * Read a number of values into the batch.
+    */
+    void next(long* data, unsigned long numValues, const char* notNull) override;
+
+    /**
+    * The largest number of values that a single run may hold.
+    */
+    static const unsigned long MAX_LITERAL_SIZE = 512;
+
+private:
+    inline unsigned char readByte();
+
+    inline unsigned long readVulong();
+
+    inline long readVslong();
+
+    inline unsigned long readLongBE(unsigned int numBytes);
+
+    /**
+    * Get a pointer to the next length bytes of the stream. The bytes are
+    * used in place when the current buffer holds all of them and are
+    * copied into the scratch buffer otherwise.
+    */
+    const unsigned char* readBytes(unsigned long length);
+
+    /**
+    * Unpack count big-endian values of the given bit width.
+    */
+    void unpack(long* data, unsigned long count, unsigned int width);
+
+    /**
+    * Decode the next run into the literals.
+    */
+    void readRun();
+
+    void readShortRepeat(unsigned char header);
+
+    void readDirect(unsigned char header);
+
+    void readPatchedBase(unsigned char header);
+
+    void readDelta(unsigned char header);
+
+    /**
+    * Read values without nulls.
+    */
+    void nextValues(long* data, unsigned long numValues);
+
+    const std::unique_ptr<SeekableInputStream> inputStream;
+    const bool isSigned;
+    const char *bufferStart;
+    const char *bufferEnd;
+    // the decoded values of the current run
+    long literals[MAX_LITERAL_SIZE];
+    unsigned long numLiterals;
+    unsigned long usedLiterals;
+    // holds packed values that span input buffers
+    std::vector<unsigned char> scratch;
+    // the non-null values of the current batch before they are expanded
+    std::vector<long> nonNulls;
+};
+}  // namespace orc
+
+#endif  // ORC_RLEV2_HH
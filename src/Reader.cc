@@ -20,7 +20,9 @@
 #include "orc/OrcFile.hh"
 #include "ColumnReader.hh"
 #include "Exceptions.hh"
+#include "Metrics.hh"
 #include "RLE.hh"
+#include "StripePlanner.hh"
 #include "TypeImpl.hh"
 
 #include <google/protobuf/text_format.h>
@@ -28,9 +30,11 @@
 #include <algorithm>
 #include <iostream>
 #include <limits>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <string.h>
 #include <vector>
 
 namespace orc {
@@ -46,11 +50,23 @@ namespace orc {
     unsigned long dataStart;
     unsigned long dataLength;
     unsigned long tailLocation;
+    unsigned long coalesceGap;
+    bool prefetch;
+    bool dropConsumedStripes;
+    unsigned int decompressionThreads;
+    unsigned long tailReadSize;
+    std::shared_ptr<FileTailCache> fileTailCache;
+    std::shared_ptr<BufferPool> bufferPool;
     ReaderOptionsPrivate() {
       includedColumns.push_back(0);
       dataStart = 0;
       dataLength = std::numeric_limits<unsigned long>::max();
       tailLocation = std::numeric_limits<unsigned long>::max();
+      coalesceGap = 64 * 1024;
+      prefetch = false;
+      dropConsumedStripes = false;
+      decompressionThreads = 0;
+      tailReadSize = 16 * 1024;
     }
   };
 
@@ -109,6 +125,43 @@ namespace orc {
     return *this;
   }
 
+  ReaderOptions& ReaderOptions::setCoalesceGap(unsigned long gap) {
+    privateBits->coalesceGap = gap;
+    return *this;
+  }
+
+  ReaderOptions& ReaderOptions::setPrefetch(bool prefetch) {
+    privateBits->prefetch = prefetch;
+    return *this;
+  }
+
+  ReaderOptions& ReaderOptions::setDropConsumedStripes(bool drop) {
+    privateBits->dropConsumedStripes = drop;
+    return *this;
+  }
+
+  ReaderOptions& ReaderOptions::setDecompressionThreads(unsigned int threads) {
+    privateBits->decompressionThreads = threads;
+    return *this;
+  }
+
+  ReaderOptions& ReaderOptions::setTailReadSize(unsigned long size) {
+    privateBits->tailReadSize = size;
+    return *this;
+  }
+
+  ReaderOptions& ReaderOptions::setFileTailCache
+                     (std::shared_ptr<FileTailCache> cache) {
+    privateBits->fileTailCache = cache;
+    return *this;
+  }
+
+  ReaderOptions& ReaderOptions::setBufferPool
+                     (std::shared_ptr<BufferPool> pool) {
+    privateBits->bufferPool = pool;
+    return *this;
+  }
+
   const std::list<int>& ReaderOptions::getInclude() const {
     return privateBits->includedColumns;
   }
@@ -125,35 +178,86 @@ namespace orc {
     return privateBits->tailLocation;
   }
 
+  unsigned long ReaderOptions::getCoalesceGap() const {
+    return privateBits->coalesceGap;
+  }
+
+  bool ReaderOptions::getPrefetch() const {
+    return privateBits->prefetch;
+  }
+
+  bool ReaderOptions::getDropConsumedStripes() const {
+    return privateBits->dropConsumedStripes;
+  }
+
+  unsigned int ReaderOptions::getDecompressionThreads() const {
+    return privateBits->decompressionThreads;
+  }
+
+  unsigned long ReaderOptions::getTailReadSize() const {
+    return privateBits->tailReadSize;
+  }
+
+  std::shared_ptr<FileTailCache> ReaderOptions::getFileTailCache() const {
+    return privateBits->fileTailCache;
+  }
+
+  std::shared_ptr<BufferPool> ReaderOptions::getBufferPool() const {
+    return privateBits->bufferPool;
+  }
+
   Reader::~Reader() {
     // PASS
   }
 
-  static const unsigned long DIRECTORY_SIZE_GUESS = 16 * 1024;
+  // the postscript's length is stored in one byte
+  static const unsigned long MAX_POSTSCRIPT_SIZE = 255;
+
+  /**
+   * The parsed postscript, footer, metadata, and schema of a file. It
+   * never changes once it is read, so readers of the same file can share it.
+   */
+  struct FileTail {
+    proto::PostScript postscript;
+    unsigned long postscriptLength;
+    unsigned long blockSize;
+    CompressionKind compression;
+    proto::Footer footer;
+    proto::Metadata metadata;
+    std::unique_ptr<Type> schema;
+  };
+
+  /**
+   * The footer and the selected streams of a stripe.
+   */
+  struct LoadedStripe {
+    unsigned long stripeIndex;
+    proto::StripeFooter footer;
+    StripeBuffer buffer;
+    // the streams that were decompressed up front by their file offset
+    std::map<unsigned long, std::vector<DecompressedChunk>> decompressed;
+  };
 
   class ReaderImpl : public Reader {
   private:
+    // declared first so that the stream can count into it
+    std::unique_ptr<MetricsCollector> metrics;
+
     // inputs
     std::unique_ptr<InputStream> stream;
     ReaderOptions options;
     std::unique_ptr<bool[]> selectedColumns;
+    // declared early so that it outlives the buffers taken from it
+    std::shared_ptr<BufferPool> bufferPool;
 
-    // postscript
-    proto::PostScript postscript;
+    // postscript, footer, and metadata
+    std::shared_ptr<const FileTail> fileTail;
+    const proto::Footer& footer;
     unsigned long blockSize;
     CompressionKind compression;
-    unsigned long postscriptLength;
-
-    // footer
-    proto::Footer footer;
     std::unique_ptr<unsigned long[]> firstRowOfStripe;
 //    std::vector<unsigned long> firstRowOfStripe;
     unsigned long numberOfStripes;
-    std::unique_ptr<Type> schema;
-
-    // metadata
-    bool isMetadataLoaded;
-    proto::Metadata metadata;
 
     // reading state
     unsigned long previousRow;
@@ -161,17 +265,24 @@ namespace orc {
     unsigned long currentRowInStripe;
     unsigned long rowsInCurrentStripe;
     proto::StripeInformation currentStripeInfo;
-    proto::StripeFooter currentStripeFooter;
+    std::unique_ptr<LoadedStripe> currentStripeData;
     std::unique_ptr<ColumnReader> reader;
 
+    // prefetching state, the task must be destroyed before its target
+    std::unique_ptr<LoadedStripe> nextStripeData;
+    std::unique_ptr<AsyncTask> prefetchTask;
+
     // internal methods
-    void readPostscript(char * buffer, unsigned long length);
-    void readFooter(char *buffer, unsigned long length,
-                    unsigned long fileLength);
-    proto::StripeFooter getStripeFooter(const proto::StripeInformation& info);
+    static std::shared_ptr<const FileTail> getFileTail
+                              (InputStream& stream,
+                               const ReaderOptions& options);
+    proto::StripeFooter getStripeFooter(const proto::StripeInformation& info
+                                        ) const;
+    void loadStripe(unsigned long stripeIndex, LoadedStripe& result) const;
+    void decompressStreams(const std::vector<ReadRange>& streams,
+                           LoadedStripe& result) const;
+    void startPrefetch(unsigned long stripeIndex);
     void startNextStripe();
-    void ensureOrcFooter(char* buffer, unsigned long length);
-    void checkOrcVersion();
     void selectTypeParent(int columnId);
     void selectTypeChildren(int columnId);
     std::unique_ptr<ColumnVectorBatch> createRowBatch(const Type& type, 
@@ -216,6 +327,10 @@ namespace orc {
 
     const bool* getSelectedColumns() const override;
 
+    BufferPool* getBufferPool() const;
+
+    MetricsCollector* getMetricsCollector() const;
+
     std::unique_ptr<ColumnVectorBatch> createRowBatch(unsigned long size
                                                       ) const override;
 
@@ -224,28 +339,168 @@ namespace orc {
     unsigned long getRowNumber() const override;
 
     void seekToRow(unsigned long rowNumber) override;
-  };
 
-  InputStream::~InputStream() {
-    // PASS
+    ReaderMetrics getMetrics() const override;
   };
 
-  ReaderImpl::ReaderImpl(std::unique_ptr<InputStream> input,
-                         const ReaderOptions& opts
-                         ): stream(std::move(input)), options(opts) {
-    isMetadataLoaded = false;
+  static void ensureOrcFooter(char*, unsigned long) {
+    // TODO fix me
+  }
+
+  static void checkOrcVersion(const proto::PostScript&) {
+    // TODO
+  }
+
+  static void readPostscript(FileTail& tail, char *buffer,
+                             unsigned long readSize) {
+    if (readSize == 0) {
+      throw ParseError("file is empty");
+    }
+
+    //get length of PostScript
+    tail.postscriptLength = buffer[readSize - 1] & 0xff;
+    if (readSize < tail.postscriptLength + 1) {
+      throw ParseError("postscript is larger than the file");
+    }
+
+    ensureOrcFooter(buffer, readSize);
+
+    if (!tail.postscript.ParseFromArray(buffer + readSize - 1 -
+                                        tail.postscriptLength,
+                                        static_cast<int>
+                                        (tail.postscriptLength))) {
+      throw ParseError("bad postscript parse");
+    }
+    if (tail.postscript.has_compressionblocksize()) {
+      tail.blockSize = tail.postscript.compressionblocksize();
+    } else {
+      tail.blockSize = 256 * 1024;
+    }
+
+    checkOrcVersion(tail.postscript);
+
+    //check compression codec
+    tail.compression =
+      static_cast<CompressionKind>(tail.postscript.compression());
+  }
+
+  static void readFooter(FileTail& tail, char* buffer,
+                         unsigned long footerSize) {
+    std::unique_ptr<SeekableInputStream> pbStream =
+      createCodec(tail.compression,
+                  std::unique_ptr<SeekableInputStream>
+                  (new SeekableArrayInputStream(buffer, footerSize)),
+                  tail.blockSize);
+    // TODO: do not SeekableArrayInputStream, rather use an array
+//    if (!footer.ParseFromArray(buffer+readSize-tailSize, footerSize)) {
+    if (!tail.footer.ParseFromZeroCopyStream(pbStream.get())) {
+      throw ParseError("bad footer parse");
+    }
+  }
+
+  static void readMetadata(FileTail& tail, char* buffer,
+                           unsigned long metadataSize) {
+    if (metadataSize != 0) {
+      std::unique_ptr<SeekableInputStream> pbStream =
+        createCodec(tail.compression,
+                    std::unique_ptr<SeekableInputStream>
+                    (new SeekableArrayInputStream(buffer, metadataSize)),
+                    tail.blockSize);
+      if (!tail.metadata.ParseFromZeroCopyStream(pbStream.get())) {
+        throw ParseError("bad metadata parse");
+      }
+    }
+  }
+
+  /**
+   * Read and parse the tail of the file.
+   * @param stream the file to read
+   * @param size the logical length of the file
+   * @param options the reader options
+   */
+  static std::shared_ptr<const FileTail> readFileTail
+                            (InputStream& stream, unsigned long size,
+                             const ReaderOptions& options) {
+    std::shared_ptr<FileTail> tail = std::make_shared<FileTail>();
+    // guess how big the tail is and read it speculatively
+    unsigned long readSize =
+      std::min(size, std::max(options.getTailReadSize(),
+                              MAX_POSTSCRIPT_SIZE + 1));
+    std::unique_ptr<char[]> buffer = 
+      std::unique_ptr<char[]>(new char[readSize]);
+    stream.read(buffer.get(), size - readSize, readSize);
+    readPostscript(*tail, buffer.get(), readSize);
+
+    // if the guess was too small, read the rest of the tail in one request
+    unsigned long footerSize = tail->postscript.footerlength();
+    unsigned long metadataSize = tail->postscript.metadatalength();
+    // the lengths come from the file, so check each one before adding them
+    unsigned long available = size - 1 - tail->postscriptLength;
+    if (footerSize > available || metadataSize > available - footerSize) {
+      throw ParseError("file tail is larger than the file");
+    }
+    unsigned long tailSize = 1 + tail->postscriptLength + footerSize +
+      metadataSize;
+    if (tailSize > readSize) {
+      std::unique_ptr<char[]> wholeTail =
+        std::unique_ptr<char[]>(new char[tailSize]);
+      stream.read(wholeTail.get(), size - tailSize, tailSize - readSize);
+      memcpy(wholeTail.get() + (tailSize - readSize), buffer.get(),
+             readSize);
+      buffer = std::move(wholeTail);
+      readSize = tailSize;
+    }
+    char* footerStart = buffer.get() + readSize - 1 - tail->postscriptLength -
+      footerSize;
+    readFooter(*tail, footerStart, footerSize);
+    readMetadata(*tail, footerStart - metadataSize, metadataSize);
+
+    tail->schema = convertType(tail->footer.types(0), tail->footer);
+    tail->schema->assignIds(0);
+    return tail;
+  }
+
+  /**
+   * Get the file tail from the cache in the options or read it.
+   */
+  std::shared_ptr<const FileTail> ReaderImpl::getFileTail
+                            (InputStream& stream,
+                             const ReaderOptions& options) {
     // figure out the size of the file using the option or filesystem
     unsigned long size = std::min(options.getTailLocation(), 
                                   static_cast<unsigned long>
-                                     (stream->getLength()));
+                                     (stream.getLength()));
+    std::shared_ptr<FileTailCache> cache = options.getFileTailCache();
+    long modificationTime = stream.getModificationTime();
+    if (!cache || modificationTime == 0) {
+      return readFileTail(stream, size, options);
+    }
+    std::ostringstream key;
+    key << stream.getName() << '\0' << size << '\0' << modificationTime;
+    std::shared_ptr<const FileTail> result = cache->get(key.str());
+    if (!result) {
+      result = readFileTail(stream, size, options);
+      cache->put(key.str(), result);
+    }
+    return result;
+  }
 
-    //read last bytes into buffer to get PostScript
-    unsigned long readSize = std::min(size, DIRECTORY_SIZE_GUESS);
-    std::unique_ptr<char[]> buffer = 
-      std::unique_ptr<char[]>(new char[readSize]);
-    stream->read(buffer.get(), size - readSize, readSize);
-    readPostscript(buffer.get(), readSize);
-    readFooter(buffer.get(), readSize, size);
+  ReaderImpl::ReaderImpl(std::unique_ptr<InputStream> input,
+                         const ReaderOptions& opts
+                         ): metrics(new MetricsCollector(0)),
+                            stream(new MeteredInputStream(std::move(input),
+                                                          *metrics)),
+                            options(opts),
+                            fileTail(getFileTail(*stream, options)),
+                            footer(fileTail->footer) {
+    bufferPool = options.getBufferPool();
+    if (!bufferPool) {
+      bufferPool = std::make_shared<BufferPool>();
+    }
+    metrics->columns.resize(static_cast<size_t>(footer.types_size()));
+    blockSize = fileTail->blockSize;
+    compression = fileTail->compression;
+    numberOfStripes = static_cast<unsigned long>(footer.stripes_size());
 
     currentStripe = 0;
     currentRowInStripe = 0;
@@ -262,8 +517,13 @@ namespace orc {
       selectTypeParent(columnId);
       selectTypeChildren(columnId);
     }
-    schema = convertType(footer.types(0), footer);
-    schema->assignIds(0);
+    // kernel read ahead only helps if every column is read
+    bool readAll = true;
+    for(int i=0; i < footer.types_size(); ++i) {
+      readAll = readAll && selectedColumns.get()[i];
+    }
+    stream->advise(0, static_cast<unsigned long>(stream->getLength()),
+                   readAll ? ReadAdvice_SEQUENTIAL : ReadAdvice_RANDOM);
     previousRow = std::numeric_limits<unsigned long>::max();
   }
                          
@@ -352,16 +612,12 @@ namespace orc {
     }
   }
 
-  void ReaderImpl::ensureOrcFooter(char*, unsigned long) {
-    // TODO fix me
-  }
-
   const bool* ReaderImpl::getSelectedColumns() const {
     return selectedColumns.get();
   }
 
   const Type& ReaderImpl::getType() const {
-    return *(schema.get());
+    return *(fileTail->schema);
   }
 
   unsigned long ReaderImpl::getRowNumber() const {
@@ -376,64 +632,19 @@ namespace orc {
     throw NotImplementedYet("seekToRow");
   }
 
-  void ReaderImpl::readPostscript(char *buffer, unsigned long readSize) {
-
-    //get length of PostScript
-    postscriptLength = buffer[readSize - 1] & 0xff;
-
-    ensureOrcFooter(buffer, readSize);
-
-    if (!postscript.ParseFromArray(buffer+readSize-1-postscriptLength, 
-                                   static_cast<int>(postscriptLength))) {
-      throw ParseError("bad postscript parse");
-    }
-    if (postscript.has_compressionblocksize()) {
-      blockSize = postscript.compressionblocksize();
-    } else {
-      blockSize = 256 * 1024;
-    }
-
-    checkOrcVersion();
-
-    //check compression codec
-    compression = static_cast<CompressionKind>(postscript.compression());
-  }
-
-  void ReaderImpl::readFooter(char* buffer, unsigned long readSize,
-                              unsigned long) {
-    unsigned long footerSize = postscript.footerlength();
-    //check if extra bytes need to be read
-    unsigned long tailSize = 1 + postscriptLength + footerSize;
-    if (tailSize > readSize) {
-      throw NotImplementedYet("need more footer data.");
-    }
-    std::unique_ptr<SeekableInputStream> pbStream =createCodec(compression,
-                          std::unique_ptr<SeekableInputStream>
-                          (new SeekableArrayInputStream(buffer +
-                                                        (readSize - tailSize),
-                                                        footerSize)),
-                          blockSize);
-    // TODO: do not SeekableArrayInputStream, rather use an array
-//    if (!footer.ParseFromArray(buffer+readSize-tailSize, footerSize)) {
-    if (!footer.ParseFromZeroCopyStream(pbStream.get())) {
-      throw ParseError("bad footer parse");
-    }
-    numberOfStripes = static_cast<unsigned long>(footer.stripes_size());
-  }
-
   proto::StripeFooter ReaderImpl::getStripeFooter
-                        (const proto::StripeInformation& info) {
+                        (const proto::StripeInformation& info) const {
     unsigned long footerStart = info.offset() + info.indexlength() +
       info.datalength();
     unsigned long footerLength = info.footerlength();
     std::unique_ptr<SeekableInputStream> pbStream = 
       createCodec(compression,
-                  std::unique_ptr<SeekableInputStream>
-                  (new SeekableFileInputStream(stream.get(), footerStart,
-                                               footerLength, 
-                                               static_cast<long>(blockSize)
-                                               )),
-                  blockSize);
+                  createSeekableFileStream(stream.get(), footerStart,
+                                           footerLength,
+                                           static_cast<long>(blockSize),
+                                           bufferPool.get()),
+                  blockSize,
+                  metrics.get());
     proto::StripeFooter result;
     if (!result.ParseFromZeroCopyStream(pbStream.get())) {
       throw ParseError(std::string("bad StripeFooter from ") + 
@@ -448,12 +659,13 @@ namespace orc {
     const proto::StripeFooter& footer;
     const unsigned long stripeStart;
     InputStream& input;
+    const LoadedStripe& stripe;
 
   public:
     StripeStreamsImpl(const ReaderImpl& reader,
-                      const proto::StripeFooter& footer,
                       unsigned long stripeStart,
-                      InputStream& input);
+                      InputStream& input,
+                      const LoadedStripe& stripe);
 
     virtual ~StripeStreamsImpl();
 
@@ -464,16 +676,21 @@ namespace orc {
     virtual std::unique_ptr<SeekableInputStream> 
                     getStream(int columnId,
                               proto::Stream_Kind kind) const override;
+
+    virtual BufferPool* getBufferPool() const override;
+
+    virtual MetricsCollector* getMetrics() const override;
   };
 
   StripeStreamsImpl::StripeStreamsImpl(const ReaderImpl& _reader,
-                                       const proto::StripeFooter& _footer,
                                        unsigned long _stripeStart,
-                                       InputStream& _input
+                                       InputStream& _input,
+                                       const LoadedStripe& _stripe
                                        ): reader(_reader), 
-                                          footer(_footer),
+                                          footer(_stripe.footer),
                                           stripeStart(_stripeStart),
-                                          input(_input) {
+                                          input(_input),
+                                          stripe(_stripe) {
     // PASS
   }
 
@@ -489,6 +706,14 @@ namespace orc {
     return footer.columns(columnId);
   }
 
+  BufferPool* StripeStreamsImpl::getBufferPool() const {
+    return reader.getBufferPool();
+  }
+
+  MetricsCollector* StripeStreamsImpl::getMetrics() const {
+    return reader.getMetricsCollector();
+  }
+
   std::unique_ptr<SeekableInputStream> 
         StripeStreamsImpl::getStream(int columnId,
                                      proto::Stream_Kind kind) const {
@@ -497,32 +722,149 @@ namespace orc {
       const proto::Stream& stream = footer.streams(i);
       if (stream.kind() == kind && 
           stream.column() == static_cast<unsigned int>(columnId)) {
+        auto decompressed = stripe.decompressed.find(offset);
+        if (decompressed != stripe.decompressed.end()) {
+          std::ostringstream name;
+          name << input.getName() << " from " << offset << " for "
+               << stream.length();
+          return std::unique_ptr<SeekableInputStream>
+            (new DecompressedInputStream(decompressed->second, name.str()));
+        }
         return createCodec(reader.getCompression(),
-                           std::unique_ptr<SeekableInputStream>
-                           (new SeekableFileInputStream
+                           stripe.buffer.getStream
                             (&input,
                              offset,
                              stream.length(),
-                             static_cast<long>(reader.getCompressionSize()))),
-                           reader.getCompressionSize());
+                             static_cast<long>(reader.getCompressionSize())),
+                           reader.getCompressionSize(),
+                           reader.getMetricsCollector());
       }
       offset += stream.length();
     }
     return std::unique_ptr<SeekableInputStream>();
   }
 
+  void ReaderImpl::loadStripe(unsigned long stripeIndex,
+                              LoadedStripe& result) const {
+    const proto::StripeInformation& info =
+      footer.stripes(static_cast<int>(stripeIndex));
+    result.stripeIndex = stripeIndex;
+    result.footer = getStripeFooter(info);
+    std::vector<ReadRange> streams =
+      planStripeReads(result.footer, info.offset(),
+                      info.indexlength() + info.datalength(),
+                      selectedColumns.get(),
+                      static_cast<unsigned long>(footer.types_size()));
+    std::vector<ReadRange> ranges =
+      coalesceRanges(streams, options.getCoalesceGap());
+    // let the operating system fetch all of the ranges at once
+    for(const ReadRange& range: ranges) {
+      stream->advise(range.offset, range.length, ReadAdvice_WILL_NEED);
+    }
+    if (stream->getData()) {
+      result.buffer.clear();
+    } else {
+      // read the selected streams with a few large requests
+      result.buffer.load(*(stream.get()), ranges, bufferPool.get());
+    }
+    result.decompressed.clear();
+    if (options.getDecompressionThreads() > 0 &&
+        compression != CompressionKind_NONE) {
+      decompressStreams(streams, result);
+    }
+  }
+
+  void ReaderImpl::decompressStreams(const std::vector<ReadRange>& streams,
+                                     LoadedStripe& result) const {
+    // find every compressed chunk of the streams
+    const char* fileData = stream->getData();
+    const unsigned long fileLength =
+      static_cast<unsigned long>(stream->getLength());
+    std::vector<std::string> names;
+    names.reserve(streams.size());
+    std::vector<std::pair<DecompressedChunk*, const std::string*>> tasks;
+    for(const ReadRange& range: streams) {
+      std::ostringstream name;
+      name << stream->getName() << " from " << range.offset << " for "
+           << range.length;
+      const char* bytes;
+      if (fileData) {
+        if (range.offset > fileLength ||
+            range.length > fileLength - range.offset) {
+          throw ParseError(name.str() + " is past the end of the file");
+        }
+        bytes = fileData + range.offset;
+      } else {
+        bytes = result.buffer.getRange(range.offset, range.length);
+        if (bytes == nullptr) {
+          continue;
+        }
+      }
+      names.push_back(name.str());
+      std::vector<DecompressedChunk>& chunks =
+        result.decompressed[range.offset];
+      chunks = findChunks(bytes, range.length, names.back());
+      for(DecompressedChunk& chunk: chunks) {
+        if (chunk.isOriginal) {
+          metrics->decompressedBytes += chunk.length;
+        } else {
+          tasks.push_back(std::make_pair(&chunk, &names.back()));
+        }
+      }
+    }
+
+    // each thread keeps its own decompressor
+    unsigned int threads = options.getDecompressionThreads();
+    std::vector<std::unique_ptr<Decompressor>> decompressors(threads);
+    runInParallel(tasks.size(), threads,
+                  [this, &tasks, &decompressors](unsigned int worker,
+                                                 unsigned long task) {
+                    if (!decompressors[worker]) {
+                      decompressors[worker] = createDecompressor(compression);
+                    }
+                    DecompressedChunk& chunk = *(tasks[task].first);
+                    unsigned long start = getNanoTime();
+                    decompressChunk(*(decompressors[worker]), chunk,
+                                    blockSize, bufferPool.get(),
+                                    *(tasks[task].second));
+                    metrics->decompressionNanos += getNanoTime() - start;
+                    metrics->decompressedBytes += chunk.length;
+                  });
+  }
+
+  void ReaderImpl::startPrefetch(unsigned long stripeIndex) {
+    if (!prefetchTask) {
+      prefetchTask.reset(new AsyncTask());
+    }
+    nextStripeData.reset(new LoadedStripe());
+    LoadedStripe* target = nextStripeData.get();
+    prefetchTask->start([this, stripeIndex, target] {
+        loadStripe(stripeIndex, *target);
+      });
+  }
+
   void ReaderImpl::startNextStripe() {
     currentStripeInfo = footer.stripes(static_cast<int>(currentStripe));
-    currentStripeFooter = getStripeFooter(currentStripeInfo);
     rowsInCurrentStripe = currentStripeInfo.numberofrows();
-    StripeStreamsImpl stripeStreams(*this, currentStripeFooter, 
-                                    currentStripeInfo.offset(),
-                                    *(stream.get()));
-    reader = buildReader(*(schema.get()), stripeStreams);
-  }
-
-  void ReaderImpl::checkOrcVersion() {
-    // TODO
+    // the previous stripe's readers may point into its buffers
+    reader.reset();
+    if (prefetchTask && prefetchTask->isPending()) {
+      prefetchTask->wait();
+    }
+    if (nextStripeData && nextStripeData->stripeIndex == currentStripe) {
+      currentStripeData = std::move(nextStripeData);
+    } else {
+      if (!currentStripeData) {
+        currentStripeData.reset(new LoadedStripe());
+      }
+      loadStripe(currentStripe, *currentStripeData);
+    }
+    if (options.getPrefetch() && currentStripe + 1 < numberOfStripes) {
+      startPrefetch(currentStripe + 1);
+    }
+    StripeStreamsImpl stripeStreams(*this, currentStripeInfo.offset(),
+                                    *(stream.get()), *currentStripeData);
+    reader = buildReader(*(fileTail->schema), stripeStreams);
   }
 
   bool ReaderImpl::next(ColumnVectorBatch& data) {
@@ -541,12 +883,31 @@ namespace orc {
     previousRow = firstRowOfStripe.get()[currentStripe] + currentRowInStripe;
     currentRowInStripe += rowsToRead;
     if (currentRowInStripe >= rowsInCurrentStripe) {
+      if (options.getDropConsumedStripes()) {
+        stream->advise(currentStripeInfo.offset(),
+                       currentStripeInfo.indexlength() +
+                         currentStripeInfo.datalength() +
+                         currentStripeInfo.footerlength(),
+                       ReadAdvice_DONT_NEED);
+      }
       currentStripe += 1;
       currentRowInStripe = 0;
     }
     return rowsToRead != 0;
   }
 
+  BufferPool* ReaderImpl::getBufferPool() const {
+    return bufferPool.get();
+  }
+
+  MetricsCollector* ReaderImpl::getMetricsCollector() const {
+    return metrics.get();
+  }
+
+  ReaderMetrics ReaderImpl::getMetrics() const {
+    return metrics->getMetrics();
+  }
+
   std::unique_ptr<ColumnVectorBatch> ReaderImpl::createRowBatch
        (const Type& type, unsigned long capacity) const {
     switch (type.getKind()) {
@@ -609,7 +970,7 @@ namespace orc {
 
   std::unique_ptr<ColumnVectorBatch> ReaderImpl::createRowBatch
        (unsigned long capacity) const {
-    return createRowBatch(*(schema.get()), capacity);
+    return createRowBatch(*(fileTail->schema), capacity);
   }
 
   std::unique_ptr<Reader> createReader(std::unique_ptr<InputStream> stream, 
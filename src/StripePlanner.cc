@@ -0,0 +1,306 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StripePlanner.hh"
+#include "Exceptions.hh"
+
+#include <uv.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace orc {
+
+  std::vector<ReadRange> planStripeReads(const proto::StripeFooter& footer,
+                                         unsigned long stripeStart,
+                                         unsigned long streamsLength,
+                                         const bool* selectedColumns,
+                                         unsigned long columnCount) {
+    std::vector<ReadRange> result;
+    unsigned long used = 0;
+    for(int i = 0; i < footer.streams_size(); ++i) {
+      const proto::Stream& stream = footer.streams(i);
+      if (stream.column() >= columnCount) {
+        throw ParseError("stream " + std::to_string(i) + " has bad column " +
+                         std::to_string(stream.column()));
+      }
+      if (stream.length() > streamsLength - used) {
+        throw ParseError("stream " + std::to_string(i) +
+                         " is past the end of the stripe");
+      }
+      if (stream.kind() != proto::Stream_Kind_ROW_INDEX &&
+          selectedColumns[stream.column()] && stream.length() > 0) {
+        result.push_back({stripeStart + used, stream.length()});
+      }
+      used += stream.length();
+    }
+    return result;
+  }
+
+  void runInParallel(unsigned long taskCount,
+                     unsigned int maxThreads,
+                     const std::function<void(unsigned int, unsigned long)>&
+                       task) {
+    std::atomic<unsigned long> next(0);
+    std::mutex errorLock;
+    std::exception_ptr error;
+    auto worker = [taskCount, &task, &next, &errorLock, &error]
+      (unsigned int workerId) {
+      for(unsigned long i = next++; i < taskCount; i = next++) {
+        try {
+          task(workerId, i);
+        } catch (...) {
+          std::lock_guard<std::mutex> guard(errorLock);
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+      }
+    };
+    unsigned int threadCount = static_cast<unsigned int>
+      (std::min(static_cast<unsigned long>(std::max(maxThreads, 1U)),
+                taskCount));
+    std::vector<std::thread> threads;
+    if (threadCount > 1) {
+      threads.reserve(threadCount - 1);
+    }
+    for(unsigned int i=1; i < threadCount; ++i) {
+      threads.push_back(std::thread(worker, i));
+    }
+    // the caller takes a share of the tasks too
+    worker(0);
+    for(std::thread& thread: threads) {
+      thread.join();
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  void readRangesInParallel(InputStream& input,
+                            const std::vector<ReadRequest>& requests,
+                            unsigned int maxParallelReads) {
+    if (requests.size() < 2 || maxParallelReads < 2) {
+      input.InputStream::readRanges(requests);
+      return;
+    }
+    // the reads are blocking, so they get their own threads rather than
+    // occupying libuv's pool, which prefetching may already be waiting on
+    runInParallel(requests.size(), maxParallelReads,
+                  [&input, &requests](unsigned int, unsigned long i) {
+                    input.read(requests[i].buffer, requests[i].offset,
+                               requests[i].length);
+                  });
+  }
+
+  std::vector<ReadRange> coalesceRanges(std::vector<ReadRange> ranges,
+                                        unsigned long maxGap) {
+    std::sort(ranges.begin(), ranges.end(),
+              [](const ReadRange& left, const ReadRange& right) {
+                return left.offset < right.offset;
+              });
+    unsigned long largest = 0;
+    for(const ReadRange& range: ranges) {
+      largest = std::max(largest, range.length);
+    }
+    const unsigned long maxLength =
+      maxGap > (std::numeric_limits<unsigned long>::max() - largest) / 4 ?
+      std::numeric_limits<unsigned long>::max() : largest + 4 * maxGap;
+    std::vector<ReadRange> result;
+    for(const ReadRange& range: ranges) {
+      if (!result.empty()) {
+        ReadRange& last = result.back();
+        unsigned long lastEnd = last.offset + last.length;
+        unsigned long end = std::max(lastEnd, range.offset + range.length);
+        // overlapping ranges have to merge, close ones only up to the cap
+        if (range.offset < lastEnd ||
+            (range.offset - lastEnd <= maxGap &&
+             end - last.offset <= maxLength)) {
+          last.length = end - last.offset;
+          continue;
+        }
+      }
+      result.push_back(range);
+    }
+    return result;
+  }
+
+  StripeBuffer::StripeBuffer(): pool(nullptr) {
+    // PASS
+  }
+
+  StripeBuffer::~StripeBuffer() {
+    // PASS
+  }
+
+  void StripeBuffer::clear() {
+    blocks.clear();
+  }
+
+  void StripeBuffer::load(InputStream& input,
+                          const std::vector<ReadRange>& ranges,
+                          BufferPool* _pool) {
+    pool = _pool;
+    blocks.clear();
+    const std::vector<ReadRange>* reads = &ranges;
+    std::vector<ReadRange> aligned;
+    unsigned long alignment = input.getReadAlignment();
+    if (alignment > 1) {
+      // widen each range to the alignment, but not past the end of the file,
+      // and merge the ranges that now overlap
+      unsigned long fileLength =
+        static_cast<unsigned long>(input.getLength());
+      aligned.reserve(ranges.size());
+      for(const ReadRange& range: ranges) {
+        unsigned long start = range.offset - range.offset % alignment;
+        unsigned long end = range.offset + range.length;
+        unsigned long alignedEnd = end + (alignment - end % alignment) %
+          alignment;
+        end = std::max(end, std::min(alignedEnd, fileLength));
+        // the ranges are sorted, so only the last one can touch this one
+        if (!aligned.empty() &&
+            start <= aligned.back().offset + aligned.back().length) {
+          aligned.back().length = end - aligned.back().offset;
+        } else {
+          aligned.push_back({start, end - start});
+        }
+      }
+      reads = &aligned;
+    }
+    blocks.reserve(reads->size());
+    std::vector<ReadRequest> requests;
+    requests.reserve(reads->size());
+    for(const ReadRange& range: *reads) {
+      Block block;
+      block.offset = range.offset;
+      block.length = range.length;
+      block.data.reset(pool, range.length);
+      requests.push_back({block.data.get(), range.offset, range.length});
+      blocks.push_back(std::move(block));
+    }
+    if (!requests.empty()) {
+      input.readRanges(requests);
+    }
+  }
+
+  const char* StripeBuffer::getRange(unsigned long offset,
+                                     unsigned long length) const {
+    // find the last block that starts at or before the offset
+    auto block = std::upper_bound(blocks.begin(), blocks.end(), offset,
+                                  [](unsigned long value, const Block& b) {
+                                    return value < b.offset;
+                                  });
+    if (block == blocks.begin()) {
+      return nullptr;
+    }
+    --block;
+    if (offset + length > block->offset + block->length) {
+      return nullptr;
+    }
+    return block->data.get() + (offset - block->offset);
+  }
+
+  std::unique_ptr<SeekableInputStream>
+      StripeBuffer::getStream(InputStream* input,
+                              unsigned long offset,
+                              unsigned long length,
+                              long blockSize) const {
+    const char* data = getRange(offset, length);
+    if (data) {
+      unsigned long chunkSize =
+        std::min(length, static_cast<unsigned long>
+                            (std::numeric_limits<int>::max()));
+      return std::unique_ptr<SeekableInputStream>
+        (new SeekableArrayInputStream(data, length,
+                                      static_cast<long>(chunkSize)));
+    }
+    return createSeekableFileStream(input, offset, length, blockSize, pool);
+  }
+
+  struct AsyncTaskPrivate {
+    uv_loop_t loop;
+    uv_work_t request;
+    std::function<void()> work;
+    std::exception_ptr error;
+    bool pending;
+
+    static void run(uv_work_t* request) {
+      AsyncTaskPrivate* task = static_cast<AsyncTaskPrivate*>(request->data);
+      try {
+        task->work();
+      } catch (...) {
+        task->error = std::current_exception();
+      }
+    }
+
+    static void finish(uv_work_t*, int) {
+      // PASS
+    }
+  };
+
+  AsyncTask::AsyncTask(): privateBits(new AsyncTaskPrivate()) {
+    if (uv_loop_init(&privateBits->loop) != 0) {
+      throw std::runtime_error("can't create event loop for prefetch");
+    }
+    privateBits->request.data = privateBits.get();
+    privateBits->pending = false;
+  }
+
+  AsyncTask::~AsyncTask() {
+    // the work refers to the caller's memory, so it must finish first
+    uv_run(&privateBits->loop, UV_RUN_DEFAULT);
+    uv_loop_close(&privateBits->loop);
+  }
+
+  void AsyncTask::start(std::function<void()> work) {
+    if (privateBits->pending) {
+      throw std::logic_error("task is already running");
+    }
+    privateBits->work = work;
+    privateBits->error = nullptr;
+    if (uv_queue_work(&privateBits->loop, &privateBits->request,
+                      &AsyncTaskPrivate::run,
+                      &AsyncTaskPrivate::finish) != 0) {
+      throw std::runtime_error("can't queue work for prefetch");
+    }
+    privateBits->pending = true;
+  }
+
+  bool AsyncTask::isPending() const {
+    return privateBits->pending;
+  }
+
+  void AsyncTask::wait() {
+    if (!privateBits->pending) {
+      return;
+    }
+    // the loop has nothing else to do, so this returns once the work is done
+    uv_run(&privateBits->loop, UV_RUN_DEFAULT);
+    privateBits->pending = false;
+    if (privateBits->error) {
+      std::exception_ptr error = privateBits->error;
+      privateBits->error = nullptr;
+      std::rethrow_exception(error);
+    }
+  }
+}
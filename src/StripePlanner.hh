@@ -0,0 +1,187 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ORC_STRIPE_PLANNER_HH
+#define ORC_STRIPE_PLANNER_HH
+
+#include "orc/OrcFile.hh"
+#include "Compression.hh"
+#include "wrap/orc-proto-wrapper.hh"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace orc {
+
+  /**
+   * A contiguous range of bytes in a file.
+   */
+  struct ReadRange {
+    unsigned long offset;
+    unsigned long length;
+  };
+
+  /**
+   * Find the ranges of the streams that the reader needs from a stripe.
+   * Row index streams are not included, since the reader does not use them.
+   * @param footer the stripe's footer
+   * @param stripeStart the offset of the stripe in the file
+   * @param streamsLength the length of the stripe's index and data, which
+   *    the streams must fit in
+   * @param selectedColumns the columns that will be read
+   * @param columnCount the number of entries in selectedColumns
+   * @return the ranges in file order
+   * @throws ParseError if a stream has a bad column or doesn't fit
+   */
+  std::vector<ReadRange> planStripeReads(const proto::StripeFooter& footer,
+                                         unsigned long stripeStart,
+                                         unsigned long streamsLength,
+                                         const bool* selectedColumns,
+                                         unsigned long columnCount);
+
+  /**
+   * Merge ranges that overlap or are separated by at most maxGap bytes.
+   * Reading the gap is cheaper than issuing another request when the gap
+   * is small. Ranges that are only close are not merged past the largest
+   * range plus four gaps, so one read never grows without bound.
+   * @param ranges the ranges to merge in any order
+   * @param maxGap the largest gap between two ranges that will be merged
+   * @return the merged ranges sorted by offset
+   */
+  std::vector<ReadRange> coalesceRanges(std::vector<ReadRange> ranges,
+                                        unsigned long maxGap);
+
+  /**
+   * Run tasks on several threads at once, including the calling thread.
+   * Each task runs once, and every task runs even if some of them throw.
+   * @param taskCount the number of tasks
+   * @param maxThreads the most threads to use
+   * @param task called with the index of the thread, which is less than
+   *    maxThreads, and the index of the task
+   * @throws the first exception that a task threw once all of them finish
+   */
+  void runInParallel(unsigned long taskCount,
+                     unsigned int maxThreads,
+                     const std::function<void(unsigned int, unsigned long)>&
+                       task);
+
+  /**
+   * Read several ranges of a file at once using a thread for each request
+   * that is in flight.
+   * @param input the file to read from, which must support reads from
+   *    several threads at once
+   * @param requests the ranges to read
+   * @param maxParallelReads the most reads that may be in flight at once
+   */
+  void readRangesInParallel(InputStream& input,
+                            const std::vector<ReadRequest>& requests,
+                            unsigned int maxParallelReads);
+
+  /**
+   * The bytes for a set of ranges of a file, which are read with one
+   * vectored request. Streams for the streams inside of the ranges are
+   * slices of the shared buffers.
+   */
+  class StripeBuffer {
+  private:
+    struct Block {
+      unsigned long offset;
+      unsigned long length;
+      PooledBuffer data;
+    };
+    std::vector<Block> blocks;
+    BufferPool* pool;
+
+  public:
+    StripeBuffer();
+    ~StripeBuffer();
+
+    /**
+     * Drop all of the loaded bytes.
+     */
+    void clear();
+
+    /**
+     * Replace the contents with the given ranges of the input. If the input
+     * has a read alignment, the ranges are widened to it so that the reads
+     * go straight into the buffers.
+     * @param input the file to read from
+     * @param ranges the non-overlapping ranges to read sorted by offset
+     * @param pool the pool to take the buffers from, which may be null
+     */
+    void load(InputStream& input, const std::vector<ReadRange>& ranges,
+              BufferPool* pool = nullptr);
+
+    /**
+     * Get the bytes for a range if they were loaded.
+     * @return a pointer to the first byte or nullptr if the range is not
+     *    completely inside of one loaded range
+     */
+    const char* getRange(unsigned long offset, unsigned long length) const;
+
+    /**
+     * Create a stream for a range of the file. The stream uses the loaded
+     * bytes when they contain the range and reads from the input otherwise.
+     */
+    std::unique_ptr<SeekableInputStream> getStream(InputStream* input,
+                                                   unsigned long offset,
+                                                   unsigned long length,
+                                                   long blockSize) const;
+  };
+
+  struct AsyncTaskPrivate;
+
+  /**
+   * Runs work on libuv's thread pool while the caller keeps going, which is
+   * used to read the next stripe while the current one is decoded. At most
+   * one piece of work is outstanding at a time.
+   */
+  class AsyncTask {
+  private:
+    std::unique_ptr<AsyncTaskPrivate> privateBits;
+
+  public:
+    AsyncTask();
+
+    /**
+     * Waits for any outstanding work before returning.
+     */
+    ~AsyncTask();
+
+    /**
+     * Start running the work in the background.
+     * @param work the function to run, which must be safe to call from
+     *    another thread
+     */
+    void start(std::function<void()> work);
+
+    /**
+     * Is there work that hasn't been waited for?
+     */
+    bool isPending() const;
+
+    /**
+     * Block until the work is done. If the work threw an exception, it is
+     * rethrown here.
+     */
+    void wait();
+  };
+}
+
+#endif
@@ -25,10 +25,13 @@
 namespace orc {
 
   ColumnVectorBatch::ColumnVectorBatch(unsigned long cap
-                                       ): notNull(new char[cap]) {
+                                       ): notNull(new char[cap]),
+                                          notNullBits(new unsigned char
+                                                      [(cap + 7) / 8]) {
     capacity = cap;
     numElements = 0;
     hasNulls = false;
+    nullCount = 0;
   }
 
   ColumnVectorBatch::~ColumnVectorBatch() {
@@ -19,7 +19,9 @@
 #ifndef ORC_FILE_HH
 #define ORC_FILE_HH
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "Reader.hh"
 
@@ -29,6 +31,34 @@
 
 namespace orc {
 
+  struct BlockCachePrivate;
+
+  /**
+   * How a reader expects to use a range of a file.
+   */
+  enum ReadAdvice {
+    // the range will be read soon
+    ReadAdvice_WILL_NEED = 0,
+    // the range won't be read again
+    ReadAdvice_DONT_NEED = 1,
+    // the whole file will be read in order
+    ReadAdvice_SEQUENTIAL = 2,
+    // the file will be read in scattered pieces
+    ReadAdvice_RANDOM = 3
+  };
+
+  /**
+   * One range of a file to read into a buffer.
+   */
+  struct ReadRequest {
+    // the location to write the bytes to
+    void* buffer;
+    // the position in the file to read from
+    unsigned long offset;
+    // the number of bytes to read
+    unsigned long length;
+  };
+
   /**
    * An abstract interface for providing ORC readers a stream of bytes.
    */
@@ -56,14 +86,179 @@ namespace orc {
      * Get the name of the stream for error messages.
      */
     virtual const std::string& getName() const = 0;
+
+    /**
+     * Get the bytes of the file if the stream already holds the whole file
+     * in memory. Readers use it to hand out pointers into the file rather
+     * than copying it through read.
+     * @return the address of the first byte of the file or nullptr if the
+     *    bytes are only available through read
+     */
+    virtual const char* getData() const;
+
+    /**
+     * Get the time the file was last modified, which is used along with
+     * the name and length to recognize a file that was opened before.
+     * @return the nanoseconds since the epoch or 0 if it isn't known
+     */
+    virtual long getModificationTime() const;
+
+    /**
+     * Tell the stream how a range of the file will be used, so that it can
+     * start reading it early or stop caching it. The default does nothing.
+     * @param offset the first byte of the range
+     * @param length the number of bytes in the range
+     * @param advice the expected use
+     */
+    virtual void advise(unsigned long offset, unsigned long length,
+                        ReadAdvice advice);
+
+    /**
+     * Get the alignment that the offset, length, and buffer of a read need
+     * for the stream to read straight into the buffer. Other reads work
+     * too, but they may be copied. The default is 1.
+     */
+    virtual unsigned long getReadAlignment() const;
+
+    /**
+     * Read several ranges of the file. Streams with a high latency per
+     * request should override it to have the requests in flight at once.
+     * The default reads the ranges one at a time.
+     * @param requests the ranges to read, which must not overlap
+     */
+    virtual void readRanges(const std::vector<ReadRequest>& requests);
   };
 
   /**
-   * Create a stream to a local file.
+   * A cache of fixed-size blocks of files that can be shared by all of the
+   * streams in a process. Files are identified by their name, length, and
+   * modification time. When the cache is full, the least recently used
+   * blocks are dropped. All methods are thread-safe.
+   */
+  class BlockCache {
+  private:
+    std::unique_ptr<BlockCachePrivate> privateBits;
+
+  public:
+    /**
+     * Create a cache.
+     * @param capacity the maximum number of bytes to keep
+     * @param blockSize the number of bytes in each block
+     */
+    BlockCache(unsigned long capacity, unsigned long blockSize = 1024 * 1024);
+    virtual ~BlockCache();
+
+    /**
+     * Get the maximum number of bytes to keep.
+     */
+    unsigned long getCapacity() const;
+
+    /**
+     * Get the number of bytes in each block.
+     */
+    unsigned long getBlockSize() const;
+
+    /**
+     * Get the number of bytes in the cached blocks.
+     */
+    unsigned long size() const;
+
+    /**
+     * Get the number of block lookups that found the block.
+     */
+    unsigned long getHits() const;
+
+    /**
+     * Get the number of block lookups that didn't find the block.
+     */
+    unsigned long getMisses() const;
+
+    /**
+     * Drop all of the blocks.
+     */
+    void clear();
+
+    /**
+     * Find a block.
+     * @param key the identity of the file and block
+     * @return the block or an empty pointer if it isn't cached
+     */
+    std::shared_ptr<const std::vector<char> > get(const std::string& key);
+
+    /**
+     * Add a block to the cache.
+     * @param key the identity of the file and block
+     * @param block the bytes of the block
+     */
+    void put(const std::string& key,
+             std::shared_ptr<const std::vector<char> > block);
+  };
+
+  /**
+   * Create a stream to a local file. The stream uses positional reads, so
+   * several readers in different threads may share it.
    * @param path the name of the file in the local file system
    */
   std::unique_ptr<InputStream> readLocalFile(const std::string& path);
 
+  /**
+   * Create a stream to a local file that is memory mapped. The streams
+   * created by the reader point directly into the mapping, so uncompressed
+   * data is never copied.
+   * @param path the name of the file in the local file system
+   */
+  std::unique_ptr<InputStream> readLocalFileMapped(const std::string& path);
+
+  /**
+   * Create a stream to a local file that reads with O_DIRECT, so that a
+   * large scan doesn't push other data out of the page cache. Reads are
+   * widened to aligned blocks and the extra bytes are dropped. Platforms
+   * without O_DIRECT use F_NOCACHE where they have it. If the file system
+   * doesn't support direct I/O, the file is read normally. Like
+   * readLocalFile, it is safe to share across threads.
+   * @param path the name of the file in the local file system
+   */
+  std::unique_ptr<InputStream> readLocalFileDirect(const std::string& path);
+
+  /**
+   * Create a stream over a file that is already in memory. Like a mapped
+   * file, the streams created by the reader point directly into the
+   * memory. The caller keeps ownership of the memory, which must not change
+   * or be freed until the stream and any readers using it are destroyed.
+   * @param data the first byte of the file
+   * @param length the number of bytes in the file
+   * @param name the name of the stream for error messages
+   */
+  std::unique_ptr<InputStream> readMemory(const char* data,
+                                          unsigned long length,
+                                          const std::string& name = "memory");
+
+  /**
+   * Create a stream that serves reads of another stream from a shared
+   * block cache. Reads are widened to whole blocks, and the missing blocks
+   * are read with one request per run of adjacent blocks. Streams that
+   * don't know their modification time aren't cached.
+   * @param input the stream to read from
+   * @param cache the cache to use
+   */
+  std::unique_ptr<InputStream>
+      createCachedInputStream(std::unique_ptr<InputStream> input,
+                              std::shared_ptr<BlockCache> cache);
+
+  /**
+   * Create a stream that adds a fixed delay to each read of another stream,
+   * which stands in for a remote object store when testing scans. Like a
+   * store, it answers the ranges of readRanges with parallel requests.
+   * @param input the stream to read from, which must support reads from
+   *    several threads at once
+   * @param latencyMicros the delay of each read in microseconds
+   * @param maxParallelReads the most reads that may be in flight at once
+   */
+  std::unique_ptr<InputStream>
+      createDelayedInputStream(std::unique_ptr<InputStream> input,
+                               unsigned long latencyMicros,
+                               unsigned int maxParallelReads = 8);
+
   /**
    * Create a reader to the for the ORC file.
    * @param stream the stream to read
@@ -21,6 +21,7 @@
 
 #include "Vector.hh"
 
+#include <functional>
 #include <initializer_list>
 #include <memory>
 #include <string>
@@ -29,16 +30,77 @@
 namespace orc {
 
   // classes that hold data members so we can maintain binary compatibility
+  struct BufferPoolPrivate;
   class ColumnStatisticsPrivate;
+  struct FileTailCachePrivate;
   struct ReaderOptionsPrivate;
 
+  // the parsed tail of a file, which is private to the reader
+  struct FileTail;
+  class ReaderImpl;
+
   enum CompressionKind {
     CompressionKind_NONE = 0,
     CompressionKind_ZLIB = 1,
     CompressionKind_SNAPPY = 2,
-    CompressionKind_LZO = 3
+    CompressionKind_LZO = 3,
+    CompressionKind_LZ4 = 4,
+    CompressionKind_ZSTD = 5
   };
 
+  /**
+   * Decompresses single chunks for one compression codec. The library
+   * handles the chunk headers, original chunks, buffering, and seeking, so
+   * an implementation only expands one chunk at a time. Each instance is
+   * used by one thread at a time, so it may keep state between chunks.
+   */
+  class Decompressor {
+  public:
+    virtual ~Decompressor();
+
+    /**
+     * Decompress one chunk.
+     * @param input the compressed bytes
+     * @param length the number of compressed bytes
+     * @param output the buffer to write the bytes to
+     * @param maxOutputLength the size of the output buffer, which is the
+     *    file's compression block size
+     * @return the number of bytes written to the output
+     * @throws ParseError if the chunk is corrupt or doesn't fit
+     */
+    virtual unsigned long decompress(const char* input,
+                                     unsigned long length,
+                                     char* output,
+                                     unsigned long maxOutputLength) = 0;
+
+    /**
+     * Get the name of the compression for error messages.
+     */
+    virtual std::string getName() const = 0;
+  };
+
+  /**
+   * Creates a new Decompressor each time that it is called. It may be
+   * called from several threads at once.
+   */
+  typedef std::function<std::unique_ptr<Decompressor>()> DecompressorFactory;
+
+  /**
+   * Use a different implementation for a compression kind in every reader
+   * created afterwards. This replaces the built-in codec, or adds one for a
+   * kind that this build doesn't support.
+   * @param kind the compression kind, which can't be NONE
+   * @param factory creates the decompressors for the kind
+   */
+  void registerDecompressor(CompressionKind kind,
+                            DecompressorFactory factory);
+
+  /**
+   * Go back to the built-in codec for a compression kind.
+   * @param kind the compression kind
+   */
+  void unregisterDecompressor(CompressionKind kind);
+
   /**
    * Statistics that are available for all types of columns.
    */
@@ -284,6 +346,119 @@ namespace orc {
     virtual unsigned long getNumberOfRows() const = 0;
   };
 
+  /**
+   * A cache of parsed file tails that can be shared by all of the readers in
+   * a process. Opening a file whose tail is in the cache doesn't read or
+   * parse the postscript, footer, or metadata. Files are identified by
+   * their name, length, and modification time, so streams that don't know
+   * their modification time are never cached. When the cache is full, the
+   * least recently used tail is dropped. All methods are thread-safe.
+   */
+  class FileTailCache {
+  private:
+    std::unique_ptr<FileTailCachePrivate> privateBits;
+
+    // the tails are internal to the reader, so only it looks them up
+    friend class ReaderImpl;
+
+    /**
+     * Find the file tail for a key.
+     * @param key the identity of the file
+     * @return the tail or an empty pointer if it isn't cached
+     */
+    std::shared_ptr<const FileTail> get(const std::string& key);
+
+    /**
+     * Add a file tail to the cache.
+     * @param key the identity of the file
+     * @param tail the parsed tail
+     */
+    void put(const std::string& key, std::shared_ptr<const FileTail> tail);
+
+  public:
+    /**
+     * Create a cache.
+     * @param capacity the maximum number of file tails to keep
+     */
+    FileTailCache(unsigned long capacity);
+    virtual ~FileTailCache();
+
+    /**
+     * Get the maximum number of file tails to keep.
+     */
+    unsigned long getCapacity() const;
+
+    /**
+     * Get the number of file tails in the cache.
+     */
+    unsigned long size() const;
+
+    /**
+     * Get the number of lookups that found a file tail.
+     */
+    unsigned long getHits() const;
+
+    /**
+     * Get the number of lookups that didn't find a file tail.
+     */
+    unsigned long getMisses() const;
+
+    /**
+     * Drop all of the file tails.
+     */
+    void clear();
+  };
+
+  /**
+   * A pool of memory buffers that readers reuse for stream buffers, stripe
+   * buffers, and dictionaries instead of allocating new ones for each
+   * stripe. Buffers are grouped by size rounded up to a power of two and
+   * start on a page boundary. A pool may be shared by readers in different
+   * threads.
+   */
+  class BufferPool {
+  private:
+    std::unique_ptr<BufferPoolPrivate> privateBits;
+
+  public:
+    /**
+     * Create a pool.
+     * @param maxRetainedBytes the most memory that the pool keeps for reuse
+     *    once the buffers are released. Larger buffers are freed.
+     */
+    BufferPool(unsigned long maxRetainedBytes = 256 * 1024 * 1024);
+    virtual ~BufferPool();
+
+    /**
+     * Get a buffer.
+     * @param size the minimum number of bytes needed
+     * @return the buffer, which must be given back with release
+     */
+    char* acquire(unsigned long size);
+
+    /**
+     * Give a buffer back to the pool.
+     * @param buffer a buffer from acquire
+     * @param size the size that was passed to acquire
+     */
+    void release(char* buffer, unsigned long size);
+
+    /**
+     * Get the number of bytes in buffers that are waiting to be reused.
+     */
+    unsigned long getRetainedBytes() const;
+
+    /**
+     * Get the number of times that acquire had to allocate memory.
+     */
+    unsigned long getAllocationCount() const;
+
+    /**
+     * Get the number of times that acquire reused a buffer.
+     */
+    unsigned long getReuseCount() const;
+  };
+
   /**
    * Options for creating a Reader.
    */
@@ -330,6 +505,76 @@ namespace orc {
      */
     ReaderOptions& setTailLocation(unsigned long offset);
 
+    /**
+     * Set the largest gap between two streams of a stripe that are read
+     * with a single request. The bytes in the gap are read and discarded.
+     * The default value is 64k.
+     * @param gap the number of bytes
+     * @return this
+     */
+    ReaderOptions& setCoalesceGap(unsigned long gap);
+
+    /**
+     * Set whether the next stripe is read in the background while the
+     * current one is decoded. The reads run on libuv's thread pool, so the
+     * InputStream must support reads from several threads at once.
+     * The default value is false.
+     * @param prefetch whether to read ahead
+     * @return this
+     */
+    ReaderOptions& setPrefetch(bool prefetch);
+
+    /**
+     * Set whether the reader tells the InputStream that it is done with
+     * each stripe, so that the operating system can drop it from the page
+     * cache. This keeps a large scan from evicting other data, but other
+     * readers of the same file will have to read it again.
+     * The default value is false.
+     * @param drop whether to drop stripes once they are read
+     * @return this
+     */
+    ReaderOptions& setDropConsumedStripes(bool drop);
+
+    /**
+     * Set how many threads decompress each stripe. When it is more than
+     * zero, all of the chunks of the selected streams are decompressed as
+     * soon as the stripe is read, and the column readers use the expanded
+     * buffers. This uses more memory, since the whole stripe is expanded at
+     * once. When prefetching, the decompression runs in the background too.
+     * The default value is 0, which decompresses each chunk as the column
+     * readers reach it.
+     * @param threads the number of threads, including the reading thread
+     * @return this
+     */
+    ReaderOptions& setDecompressionThreads(unsigned int threads);
+
+    /**
+     * Set how many bytes from the end of the file are read when the file is
+     * opened. If the postscript, footer, and metadata fit, opening the file
+     * takes a single read. Otherwise, it takes exactly one more.
+     * The default value is 16k.
+     * @param size the number of bytes to read
+     * @return this
+     */
+    ReaderOptions& setTailReadSize(unsigned long size);
+
+    /**
+     * Set the cache to look up and store the parsed file tail in.
+     * The default is to not cache file tails.
+     * @param cache the shared cache
+     * @return this
+     */
+    ReaderOptions& setFileTailCache(std::shared_ptr<FileTailCache> cache);
+
+    /**
+     * Set the pool that the reader takes its buffers from. Sharing a pool
+     * lets readers reuse each other's buffers. The default is for each
+     * reader to create its own pool.
+     * @param pool the pool to use
+     * @return this
+     */
+    ReaderOptions& setBufferPool(std::shared_ptr<BufferPool> pool);
+
     /**
      * Get the list of selected columns to read. All children of the selected
      * columns are also selected.
@@ -353,6 +598,75 @@ namespace orc {
      * @return if not set, return the maximum long.
      */
     unsigned long getTailLocation() const;
+
+    /**
+     * Get the largest gap between streams that are read together.
+     */
+    unsigned long getCoalesceGap() const;
+
+    /**
+     * Get whether the next stripe is read in the background.
+     */
+    bool getPrefetch() const;
+
+    /**
+     * Get whether stripes are dropped from the page cache once they are read.
+     */
+    bool getDropConsumedStripes() const;
+
+    /**
+     * Get the number of threads that decompress each stripe.
+     */
+    unsigned int getDecompressionThreads() const;
+
+    /**
+     * Get the number of bytes read speculatively from the end of the file.
+     */
+    unsigned long getTailReadSize() const;
+
+    /**
+     * Get the cache for parsed file tails.
+     * @return the cache or an empty pointer if tails aren't cached
+     */
+    std::shared_ptr<FileTailCache> getFileTailCache() const;
+
+    /**
+     * Get the pool for the reader's buffers.
+     * @return the pool or an empty pointer if each reader creates its own
+     */
+    std::shared_ptr<BufferPool> getBufferPool() const;
+  };
+
+  /**
+   * The work that a Reader has done decoding one column.
+   */
+  struct ColumnMetrics {
+    // the number of values returned, including the nulls
+    unsigned long rows;
+    // the number of null values returned
+    unsigned long nulls;
+    // the time spent in the column's reader, including its children
+    unsigned long decodeNanos;
+
+    ColumnMetrics(): rows(0), nulls(0), decodeNanos(0) {}
+  };
+
+  /**
+   * The work that a Reader has done since it was created.
+   */
+  struct ReaderMetrics {
+    // the number of reads issued to the InputStream
+    unsigned long readCalls;
+    // the number of bytes requested from the InputStream
+    unsigned long readBytes;
+    // the time spent waiting for the InputStream
+    unsigned long readNanos;
+    // the time spent in decompression streams
+    unsigned long decompressionNanos;
+    // the number of bytes produced by decompression streams
+    unsigned long decompressedBytes;
+    // the column metrics indexed by column id
+    std::vector<ColumnMetrics> columns;
   };
 
   /**
@@ -475,6 +789,14 @@ namespace orc {
      */
     virtual void seekToRow(unsigned long rowNumber) = 0;
 
+    /**
+     * Get the counters for the I/O and decoding that this reader has done.
+     * Reads done by prefetching are included once they finish. Bytes that
+     * are used straight from a memory-mapped file don't count as reads.
+     * @return a snapshot of the counters
+     */
+    virtual ReaderMetrics getMetrics() const = 0;
+
     /**
      * Get the name of the input stream.
      */
@@ -90,8 +90,14 @@ namespace orc {
     unsigned long numElements;
     // an array of capacity length marking non-null values
     std::unique_ptr<char[]> notNull;
+    // the same marks packed 8 to a byte, with the first value in the most
+    // significant bit as the PRESENT stream stores them, which are always
+    // filled in for the first numElements values
+    std::unique_ptr<unsigned char[]> notNullBits;
     // whether there are any null values
     bool hasNulls;
+    // the number of null values
+    unsigned long nullCount;
 
     virtual std::string toString() const = 0;
   };
@@ -0,0 +1,205 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BitUnpack.hh"
+#include "wrap/gtest-wrapper.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace orc {
+
+  /**
+   * Unpack one bit at a time as an independent check on the kernels.
+   */
+  uint64_t referenceValue(const std::vector<unsigned char>& input,
+                          unsigned long index,
+                          unsigned int width) {
+    uint64_t result = 0;
+    for (unsigned long bit = index * width; bit < (index + 1) * width;
+         ++bit) {
+      result = result << 1 | ((input[bit / 8] >> (7 - bit % 8)) & 1);
+    }
+    return result;
+  }
+
+  std::vector<BitUnpackLevel> getSupportedLevels() {
+    std::vector<BitUnpackLevel> result;
+    for (int level = BitUnpackLevel_SCALAR; level <= getBitUnpackLevel();
+         ++level) {
+      result.push_back(static_cast<BitUnpackLevel>(level));
+    }
+    return result;
+  }
+
+  /**
+   * Unpack random data at every width and level, checking every value and
+   * that nothing is written past the output.
+   */
+  template <typename T>
+  void checkAllWidths() {
+    std::mt19937 random(17);
+    const unsigned long counts[] = {0, 1, 2, 3, 7, 8, 15, 16, 17, 31, 32,
+                                    33, 47, 48, 63, 64, 65, 100, 1000, 1027};
+    for (BitUnpackLevel level: getSupportedLevels()) {
+      for (unsigned int width = 1; width <= 8 * sizeof(T); ++width) {
+        for (unsigned long count: counts) {
+          // an odd offset makes every load unaligned
+          std::vector<unsigned char> buffer(getPackedLength(count, width) +
+                                            1);
+          for (unsigned char& byte: buffer) {
+            byte = static_cast<unsigned char>(random());
+          }
+          std::vector<unsigned char> packed(buffer.begin() + 1,
+                                            buffer.end());
+          std::vector<T> output(count + 16, 0x55);
+          unpackBits(buffer.data() + 1, count, width, output.data(), level);
+          for (unsigned long i = 0; i < count; ++i) {
+            ASSERT_EQ(static_cast<T>(referenceValue(packed, i, width)),
+                      output[i])
+                << getBitUnpackLevelName(level) << " width " << width
+                << " count " << count << " at " << i;
+          }
+          for (unsigned long i = count; i < output.size(); ++i) {
+            ASSERT_EQ(0x55, output[i])
+                << getBitUnpackLevelName(level) << " width " << width
+                << " count " << count << " wrote past the end";
+          }
+        }
+      }
+    }
+  }
+
+  TEST(BitUnpack, unpack64) {
+    checkAllWidths<long>();
+  }
+
+  TEST(BitUnpack, unpack32) {
+    checkAllWidths<int32_t>();
+  }
+
+  TEST(BitUnpack, unpack16) {
+    checkAllWidths<int16_t>();
+  }
+
+  TEST(BitUnpack, unpack8) {
+    checkAllWidths<int8_t>();
+  }
+
+  template <typename T>
+  void checkPackRoundTrip() {
+    std::mt19937_64 random(5);
+    for (unsigned int width = 1; width <= 8 * sizeof(T); ++width) {
+      const uint64_t mask = width == 64 ? ~0UL : (1UL << width) - 1;
+      for (unsigned long count: {1UL, 9UL, 100UL}) {
+        std::vector<T> values(count);
+        for (T& value: values) {
+          value = static_cast<T>(random() & mask);
+        }
+        std::vector<unsigned char> packed(getPackedLength(count, width));
+        ASSERT_EQ(packed.size(),
+                  packBits(values.data(), count, width, packed.data()));
+        for (unsigned long i = 0; i < count; ++i) {
+          ASSERT_EQ(static_cast<uint64_t>(values[i]) & mask,
+                    referenceValue(packed, i, width))
+              << "width " << width << " at " << i;
+        }
+        std::vector<T> unpacked(count);
+        unpackBits(packed.data(), count, width, unpacked.data());
+        ASSERT_EQ(values, unpacked) << "width " << width;
+      }
+    }
+  }
+
+  TEST(BitUnpack, packRoundTrip) {
+    checkPackRoundTrip<long>();
+    checkPackRoundTrip<int32_t>();
+    checkPackRoundTrip<int16_t>();
+    checkPackRoundTrip<int8_t>();
+  }
+
+  TEST(BitUnpack, packMasksValues) {
+    const long values[] = {-1, 0, -1};
+    unsigned char packed[2];
+    EXPECT_EQ(2, packBits(values, 3, 3, packed));
+    EXPECT_EQ(0xe3, packed[0]);
+    EXPECT_EQ(0x80, packed[1]);
+  }
+
+  TEST(BitUnpack, badWidth) {
+    const unsigned char input[16] = {0};
+    long longs[1];
+    int16_t shorts[1];
+    int8_t bytes[1];
+    EXPECT_THROW(unpackBits(input, 1, 0, longs), std::logic_error);
+    EXPECT_THROW(unpackBits(input, 1, 65, longs), std::logic_error);
+    EXPECT_THROW(unpackBits(input, 1, 17, shorts), std::logic_error);
+    EXPECT_THROW(unpackBits(input, 1, 9, bytes), std::logic_error);
+    unsigned char output[16];
+    EXPECT_THROW(packBits(bytes, 1, 9, output), std::logic_error);
+  }
+
+  TEST(BitUnpack, levels) {
+    EXPECT_EQ(getBitUnpackLevel(), getBitUnpackLevel());
+    EXPECT_EQ(std::string("scalar"),
+              getBitUnpackLevelName(BitUnpackLevel_SCALAR));
+    EXPECT_EQ(std::string("avx512"),
+              getBitUnpackLevelName(BitUnpackLevel_AVX512));
+    std::cout << "bit unpacking uses "
+              << getBitUnpackLevelName(getBitUnpackLevel()) << "\n";
+  }
+
+  TEST(BitUnpack, DISABLED_benchmark) {
+    const unsigned long count = 1024 * 1024;
+    std::mt19937 random(3);
+    std::vector<unsigned char> packed(getPackedLength(count, 64));
+    for (unsigned char& byte: packed) {
+      byte = static_cast<unsigned char>(random());
+    }
+    std::vector<long> longs(count);
+    std::vector<int32_t> ints(count);
+    for (unsigned int width: {1U, 4U, 7U, 13U, 16U, 25U, 32U, 48U, 64U}) {
+      std::cout << "width " << width << ":";
+      for (BitUnpackLevel level: getSupportedLevels()) {
+        double best = 0;
+        for (int trial = 0; trial < 5; ++trial) {
+          auto start = std::chrono::steady_clock::now();
+          unpackBits(packed.data(), count, width, longs.data(), level);
+          std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+          best = std::max(best, static_cast<double>(count) / 1e6 /
+                                  elapsed.count());
+        }
+        std::cout << " " << getBitUnpackLevelName(level) << " " << best
+                  << " M values/s";
+        if (width <= 32) {
+          auto start = std::chrono::steady_clock::now();
+          unpackBits(packed.data(), count, width, ints.data(), level);
+          std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+          std::cout << " (" << static_cast<double>(count) / 1e6 /
+                                 elapsed.count() << " as int32)";
+        }
+      }
+      std::cout << "\n";
+    }
+  }
+}
@@ -0,0 +1,174 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "orc/OrcFile.hh"
+#include "Exceptions.hh"
+#include "wrap/gtest-wrapper.h"
+
+#include <string.h>
+
+namespace orc {
+
+  /**
+   * An InputStream over a fixed pattern that records its reads.
+   */
+  class PatternInputStream: public InputStream {
+  private:
+    std::string name;
+    unsigned long length;
+  public:
+    long modificationTime;
+    // the offset and length of each read
+    std::vector<std::pair<unsigned long, unsigned long> > reads;
+
+    PatternInputStream(unsigned long _length
+                       ): name("pattern"), length(_length),
+                          modificationTime(1) {}
+    ~PatternInputStream();
+
+    long getLength() const override {
+      return static_cast<long>(length);
+    }
+
+    void read(void* buffer, unsigned long offset,
+              unsigned long size) override {
+      reads.push_back(std::make_pair(offset, size));
+      char* output = static_cast<char*>(buffer);
+      for(unsigned long i=0; i < size; ++i) {
+        output[i] = static_cast<char>((offset + i) % 251);
+      }
+    }
+
+    const std::string& getName() const override {
+      return name;
+    }
+
+    long getModificationTime() const override {
+      return modificationTime;
+    }
+  };
+
+  PatternInputStream::~PatternInputStream() {
+    // PASS
+  }
+
+  void checkPattern(const char* buffer, unsigned long offset,
+                    unsigned long length) {
+    for(unsigned long i=0; i < length; ++i) {
+      ASSERT_EQ(static_cast<char>((offset + i) % 251), buffer[i])
+        << "Output wrong at " << offset << " + " << i;
+    }
+  }
+
+  TEST(BlockCache, lru) {
+    BlockCache cache(250, 100);
+    EXPECT_EQ(250, cache.getCapacity());
+    EXPECT_EQ(100, cache.getBlockSize());
+    auto block = std::make_shared<const std::vector<char> >(100, 'a');
+    cache.put("a", block);
+    cache.put("b", block);
+    EXPECT_EQ(200, cache.size());
+    EXPECT_EQ(block, cache.get("a"));
+    EXPECT_EQ(1, cache.getHits());
+
+    // b is the least recently used, so it is dropped
+    cache.put("c", block);
+    EXPECT_EQ(200, cache.size());
+    EXPECT_EQ(nullptr, cache.get("b"));
+    EXPECT_EQ(1, cache.getMisses());
+    EXPECT_NE(nullptr, cache.get("a"));
+    EXPECT_NE(nullptr, cache.get("c"));
+
+    // blocks that are larger than the cache aren't kept
+    cache.put("d", std::make_shared<const std::vector<char> >(300, 'd'));
+    EXPECT_EQ(nullptr, cache.get("d"));
+    EXPECT_EQ(200, cache.size());
+
+    cache.clear();
+    EXPECT_EQ(0, cache.size());
+    EXPECT_EQ(nullptr, cache.get("a"));
+    EXPECT_THROW(BlockCache(100, 0), std::logic_error);
+  }
+
+  TEST(BlockCache, cachedStream) {
+    std::shared_ptr<BlockCache> cache = std::make_shared<BlockCache>(1000,
+                                                                     100);
+    PatternInputStream* input = new PatternInputStream(450);
+    std::unique_ptr<InputStream> stream =
+      createCachedInputStream(std::unique_ptr<InputStream>(input), cache);
+    EXPECT_EQ(450, stream->getLength());
+    EXPECT_EQ("pattern", stream->getName());
+
+    // reads are widened to whole blocks
+    char buffer[450];
+    stream->read(buffer, 150, 100);
+    checkPattern(buffer, 150, 100);
+    ASSERT_EQ(1, input->reads.size());
+    EXPECT_EQ(100, input->reads[0].first);
+    EXPECT_EQ(200, input->reads[0].second);
+    EXPECT_EQ(2, cache->getMisses());
+
+    // cached blocks aren't read again
+    stream->read(buffer, 120, 150);
+    checkPattern(buffer, 120, 150);
+    EXPECT_EQ(1, input->reads.size());
+    EXPECT_EQ(2, cache->getHits());
+
+    // only the missing runs are read and the last block is short
+    std::vector<ReadRequest> requests;
+    requests.push_back({buffer, 50, 200});
+    requests.push_back({buffer + 200, 320, 130});
+    stream->readRanges(requests);
+    checkPattern(buffer, 50, 200);
+    checkPattern(buffer + 200, 320, 130);
+    ASSERT_EQ(3, input->reads.size());
+    EXPECT_EQ(0, input->reads[1].first);
+    EXPECT_EQ(100, input->reads[1].second);
+    EXPECT_EQ(300, input->reads[2].first);
+    EXPECT_EQ(150, input->reads[2].second);
+    EXPECT_EQ(450, cache->size());
+
+    // another stream to the same file shares the blocks
+    PatternInputStream* other = new PatternInputStream(450);
+    stream = createCachedInputStream(std::unique_ptr<InputStream>(other),
+                                     cache);
+    stream->read(buffer, 0, 450);
+    checkPattern(buffer, 0, 450);
+    EXPECT_EQ(0, other->reads.size());
+    EXPECT_THROW(stream->read(buffer, 400, 100), ParseError);
+
+    // a modified file doesn't use the old blocks
+    other = new PatternInputStream(450);
+    other->modificationTime = 2;
+    stream = createCachedInputStream(std::unique_ptr<InputStream>(other),
+                                     cache);
+    stream->read(buffer, 0, 10);
+    EXPECT_EQ(1, other->reads.size());
+
+    // streams without a modification time go straight to the input
+    other = new PatternInputStream(450);
+    other->modificationTime = 0;
+    stream = createCachedInputStream(std::unique_ptr<InputStream>(other),
+                                     cache);
+    stream->read(buffer, 10, 10);
+    stream->read(buffer, 10, 10);
+    ASSERT_EQ(2, other->reads.size());
+    EXPECT_EQ(10, other->reads[0].first);
+    EXPECT_EQ(10, other->reads[0].second);
+  }
+}
@@ -0,0 +1,136 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BufferPool.hh"
+#include "StripePlanner.hh"
+#include "wrap/gtest-wrapper.h"
+
+#include <string.h>
+
+namespace orc {
+
+  TEST(BufferPool, reuse) {
+    BufferPool pool;
+    char* first = pool.acquire(100);
+    EXPECT_EQ(1, pool.getAllocationCount());
+    pool.release(first, 100);
+    EXPECT_EQ(4096, pool.getRetainedBytes());
+
+    // any request in the same size class gets the buffer back
+    char* second = pool.acquire(4000);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(1, pool.getAllocationCount());
+    EXPECT_EQ(1, pool.getReuseCount());
+    EXPECT_EQ(0, pool.getRetainedBytes());
+
+    // a larger size class doesn't
+    char* third = pool.acquire(5000);
+    EXPECT_EQ(2, pool.getAllocationCount());
+    pool.release(second, 4000);
+    pool.release(third, 5000);
+    EXPECT_EQ(4096 + 8192, pool.getRetainedBytes());
+    pool.release(nullptr, 10);
+    EXPECT_EQ(4096 + 8192, pool.getRetainedBytes());
+  }
+
+  TEST(BufferPool, retentionLimit) {
+    BufferPool pool(10000);
+    char* first = pool.acquire(8192);
+    char* second = pool.acquire(8192);
+    pool.release(first, 8192);
+    pool.release(second, 8192);
+    EXPECT_EQ(8192, pool.getRetainedBytes());
+
+    BufferPool empty(0);
+    empty.release(empty.acquire(10), 10);
+    EXPECT_EQ(0, empty.getRetainedBytes());
+    EXPECT_EQ(0, empty.getReuseCount());
+  }
+
+  TEST(BufferPool, pooledBuffer) {
+    BufferPool pool;
+    PooledBuffer heap(nullptr, 10);
+    ASSERT_NE(nullptr, heap.get());
+    EXPECT_EQ(10, heap.size());
+    {
+      PooledBuffer buffer(&pool, 1000);
+      EXPECT_EQ(1000, buffer.size());
+      PooledBuffer moved(std::move(buffer));
+      EXPECT_EQ(nullptr, buffer.get());
+      EXPECT_EQ(1000, moved.size());
+      EXPECT_EQ(0, pool.getRetainedBytes());
+    }
+    EXPECT_EQ(4096, pool.getRetainedBytes());
+    PooledBuffer again(&pool, 2000);
+    EXPECT_EQ(1, pool.getReuseCount());
+    again.reset();
+    EXPECT_EQ(nullptr, again.get());
+    EXPECT_EQ(4096, pool.getRetainedBytes());
+  }
+
+  /**
+   * An InputStream that fills each read with zeros.
+   */
+  class ZeroInputStream: public InputStream {
+  private:
+    std::string name;
+  public:
+    ZeroInputStream(): name("zero") {}
+    ~ZeroInputStream();
+
+    long getLength() const override {
+      return 1000000;
+    }
+
+    void read(void* buffer, unsigned long, unsigned long length) override {
+      memset(buffer, 0, length);
+    }
+
+    const std::string& getName() const override {
+      return name;
+    }
+  };
+
+  ZeroInputStream::~ZeroInputStream() {
+    // PASS
+  }
+
+  TEST(BufferPool, stripeBuffer) {
+    BufferPool pool;
+    ZeroInputStream input;
+    StripeBuffer buffer;
+    std::vector<ReadRange> ranges;
+    ranges.push_back({0, 50000});
+    ranges.push_back({100000, 3000});
+    for(int stripe=0; stripe < 10; ++stripe) {
+      buffer.load(input, ranges, &pool);
+    }
+    // only the first load allocates
+    EXPECT_EQ(2, pool.getAllocationCount());
+    EXPECT_EQ(18, pool.getReuseCount());
+
+    // streams outside of the loaded ranges read into pooled buffers
+    std::unique_ptr<SeekableInputStream> stream =
+      buffer.getStream(&input, 200000, 100, 100);
+    EXPECT_EQ(3, pool.getAllocationCount());
+    stream.reset();
+    stream = buffer.getStream(&input, 300000, 100, 100);
+    EXPECT_EQ(3, pool.getAllocationCount());
+    EXPECT_EQ(19, pool.getReuseCount());
+  }
+}
@@ -20,6 +20,7 @@
 #include "wrap/gtest-wrapper.h"
 
 #include <iostream>
+#include <random>
 #include <vector>
 
 namespace orc {
@@ -198,6 +199,62 @@ TEST(ByteRle, testAllNulls) {
   rle->next(data.data(), data.size(), allNull.data());
 }
 
+TEST(ByteRle, literalAcrossBuffers) {
+  // a literal run of 10 values read from 4 byte buffers, followed by a
+  // repeat of 3 x 0x7f
+  std::unique_ptr<ByteRleDecoder> rle =
+      createByteRleDecoder(
+        std::unique_ptr<orc::SeekableInputStream>(
+          new SeekableArrayInputStream(
+            {0xf6, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+             0x08, 0x09, 0x00, 0x7f},
+            4)));
+  std::vector<char> data(13, -1);
+  rle->next(data.data(), 10, 0);
+  for (size_t i = 0; i < 10; ++i) {
+    EXPECT_EQ(i, data[i]) << "Output wrong at " << i;
+  }
+  EXPECT_EQ(-1, data[10]);
+  rle->next(data.data() + 10, 3, 0);
+  for (size_t i = 10; i < 13; ++i) {
+    EXPECT_EQ(0x7f, data[i]) << "Output wrong at " << i;
+  }
+}
+
+TEST(ByteRle, sparseNulls) {
+  // a literal run of 128 values followed by a repeat of 130 x 0x33
+  std::vector<char> buffer;
+  buffer.push_back(static_cast<char>(0x80));
+  for (size_t i = 0; i < 128; ++i) {
+    buffer.push_back(static_cast<char>(i));
+  }
+  buffer.push_back(static_cast<char>(127));
+  buffer.push_back(0x33);
+  std::unique_ptr<ByteRleDecoder> rle =
+      createByteRleDecoder(
+        std::unique_ptr<orc::SeekableInputStream>(
+          new SeekableArrayInputStream(buffer.data(), buffer.size(), 7)));
+  std::vector<char> data(300, -1);
+  std::vector<char> notNull(data.size());
+  for (size_t i = 0; i < notNull.size(); ++i) {
+    notNull[i] = i % 7 != 3;
+  }
+  // stop part way into the literal run
+  rle->next(data.data(), 100, notNull.data());
+  rle->next(data.data() + 100, 200, notNull.data() + 100);
+  size_t value = 0;
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (!notNull[i]) {
+      EXPECT_EQ(-1, data[i]) << "Output wrong at " << i;
+    } else {
+      EXPECT_EQ(value < 128 ? static_cast<char>(value) : 0x33, data[i])
+        << "Output wrong at " << i;
+      value += 1;
+    }
+  }
+  EXPECT_EQ(257, value);
+}
+
 TEST(ByteRle, testSkip) {
   // the stream generated by Java's TestRunLengthByteReader.testSkips
   // for (int i = 0; i < 2048; ++i) {
@@ -1330,4 +1387,40 @@ TEST(BooleanRle, seekTestWithNulls) {
   } while (i != 0);
 }
 
+TEST(BooleanRle, nextPacked) {
+  // literal runs of random bytes between repeated runs
+  std::mt19937 random(41);
+  std::vector<char> buffer;
+  for (int run = 0; run < 20; ++run) {
+    buffer.push_back(static_cast<char>(-100));
+    for (int i = 0; i < 100; ++i) {
+      buffer.push_back(static_cast<char>(random()));
+    }
+    buffer.push_back(static_cast<char>(random() % 128));
+    buffer.push_back(static_cast<char>(random()));
+  }
+  std::unique_ptr<BooleanRleDecoder> bytes =
+    createBooleanRleDecoder(std::unique_ptr<SeekableInputStream>(
+      new SeekableArrayInputStream(buffer.data(), buffer.size(), 37)));
+  std::unique_ptr<BooleanRleDecoder> packed =
+    createBooleanRleDecoder(std::unique_ptr<SeekableInputStream>(
+      new SeekableArrayInputStream(buffer.data(), buffer.size(), 37)));
+  // read the same values in odd sizes so the reads start at every bit
+  unsigned long total = 0;
+  for (unsigned long count = 1; total + count <= 20 * 800; ++count) {
+    std::vector<char> expected(count);
+    bytes->next(expected.data(), count, 0);
+    std::vector<unsigned char> bits((count + 7) / 8, 0x55);
+    packed->nextPacked(bits.data(), count);
+    for (unsigned long i = 0; i < bits.size() * 8; ++i) {
+      ASSERT_EQ(i < count ? expected[i] : 0, (bits[i / 8] >> (7 - i % 8)) & 1)
+        << "Output wrong at " << total + i;
+    }
+    total += count;
+    if (count == 70) {
+      count = 0;
+    }
+  }
+}
+
 }  // namespace orc
@@ -19,12 +19,22 @@
 
 #include "Compression.hh"
 #include "Exceptions.hh"
+#include "Metrics.hh"
+#include "TestDriver.hh"
 #include "wrap/gtest-wrapper.h"
 
+#include <chrono>
 #include <cstdio>
 #include <fstream>
+#include <iterator>
 #include <iostream>
 #include <sstream>
+#include <thread>
+
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 namespace orc {
 
@@ -305,6 +315,201 @@ namespace orc {
     }
   }
 
+  TEST_F(TestCompression, testFileConcurrentReads) {
+    SCOPED_TRACE("testFileConcurrentReads");
+    std::unique_ptr<InputStream> file = readLocalFile(simpleFile);
+    EXPECT_EQ(200, file->getLength());
+    InputStream* shared = file.get();
+    std::vector<std::thread> threads;
+    std::vector<int> failures(4, 0);
+    for(unsigned int t=0; t < 4; ++t) {
+      threads.push_back(std::thread([shared, t, &failures] {
+            char buffer[16];
+            for(unsigned int i=0; i < 1000; ++i) {
+              unsigned long offset = (i * 7 + t * 13) % 184;
+              shared->read(buffer, offset, 16);
+              for(unsigned int j=0; j < 16; ++j) {
+                if (static_cast<unsigned char>(buffer[j]) != offset + j) {
+                  failures[t] += 1;
+                }
+              }
+            }
+          }));
+    }
+    for(std::thread& thread: threads) {
+      thread.join();
+    }
+    for(unsigned int t=0; t < 4; ++t) {
+      EXPECT_EQ(0, failures[t]) << "thread " << t;
+    }
+    char buffer[10];
+    EXPECT_THROW(file->read(buffer, 195, 10), ParseError);
+    EXPECT_THROW(readLocalFile("no-such-file.binary"), ParseError);
+  }
+
+  TEST_F(TestCompression, testMappedFile) {
+    SCOPED_TRACE("testMappedFile");
+    std::unique_ptr<InputStream> file = readLocalFileMapped(simpleFile);
+    EXPECT_EQ(200, file->getLength());
+    EXPECT_EQ(std::string(simpleFile), file->getName());
+    ASSERT_TRUE(file->getData() != nullptr);
+    checkBytes(file->getData(), 200, 0);
+    char buffer[10];
+    file->read(buffer, 50, 10);
+    checkBytes(buffer, 10, 50);
+    EXPECT_THROW(file->read(buffer, 195, 10), ParseError);
+    EXPECT_THROW(readLocalFileMapped("no-such-file.binary"), ParseError);
+
+    // advice doesn't change the contents
+    file->advise(50, 100, ReadAdvice_WILL_NEED);
+    file->advise(0, 1000, ReadAdvice_DONT_NEED);
+    file->advise(0, 200, ReadAdvice_RANDOM);
+    checkBytes(file->getData(), 200, 0);
+    std::unique_ptr<InputStream> unmapped = readLocalFile(simpleFile);
+    unmapped->advise(0, 200, ReadAdvice_SEQUENTIAL);
+    unmapped->advise(0, 200, ReadAdvice_DONT_NEED);
+    unmapped->read(buffer, 50, 10);
+    checkBytes(buffer, 10, 50);
+  }
+
+  TEST_F(TestCompression, testDirectFile) {
+    SCOPED_TRACE("testDirectFile");
+    std::unique_ptr<InputStream> file = readLocalFileDirect(simpleFile);
+    EXPECT_EQ(200, file->getLength());
+    EXPECT_EQ(std::string(simpleFile), file->getName());
+    EXPECT_EQ(nullptr, file->getData());
+    // the file system may not support direct I/O
+    EXPECT_TRUE(file->getReadAlignment() == 1 ||
+                file->getReadAlignment() == 4096);
+    char buffer[200];
+    file->read(buffer, 0, 200);
+    checkBytes(buffer, 200, 0);
+    file->read(buffer, 7, 13);
+    checkBytes(buffer, 13, 7);
+    // again, reusing the bounce buffer
+    file->read(buffer, 7, 13);
+    checkBytes(buffer, 13, 7);
+    file->read(buffer, 199, 1);
+    checkBytes(buffer, 1, 199);
+    EXPECT_THROW(file->read(buffer, 195, 10), ParseError);
+    EXPECT_THROW(readLocalFileDirect("no-such-file.binary"), ParseError);
+  }
+
+  TEST_F(TestCompression, testDirectLargeFile) {
+    SCOPED_TRACE("testDirectLargeFile");
+    // larger than the bounce buffer, so unaligned reads take several steps
+    const char* largeFile = "large-file.binary";
+    const unsigned long size = 3 * 1024 * 1024 + 123;
+    {
+      std::ofstream file;
+      file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+      file.open(largeFile,
+                std::ios::out | std::ios::binary | std::ios::trunc);
+      for(unsigned long i = 0; i < size; ++i) {
+        file.put(static_cast<char>(i));
+      }
+    }
+    std::unique_ptr<InputStream> file = readLocalFileDirect(largeFile);
+    ASSERT_EQ(size, file->getLength());
+    std::vector<char> buffer(size + 1);
+    file->read(buffer.data(), 0, size);
+    for(unsigned long i=0; i < size; ++i) {
+      ASSERT_EQ(static_cast<char>(i), buffer[i]) << "Output wrong at " << i;
+    }
+    file->read(buffer.data() + 1, 4095, size - 4095);
+    for(unsigned long i=4095; i < size; ++i) {
+      ASSERT_EQ(static_cast<char>(i), buffer[i - 4094])
+        << "Output wrong at " << i;
+    }
+    remove(largeFile);
+  }
+
+  TEST_F(TestCompression, testDelayedFile) {
+    SCOPED_TRACE("testDelayedFile");
+    std::unique_ptr<InputStream> file =
+      createDelayedInputStream(readLocalFile(simpleFile), 50000, 4);
+    EXPECT_EQ(200, file->getLength());
+    EXPECT_EQ(std::string(simpleFile), file->getName());
+    EXPECT_EQ(nullptr, file->getData());
+    char buffer[40];
+    file->read(buffer, 7, 13);
+    checkBytes(buffer, 13, 7);
+
+    // the ranges are read at the same time, so they take one delay
+    std::vector<ReadRequest> requests;
+    for(unsigned long i=0; i < 4; ++i) {
+      requests.push_back({buffer + i * 10, i * 50, 10});
+    }
+    auto start = std::chrono::steady_clock::now();
+    file->readRanges(requests);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(elapsed, std::chrono::milliseconds(150));
+    for(unsigned int i=0; i < 4; ++i) {
+      checkBytes(buffer + i * 10, 10, i * 50);
+    }
+  }
+
+  TEST_F(TestCompression, testMemoryFile) {
+    SCOPED_TRACE("testMemoryFile");
+    std::vector<char> bytes(200);
+    for(unsigned int i=0; i < bytes.size(); ++i) {
+      bytes[i] = static_cast<char>(i);
+    }
+    std::unique_ptr<InputStream> file = readMemory(bytes.data(), 200);
+    EXPECT_EQ(200, file->getLength());
+    EXPECT_EQ("memory", file->getName());
+    EXPECT_EQ(bytes.data(), file->getData());
+    char buffer[10];
+    file->read(buffer, 50, 10);
+    checkBytes(buffer, 10, 50);
+    EXPECT_THROW(file->read(buffer, 195, 10), ParseError);
+
+    // streams point into the caller's memory
+    std::unique_ptr<SeekableInputStream> stream =
+      createSeekableFileStream(file.get(), 20, 100, 30);
+    const void *ptr;
+    int len;
+    ASSERT_TRUE(stream->Next(&ptr, &len));
+    EXPECT_EQ(bytes.data() + 20, static_cast<const char*>(ptr));
+    EXPECT_EQ(100, len);
+    EXPECT_FALSE(stream->Next(&ptr, &len));
+  }
+
+  TEST_F(TestCompression, testMappedStream) {
+    SCOPED_TRACE("testMappedStream");
+    std::unique_ptr<InputStream> file = readLocalFileMapped(simpleFile);
+    std::unique_ptr<SeekableInputStream> stream =
+      createSeekableFileStream(file.get(), 20, 100, 30);
+    const void *ptr;
+    int len;
+    ASSERT_EQ(true, stream->Next(&ptr, &len));
+    // the stream hands out the mapping itself rather than a copy
+    EXPECT_EQ(file->getData() + 20, static_cast<const char*>(ptr));
+    EXPECT_EQ(100, len);
+    stream->BackUp(40);
+    EXPECT_EQ(60, stream->ByteCount());
+    ASSERT_EQ(true, stream->Next(&ptr, &len));
+    EXPECT_EQ(file->getData() + 80, static_cast<const char*>(ptr));
+    EXPECT_EQ(40, len);
+    EXPECT_EQ(false, stream->Next(&ptr, &len));
+    {
+      std::list<unsigned long> offsets({10});
+      PositionProvider posn(offsets);
+      stream->seek(posn);
+    }
+    ASSERT_EQ(true, stream->Next(&ptr, &len));
+    checkBytes(static_cast<const char*>(ptr), len, 30);
+    EXPECT_EQ(90, len);
+
+    // unmapped files fall back to reading into a buffer
+    std::unique_ptr<InputStream> unmapped = readLocalFile(simpleFile);
+    EXPECT_EQ(nullptr, unmapped->getData());
+    stream = createSeekableFileStream(unmapped.get(), 20, 100, 30);
+    ASSERT_EQ(true, stream->Next(&ptr, &len));
+    EXPECT_EQ(30, len);
+    checkBytes(static_cast<const char*>(ptr), len, 20);
+  }
+
   TEST_F(TestCompression, testCreateCodec) {
     std::vector<char> bytes(10);
     for(unsigned int i=0; i < bytes.size(); ++i) {
@@ -321,20 +526,1148 @@ namespace orc {
     for(unsigned int i=0; i < bytes.size(); ++i) {
       EXPECT_EQ(static_cast<char>(i), static_cast<const char*>(ptr)[i]);
     }
-    EXPECT_THROW(createCodec(CompressionKind_ZLIB,
-                             std::unique_ptr<SeekableInputStream>
-                             (new SeekableArrayInputStream(bytes.data(),
-                                                           bytes.size())),
-                             32768), NotImplementedYet);
-    EXPECT_THROW(createCodec(CompressionKind_SNAPPY,
-                             std::unique_ptr<SeekableInputStream>
-                             (new SeekableArrayInputStream(bytes.data(),
-                                                           bytes.size())),
-                             32768), NotImplementedYet);
-    EXPECT_THROW(createCodec(CompressionKind_LZO,
+    EXPECT_THROW(createCodec(static_cast<CompressionKind>(99),
                              std::unique_ptr<SeekableInputStream>
                              (new SeekableArrayInputStream(bytes.data(),
                                                            bytes.size())),
                              32768), NotImplementedYet);
   }
+
+  TEST_F(TestCompression, testMeteredStream) {
+    std::vector<char> bytes(100);
+    MetricsCollector metrics(0);
+    MeteredSeekableInputStream stream
+      (std::unique_ptr<SeekableInputStream>
+         (new SeekableArrayInputStream(bytes.data(), bytes.size(), 40)),
+       metrics);
+    const void *ptr;
+    int length;
+    ASSERT_TRUE(stream.Next(&ptr, &length));
+    EXPECT_EQ(40, length);
+    stream.BackUp(10);
+    EXPECT_EQ(30, metrics.decompressedBytes);
+    ASSERT_TRUE(stream.Next(&ptr, &length));
+    EXPECT_EQ(40, length);
+    EXPECT_EQ(70, stream.ByteCount());
+    EXPECT_EQ(70, metrics.decompressedBytes);
+    ASSERT_TRUE(stream.Next(&ptr, &length));
+    EXPECT_FALSE(stream.Next(&ptr, &length));
+    EXPECT_EQ(100, metrics.decompressedBytes);
+    EXPECT_EQ(0, metrics.readCalls);
+  }
+
+  /**
+   * Append an ORC compression chunk header.
+   */
+  void addChunkHeader(std::string& out, unsigned long length,
+                      bool isOriginal) {
+    unsigned long header = (length << 1) | (isOriginal ? 1 : 0);
+    out += static_cast<char>(header & 0xff);
+    out += static_cast<char>((header >> 8) & 0xff);
+    out += static_cast<char>((header >> 16) & 0xff);
+  }
+
+  /**
+   * Append a chunk compressed with raw deflate.
+   */
+  std::string zlibCompress(const std::string& contents) {
+    z_stream zstream;
+    memset(&zstream, 0, sizeof(zstream));
+    EXPECT_EQ(Z_OK, deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                 -15, 8, Z_DEFAULT_STRATEGY));
+    std::vector<char> buffer(deflateBound(&zstream, contents.size()));
+    zstream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(contents.data()));
+    zstream.avail_in = static_cast<uInt>(contents.size());
+    zstream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+    zstream.avail_out = static_cast<uInt>(buffer.size());
+    EXPECT_EQ(Z_STREAM_END, deflate(&zstream, Z_FINISH));
+    std::string result(buffer.data(), zstream.total_out);
+    deflateEnd(&zstream);
+    return result;
+  }
+
+  void addZlibChunk(std::string& out, const std::string& contents) {
+    std::string chunk = zlibCompress(contents);
+    addChunkHeader(out, chunk.size(), false);
+    out += chunk;
+  }
+
+  std::string makePattern(unsigned long length, unsigned long start) {
+    std::string result;
+    for(unsigned long i=0; i < length; ++i) {
+      result += static_cast<char>((start + i) / 7);
+    }
+    return result;
+  }
+
+  std::string readAll(SeekableInputStream& stream) {
+    std::string result;
+    const void* ptr;
+    int length;
+    while (stream.Next(&ptr, &length)) {
+      result.append(static_cast<const char*>(ptr),
+                    static_cast<size_t>(length));
+    }
+    return result;
+  }
+
+  TEST_F(TestCompression, testZlibChunks) {
+    std::string compressed;
+    addZlibChunk(compressed, makePattern(1000, 0));
+    unsigned long originalStart = compressed.size();
+    addChunkHeader(compressed, 300, true);
+    compressed += makePattern(300, 1000);
+    addZlibChunk(compressed, makePattern(1000, 1300));
+    std::string expected = makePattern(2300, 0);
+
+    // read it in one block
+    std::unique_ptr<SeekableInputStream> stream =
+      createCodec(CompressionKind_ZLIB,
+                  std::unique_ptr<SeekableInputStream>
+                    (new SeekableArrayInputStream(compressed.data(),
+                                                  compressed.size())),
+                  1000);
+    const void* ptr;
+    int length;
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(1000, length);
+    stream->BackUp(400);
+    EXPECT_EQ(600, stream->ByteCount());
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(400, length);
+    EXPECT_EQ(expected.substr(600, 400),
+              std::string(static_cast<const char*>(ptr), 400));
+
+    // the original chunk points into the input
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(300, length);
+    EXPECT_EQ(compressed.data() + originalStart + 3,
+              static_cast<const char*>(ptr));
+    EXPECT_TRUE(stream->Skip(500));
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(500, length);
+    EXPECT_EQ(expected.substr(1800),
+              std::string(static_cast<const char*>(ptr), 500));
+    EXPECT_FALSE(stream->Next(&ptr, &length));
+    EXPECT_THROW(stream->BackUp(600), std::logic_error);
+
+    // read it with the headers and chunks split between blocks
+    for(long blockSize = 1; blockSize < 20; ++blockSize) {
+      stream = createCodec(CompressionKind_ZLIB,
+                           std::unique_ptr<SeekableInputStream>
+                             (new SeekableArrayInputStream(compressed.data(),
+                                                           compressed.size(),
+                                                           blockSize)),
+                           1000);
+      EXPECT_EQ(expected, readAll(*stream)) << "block size " << blockSize;
+    }
+  }
+
+  TEST_F(TestCompression, testZlibSeek) {
+    std::string compressed;
+    addZlibChunk(compressed, makePattern(1000, 0));
+    unsigned long secondChunk = compressed.size();
+    addChunkHeader(compressed, 300, true);
+    compressed += makePattern(300, 1000);
+    unsigned long thirdChunk = compressed.size();
+    addZlibChunk(compressed, makePattern(1000, 1300));
+    std::string expected = makePattern(2300, 0);
+    std::unique_ptr<SeekableInputStream> stream =
+      createCodec(CompressionKind_ZLIB,
+                  std::unique_ptr<SeekableInputStream>
+                    (new SeekableArrayInputStream(compressed.data(),
+                                                  compressed.size(), 7)),
+                  1000);
+    // positions are the chunk's offset and then the offset in the chunk
+    std::list<unsigned long> positions({thirdChunk, 250, secondChunk, 20,
+                                        0, 999, 0, 1000});
+    PositionProvider provider(positions);
+    stream->seek(provider);
+    EXPECT_EQ(expected.substr(1550), readAll(*stream));
+    stream->seek(provider);
+    EXPECT_EQ(expected.substr(1020), readAll(*stream));
+    stream->seek(provider);
+    EXPECT_EQ(expected.substr(999), readAll(*stream));
+    stream->seek(provider);
+    EXPECT_EQ(expected.substr(1000), readAll(*stream));
+  }
+
+  TEST_F(TestCompression, testZlibErrors) {
+    std::string compressed;
+    addZlibChunk(compressed, makePattern(1000, 0));
+
+    // the chunk doesn't fit in the buffer
+    std::unique_ptr<SeekableInputStream> stream =
+      createCodec(CompressionKind_ZLIB,
+                  std::unique_ptr<SeekableInputStream>
+                    (new SeekableArrayInputStream(compressed.data(),
+                                                  compressed.size())),
+                  999);
+    const void* ptr;
+    int length;
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+
+    // the chunk is cut off
+    stream = createCodec(CompressionKind_ZLIB,
+                         std::unique_ptr<SeekableInputStream>
+                           (new SeekableArrayInputStream(compressed.data(),
+                                                         compressed.size() -
+                                                           1)),
+                         1000);
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+    stream = createCodec(CompressionKind_ZLIB,
+                         std::unique_ptr<SeekableInputStream>
+                           (new SeekableArrayInputStream(compressed.data(),
+                                                         2)),
+                         1000);
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+
+    // the data is corrupt
+    std::string corrupt;
+    addChunkHeader(corrupt, 4, false);
+    corrupt += "\xff\xff\xff\xff";
+    stream = createCodec(CompressionKind_ZLIB,
+                         std::unique_ptr<SeekableInputStream>
+                           (new SeekableArrayInputStream(corrupt.data(),
+                                                         corrupt.size())),
+                         1000);
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+  }
+
+  TEST_F(TestCompression, testDecompressedInputStream) {
+    std::string compressed;
+    addZlibChunk(compressed, makePattern(1000, 0));
+    unsigned long secondChunk = compressed.size();
+    addChunkHeader(compressed, 300, true);
+    compressed += makePattern(300, 1000);
+    unsigned long thirdChunk = compressed.size();
+    addZlibChunk(compressed, makePattern(1000, 1300));
+    std::string expected = makePattern(2300, 0);
+
+    // declared first so that it outlives the chunks' buffers
+    BufferPool pool;
+    std::vector<DecompressedChunk> chunks =
+      findChunks(compressed.data(), compressed.size(), "test");
+    ASSERT_EQ(3, chunks.size());
+    EXPECT_EQ(0, chunks[0].compressedOffset);
+    EXPECT_FALSE(chunks[0].isOriginal);
+    EXPECT_EQ(nullptr, chunks[0].data);
+    EXPECT_EQ(secondChunk, chunks[1].compressedOffset);
+    EXPECT_TRUE(chunks[1].isOriginal);
+    EXPECT_EQ(compressed.data() + secondChunk + 3, chunks[1].data);
+    EXPECT_EQ(300, chunks[1].length);
+    EXPECT_EQ(thirdChunk, chunks[2].compressedOffset);
+
+    std::unique_ptr<Decompressor> decompressor =
+      createDecompressor(CompressionKind_ZLIB);
+    EXPECT_EQ("zlib", decompressor->getName());
+    decompressChunk(*decompressor, chunks[0], 1000, &pool, "test");
+    decompressChunk(*decompressor, chunks[2], 1000, &pool, "test");
+    EXPECT_EQ(1000, chunks[2].length);
+
+    DecompressedInputStream stream(chunks, "test");
+    EXPECT_EQ("decompressed(test)", stream.getName());
+    const void* ptr;
+    int length;
+    ASSERT_TRUE(stream.Next(&ptr, &length));
+    EXPECT_EQ(1000, length);
+    stream.BackUp(400);
+    EXPECT_EQ(600, stream.ByteCount());
+    ASSERT_TRUE(stream.Next(&ptr, &length));
+    EXPECT_EQ(400, length);
+    ASSERT_TRUE(stream.Next(&ptr, &length));
+    EXPECT_EQ(compressed.data() + secondChunk + 3,
+              static_cast<const char*>(ptr));
+    EXPECT_TRUE(stream.Skip(900));
+    ASSERT_TRUE(stream.Next(&ptr, &length));
+    EXPECT_EQ(100, length);
+    EXPECT_EQ(expected.substr(2200),
+              std::string(static_cast<const char*>(ptr), 100));
+    EXPECT_FALSE(stream.Next(&ptr, &length));
+    EXPECT_FALSE(stream.Skip(1));
+
+    // positions are the same as a DecompressionStream's
+    std::list<unsigned long> positions = {thirdChunk, 10, secondChunk, 299};
+    PositionProvider provider(positions);
+    stream.seek(provider);
+    ASSERT_TRUE(stream.Next(&ptr, &length));
+    EXPECT_EQ(expected.substr(1310, 990),
+              std::string(static_cast<const char*>(ptr), 990));
+    stream.seek(provider);
+    ASSERT_TRUE(stream.Next(&ptr, &length));
+    EXPECT_EQ(1, length);
+    std::list<unsigned long> badPositions = {1, 0, 3000};
+    PositionProvider badProvider(badPositions);
+    EXPECT_THROW(stream.seek(badProvider), ParseError);
+    EXPECT_THROW(stream.seek(badProvider), ParseError);
+
+    // the stream ends in the middle of a chunk
+    EXPECT_THROW(findChunks(compressed.data(), compressed.size() - 1, "test"),
+                 ParseError);
+    EXPECT_THROW(findChunks(compressed.data(), 2, "test"), ParseError);
+
+    // the chunk is bigger than the buffer
+    chunks = findChunks(compressed.data(), compressed.size(), "test");
+    EXPECT_THROW(decompressChunk(*decompressor, chunks[0], 999, &pool, "test"),
+                 ParseError);
+  }
+
+  /**
+   * Append a snappy literal element.
+   */
+  void addSnappyLiteral(std::string& out, const char* data,
+                        unsigned long length) {
+    unsigned long size = length - 1;
+    if (size < 60) {
+      out += static_cast<char>(size << 2);
+    } else {
+      unsigned int bytes = 0;
+      for(unsigned long value = size; value > 0; value >>= 8) {
+        bytes += 1;
+      }
+      out += static_cast<char>((59 + bytes) << 2);
+      for(unsigned int i=0; i < bytes; ++i) {
+        out += static_cast<char>((size >> (8 * i)) & 0xff);
+      }
+    }
+    out.append(data, length);
+  }
+
+  /**
+   * Compress with snappy's format using a simple greedy matcher.
+   */
+  std::string snappyCompress(const std::string& input) {
+    std::string out;
+    for(unsigned long value = input.size(); ; value >>= 7) {
+      if (value < 0x80) {
+        out += static_cast<char>(value);
+        break;
+      }
+      out += static_cast<char>((value & 0x7f) | 0x80);
+    }
+    std::vector<long> table(1 << 14, -1);
+    unsigned long literalStart = 0;
+    unsigned long position = 0;
+    while (position + 4 <= input.size()) {
+      unsigned int key;
+      memcpy(&key, input.data() + position, 4);
+      unsigned int hash = (key * 0x1e35a7bd) >> 18;
+      long candidate = table[hash];
+      table[hash] = static_cast<long>(position);
+      if (candidate < 0 ||
+          position - static_cast<unsigned long>(candidate) >= 65536 ||
+          memcmp(input.data() + candidate, input.data() + position, 4) != 0) {
+        position += 1;
+        continue;
+      }
+      if (position > literalStart) {
+        addSnappyLiteral(out, input.data() + literalStart,
+                         position - literalStart);
+      }
+      unsigned long offset = position - static_cast<unsigned long>(candidate);
+      unsigned long length = 4;
+      while (position + length < input.size() &&
+             input[position + length] == input[candidate + length]) {
+        length += 1;
+      }
+      position += length;
+      literalStart = position;
+      while (length > 0) {
+        unsigned long size = std::min(length, 64UL);
+        if (length - size > 0 && length - size < 4) {
+          size = length - 4;
+        }
+        if (size < 12 && offset < 2048) {
+          out += static_cast<char>(1 | ((size - 4) << 2) | ((offset >> 8) << 5));
+          out += static_cast<char>(offset & 0xff);
+        } else {
+          out += static_cast<char>(2 | ((size - 1) << 2));
+          out += static_cast<char>(offset & 0xff);
+          out += static_cast<char>(offset >> 8);
+        }
+        length -= size;
+      }
+    }
+    if (input.size() > literalStart) {
+      addSnappyLiteral(out, input.data() + literalStart,
+                       input.size() - literalStart);
+    }
+    return out;
+  }
+
+  /**
+   * Build an ORC stream from the contents by compressing each chunk.
+   */
+  std::string makeCompressedStream(const std::string& contents,
+                                   unsigned long chunkSize,
+                                   std::string (*compress)
+                                     (const std::string&)) {
+    std::string result;
+    for(unsigned long i=0; i < contents.size(); i += chunkSize) {
+      std::string chunk = compress(contents.substr(i, chunkSize));
+      addChunkHeader(result, chunk.size(), false);
+      result += chunk;
+    }
+    return result;
+  }
+
+  /**
+   * Build an ORC stream of snappy chunks from the contents.
+   */
+  std::string makeSnappyStream(const std::string& contents,
+                               unsigned long chunkSize) {
+    return makeCompressedStream(contents, chunkSize, snappyCompress);
+  }
+
+  std::unique_ptr<SeekableInputStream> createSnappy(const std::string& data,
+                                                    unsigned long bufferSize,
+                                                    long blockSize = -1) {
+    return createCodec(CompressionKind_SNAPPY,
+                       std::unique_ptr<SeekableInputStream>
+                         (new SeekableArrayInputStream(data.data(),
+                                                       data.size(),
+                                                       blockSize)),
+                       bufferSize);
+  }
+
+  TEST_F(TestCompression, testSnappyChunks) {
+    std::string expected = makePattern(5000, 0) + "abcdefgh" +
+      makePattern(1000, 17);
+    std::string compressed = makeSnappyStream(expected, 2000);
+    EXPECT_GT(expected.size(), compressed.size());
+    unsigned long originalStart = compressed.size();
+    addChunkHeader(compressed, 300, true);
+    compressed += makePattern(300, 1000);
+    expected += makePattern(300, 1000);
+
+    std::unique_ptr<SeekableInputStream> stream =
+      createSnappy(compressed, 2000);
+    const void* ptr;
+    int length;
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(2000, length);
+    stream->BackUp(100);
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(100, length);
+    EXPECT_EQ(expected.substr(1900, 100),
+              std::string(static_cast<const char*>(ptr), 100));
+    EXPECT_TRUE(stream->Skip(2000));
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(2000, length);
+    EXPECT_EQ(expected.substr(4000, 2000),
+              std::string(static_cast<const char*>(ptr), 2000));
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(8, length);
+
+    // original chunks point into the input
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(compressed.data() + originalStart + 3,
+              static_cast<const char*>(ptr));
+    EXPECT_FALSE(stream->Next(&ptr, &length));
+
+    for(long blockSize = 1; blockSize < 20; blockSize += 3) {
+      stream = createSnappy(compressed, 2000, blockSize);
+      EXPECT_EQ(expected, readAll(*stream)) << "block size " << blockSize;
+    }
+  }
+
+  TEST_F(TestCompression, testSnappyElements) {
+    // long literals, a 1 byte offset copy, an overlapping 2 byte offset
+    // copy, and a 4 byte offset copy
+    std::string expected(70, 'x');
+    expected += "hello";
+    expected += "hellohello";
+    expected += std::string(65, 'y');
+    expected += "xxxxxxxx";
+    std::string chunk;
+    chunk += std::string("\x9e\x01", 2);
+    addSnappyLiteral(chunk, expected.data(), 75);
+    chunk += static_cast<char>(1 | (6 << 2));
+    chunk += static_cast<char>(5);
+    addSnappyLiteral(chunk, "y", 1);
+    chunk += static_cast<char>(2 | (63 << 2));
+    chunk += std::string("\x01\x00", 2);
+    chunk += static_cast<char>(3 | (7 << 2));
+    chunk += std::string("\x96\x00\x00\x00", 4);
+    std::string compressed;
+    addChunkHeader(compressed, chunk.size(), false);
+    compressed += chunk;
+    std::unique_ptr<SeekableInputStream> stream = createSnappy(compressed,
+                                                               1000);
+    EXPECT_EQ(expected, readAll(*stream));
+  }
+
+  TEST_F(TestCompression, testSnappyErrors) {
+    const void* ptr;
+    int length;
+    std::string compressed = makeSnappyStream(makePattern(1000, 0), 1000);
+    // the chunk doesn't fit in the buffer
+    std::unique_ptr<SeekableInputStream> stream = createSnappy(compressed,
+                                                               999);
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+
+    // copies from before the start of the output
+    std::string chunk("\x08\x01\x01", 3);
+    std::string bad;
+    addChunkHeader(bad, chunk.size(), false);
+    bad += chunk;
+    stream = createSnappy(bad, 1000);
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+
+    // the output is shorter than the declared length
+    chunk = std::string("\x08\x00a", 3);
+    bad.clear();
+    addChunkHeader(bad, chunk.size(), false);
+    bad += chunk;
+    stream = createSnappy(bad, 1000);
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+
+    // the literal runs past the end of the chunk
+    chunk = std::string("\x08\x1c" "a", 3);
+    bad.clear();
+    addChunkHeader(bad, chunk.size(), false);
+    bad += chunk;
+    stream = createSnappy(bad, 1000);
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+  }
+
+  /**
+   * Append an LZO length extension: zero bytes worth 255 each and a
+   * final non-zero byte.
+   */
+  void addLzoLength(std::string& out, unsigned long length) {
+    while (length > 255) {
+      out += '\0';
+      length -= 255;
+    }
+    out += static_cast<char>(length);
+  }
+
+  /**
+   * Append a run of literals to an LZO1X chunk. Runs of 1 to 3 literals
+   * after a match are recorded in the match's last distance byte.
+   */
+  void addLzoLiterals(std::string& out, const char* data,
+                      unsigned long length, bool afterMatch) {
+    if (length == 0) {
+      return;
+    }
+    if (out.empty() && length <= 238) {
+      out += static_cast<char>(17 + length);
+    } else if (afterMatch && length <= 3) {
+      out[out.size() - 2] = static_cast<char>(out[out.size() - 2] | length);
+    } else if (length <= 18) {
+      out += static_cast<char>(length - 3);
+    } else {
+      out += '\0';
+      addLzoLength(out, length - 18);
+    }
+    out.append(data, length);
+  }
+
+  /**
+   * Append an LZO1X match, picking the shortest encoding for it.
+   */
+  void addLzoMatch(std::string& out, unsigned long length,
+                   unsigned long distance) {
+    unsigned long encoded;
+    if (length <= 8 && distance <= 0x800) {
+      out += static_cast<char>(((length - 1) << 5) |
+                               (((distance - 1) & 7) << 2));
+      out += static_cast<char>((distance - 1) >> 3);
+      return;
+    } else if (distance <= 0x4000) {
+      encoded = distance - 1;
+      if (length <= 33) {
+        out += static_cast<char>(32 | (length - 2));
+      } else {
+        out += static_cast<char>(32);
+        addLzoLength(out, length - 33);
+      }
+    } else {
+      encoded = distance - 0x4000;
+      char flag = static_cast<char>(16 | ((encoded & 0x4000) >> 11));
+      if (length <= 9) {
+        out += static_cast<char>(flag | (length - 2));
+      } else {
+        out += flag;
+        addLzoLength(out, length - 9);
+      }
+    }
+    out += static_cast<char>((encoded & 63) << 2);
+    out += static_cast<char>((encoded >> 6) & 0xff);
+  }
+
+  /**
+   * Compress with LZO1X's format using a simple greedy matcher.
+   */
+  std::string lzoCompress(const std::string& input) {
+    std::string out;
+    std::vector<long> table(1 << 14, -1);
+    unsigned long literalStart = 0;
+    unsigned long position = 0;
+    bool afterMatch = false;
+    while (position + 4 <= input.size()) {
+      unsigned int key;
+      memcpy(&key, input.data() + position, 4);
+      unsigned int hash = (key * 0x1e35a7bd) >> 18;
+      long candidate = table[hash];
+      table[hash] = static_cast<long>(position);
+      if (candidate < 0 ||
+          position - static_cast<unsigned long>(candidate) > 0xbfff ||
+          memcmp(input.data() + candidate, input.data() + position, 4) != 0) {
+        position += 1;
+        continue;
+      }
+      addLzoLiterals(out, input.data() + literalStart,
+                     position - literalStart, afterMatch);
+      unsigned long length = 4;
+      while (position + length < input.size() &&
+             input[position + length] == input[candidate + length]) {
+        length += 1;
+      }
+      addLzoMatch(out, length, position - static_cast<unsigned long>(candidate));
+      position += length;
+      literalStart = position;
+      afterMatch = true;
+    }
+    addLzoLiterals(out, input.data() + literalStart,
+                   input.size() - literalStart, afterMatch);
+    out += std::string("\x11\0\0", 3);
+    return out;
+  }
+
+  /**
+   * Build an ORC stream of LZO chunks from the contents.
+   */
+  std::string makeLzoStream(const std::string& contents,
+                            unsigned long chunkSize) {
+    return makeCompressedStream(contents, chunkSize, lzoCompress);
+  }
+
+  std::unique_ptr<SeekableInputStream> createLzo(const std::string& data,
+                                                 unsigned long bufferSize,
+                                                 long blockSize = -1) {
+    return createCodec(CompressionKind_LZO,
+                       std::unique_ptr<SeekableInputStream>
+                         (new SeekableArrayInputStream(data.data(),
+                                                       data.size(),
+                                                       blockSize)),
+                       bufferSize);
+  }
+
+  TEST_F(TestCompression, testLzoChunks) {
+    // mix short and long runs with near and distant matches
+    std::string expected = makePattern(40000, 0) + "abc" +
+      makePattern(30000, 0) + std::string(5000, 'z') + "q" +
+      makePattern(2000, 3);
+    std::string compressed = makeLzoStream(expected, 32768);
+    EXPECT_GT(expected.size(), compressed.size());
+    unsigned long originalStart = compressed.size();
+    addChunkHeader(compressed, 300, true);
+    compressed += makePattern(300, 1000);
+    expected += makePattern(300, 1000);
+
+    std::unique_ptr<SeekableInputStream> stream =
+      createLzo(compressed, 32768);
+    EXPECT_EQ("lzo(", stream->getName().substr(0, 4));
+    const void* ptr;
+    int length;
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(32768, length);
+    EXPECT_EQ(expected.substr(0, 32768),
+              std::string(static_cast<const char*>(ptr), 32768));
+    EXPECT_TRUE(stream->Skip(40000));
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(4236, length);
+    EXPECT_EQ(expected.substr(72768, 4236),
+              std::string(static_cast<const char*>(ptr), 4236));
+
+    // original chunks point into the input
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(compressed.data() + originalStart + 3,
+              static_cast<const char*>(ptr));
+    EXPECT_FALSE(stream->Next(&ptr, &length));
+
+    for(long blockSize = 1; blockSize < 20; blockSize += 3) {
+      stream = createLzo(compressed, 32768, blockSize);
+      EXPECT_EQ(expected, readAll(*stream)) << "block size " << blockSize;
+    }
+
+    // an empty chunk
+    compressed.clear();
+    addChunkHeader(compressed, 3, false);
+    compressed += std::string("\x11\0\0", 3);
+    stream = createLzo(compressed, 100);
+    EXPECT_EQ("", readAll(*stream));
+  }
+
+  TEST_F(TestCompression, testLzoShortMatches) {
+    // a literal run, a short match with one trailing literal, and the
+    // two byte match that may follow it
+    std::string chunk("\x15" "abcd" "\x4d\x00" "x" "\x04\x00"
+                      "\x11\x00\x00", 13);
+    std::string compressed;
+    addChunkHeader(compressed, chunk.size(), false);
+    compressed += chunk;
+    std::unique_ptr<SeekableInputStream> stream = createLzo(compressed, 100);
+    EXPECT_EQ("abcdabcxcx", readAll(*stream));
+
+    // a three byte match just past 2k after a literal run
+    std::string expected;
+    unsigned int state = 1;
+    for(unsigned int i=0; i < 2100; ++i) {
+      state = state * 1103515245 + 12345;
+      expected += static_cast<char>(state >> 24);
+    }
+    chunk = lzoCompress(expected);
+    ASSERT_EQ(2113, chunk.size());
+    chunk.resize(chunk.size() - 3);
+    chunk += std::string("\x00\x01\x11\x00\x00", 5);
+    expected += expected.substr(2100 - 2053, 3);
+    compressed.clear();
+    addChunkHeader(compressed, chunk.size(), false);
+    compressed += chunk;
+    stream = createLzo(compressed, 3000);
+    EXPECT_EQ(expected, readAll(*stream));
+  }
+
+  TEST_F(TestCompression, testLzoErrors) {
+    const void* ptr;
+    int length;
+    std::string compressed = makeLzoStream(makePattern(1000, 0), 1000);
+    // the chunk doesn't fit in the buffer
+    std::unique_ptr<SeekableInputStream> stream = createLzo(compressed, 999);
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+
+    const char* badChunks[] = {
+      // a match before the start of the output
+      "\x15" "abcd" "\x4d\x01\x11\x00\x00",
+      // a missing end marker
+      "\x15" "abcd",
+      // bytes after the end marker
+      "\x15" "abcd" "\x11\x00\x00\x00",
+      // literals past the end of the chunk
+      "\x20" "abc" "\x11\x00\x00"};
+    unsigned long badLengths[] = {10, 5, 9, 7};
+    for(unsigned int i=0; i < 4; ++i) {
+      std::string bad;
+      addChunkHeader(bad, badLengths[i], false);
+      bad.append(badChunks[i], badLengths[i]);
+      stream = createLzo(bad, 1000);
+      EXPECT_THROW(stream->Next(&ptr, &length), ParseError) << "case " << i;
+    }
+  }
+
+  /**
+   * Append an LZ4 length extension: bytes of 255 and a final smaller byte.
+   */
+  void addLz4Length(std::string& out, unsigned long length) {
+    while (length >= 255) {
+      out += static_cast<char>(255);
+      length -= 255;
+    }
+    out += static_cast<char>(length);
+  }
+
+  /**
+   * Append an LZ4 sequence of literals and an optional match.
+   */
+  void addLz4Sequence(std::string& out, const char* literals,
+                      unsigned long literalLength, unsigned long matchLength,
+                      unsigned long offset) {
+    unsigned long matchCode = matchLength == 0 ? 0 : matchLength - 4;
+    out += static_cast<char>((std::min(literalLength, 15UL) << 4) |
+                             std::min(matchCode, 15UL));
+    if (literalLength >= 15) {
+      addLz4Length(out, literalLength - 15);
+    }
+    out.append(literals, literalLength);
+    if (matchLength != 0) {
+      out += static_cast<char>(offset & 0xff);
+      out += static_cast<char>(offset >> 8);
+      if (matchCode >= 15) {
+        addLz4Length(out, matchCode - 15);
+      }
+    }
+  }
+
+  /**
+   * Compress with LZ4's block format using a simple greedy matcher that
+   * keeps the format's rule that the last 5 bytes are literals.
+   */
+  std::string lz4Compress(const std::string& input) {
+    std::string out;
+    std::vector<long> table(1 << 14, -1);
+    unsigned long literalStart = 0;
+    unsigned long position = 0;
+    while (position + 12 <= input.size()) {
+      unsigned int key;
+      memcpy(&key, input.data() + position, 4);
+      unsigned int hash = (key * 0x1e35a7bd) >> 18;
+      long candidate = table[hash];
+      table[hash] = static_cast<long>(position);
+      if (candidate < 0 ||
+          position - static_cast<unsigned long>(candidate) > 0xffff ||
+          memcmp(input.data() + candidate, input.data() + position, 4) != 0) {
+        position += 1;
+        continue;
+      }
+      unsigned long length = 4;
+      while (position + length + 5 < input.size() &&
+             input[position + length] == input[candidate + length]) {
+        length += 1;
+      }
+      addLz4Sequence(out, input.data() + literalStart,
+                     position - literalStart, length,
+                     position - static_cast<unsigned long>(candidate));
+      position += length;
+      literalStart = position;
+    }
+    addLz4Sequence(out, input.data() + literalStart,
+                   input.size() - literalStart, 0, 0);
+    return out;
+  }
+
+  std::unique_ptr<SeekableInputStream> createStream(CompressionKind kind,
+                                                    const std::string& data,
+                                                    unsigned long bufferSize,
+                                                    long blockSize = -1) {
+    return createCodec(kind,
+                       std::unique_ptr<SeekableInputStream>
+                         (new SeekableArrayInputStream(data.data(),
+                                                       data.size(),
+                                                       blockSize)),
+                       bufferSize);
+  }
+
+  TEST_F(TestCompression, testLz4Chunks) {
+    std::string expected = makePattern(40000, 0) + std::string(5000, 'z') +
+      "q" + makePattern(2000, 3);
+    std::string compressed = makeCompressedStream(expected, 32768,
+                                                  lz4Compress);
+    EXPECT_GT(expected.size(), compressed.size());
+    unsigned long originalStart = compressed.size();
+    addChunkHeader(compressed, 300, true);
+    compressed += makePattern(300, 1000);
+    expected += makePattern(300, 1000);
+
+    std::unique_ptr<SeekableInputStream> stream =
+      createStream(CompressionKind_LZ4, compressed, 32768);
+    EXPECT_EQ("lz4(", stream->getName().substr(0, 4));
+    const void* ptr;
+    int length;
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(32768, length);
+    EXPECT_EQ(expected.substr(0, 32768),
+              std::string(static_cast<const char*>(ptr), 32768));
+    EXPECT_TRUE(stream->Skip(10000));
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(4233, length);
+    EXPECT_EQ(expected.substr(42768, 4233),
+              std::string(static_cast<const char*>(ptr), 4233));
+
+    // original chunks point into the input
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(compressed.data() + originalStart + 3,
+              static_cast<const char*>(ptr));
+    EXPECT_FALSE(stream->Next(&ptr, &length));
+
+    for(long blockSize = 1; blockSize < 20; blockSize += 3) {
+      stream = createStream(CompressionKind_LZ4, compressed, 32768,
+                            blockSize);
+      EXPECT_EQ(expected, readAll(*stream)) << "block size " << blockSize;
+    }
+  }
+
+  TEST_F(TestCompression, testLz4Errors) {
+    const void* ptr;
+    int length;
+    std::string compressed = makeCompressedStream(makePattern(1000, 0), 1000,
+                                                  lz4Compress);
+    // the chunk doesn't fit in the buffer
+    std::unique_ptr<SeekableInputStream> stream =
+      createStream(CompressionKind_LZ4, compressed, 999);
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+
+    const char* badChunks[] = {
+      // a zero offset
+      "\x10" "a" "\x00\x00",
+      // an offset before the start of the output
+      "\x10" "a" "\x02\x00",
+      // a truncated offset
+      "\x10" "a" "\x01",
+      // literals past the end of the chunk
+      "\x30" "ab",
+      // a truncated length extension
+      "\xf0"};
+    unsigned long badLengths[] = {4, 4, 3, 3, 1};
+    for(unsigned int i=0; i < 5; ++i) {
+      std::string bad;
+      addChunkHeader(bad, badLengths[i], false);
+      bad.append(badChunks[i], badLengths[i]);
+      stream = createStream(CompressionKind_LZ4, bad, 1000);
+      EXPECT_THROW(stream->Next(&ptr, &length), ParseError) << "case " << i;
+    }
+  }
+
+#ifdef HAVE_ZSTD
+  std::string zstdCompress(const std::string& contents) {
+    std::string result(ZSTD_compressBound(contents.size()), '\0');
+    size_t size = ZSTD_compress(&result[0], result.size(), contents.data(),
+                                contents.size(), 3);
+    EXPECT_FALSE(ZSTD_isError(size));
+    result.resize(size);
+    return result;
+  }
+
+  TEST_F(TestCompression, testZstdChunks) {
+    std::string expected = makePattern(40000, 0) + std::string(5000, 'z');
+    std::string compressed = makeCompressedStream(expected, 32768,
+                                                  zstdCompress);
+    EXPECT_GT(expected.size(), compressed.size());
+    addChunkHeader(compressed, 300, true);
+    compressed += makePattern(300, 1000);
+    expected += makePattern(300, 1000);
+
+    std::unique_ptr<SeekableInputStream> stream =
+      createStream(CompressionKind_ZSTD, compressed, 32768);
+    EXPECT_EQ("zstd(", stream->getName().substr(0, 5));
+    EXPECT_TRUE(stream->Skip(40000));
+    EXPECT_EQ(expected.substr(40000), readAll(*stream));
+    for(long blockSize = 1; blockSize < 20; blockSize += 3) {
+      stream = createStream(CompressionKind_ZSTD, compressed, 32768,
+                            blockSize);
+      EXPECT_EQ(expected, readAll(*stream)) << "block size " << blockSize;
+    }
+
+    const void* ptr;
+    int length;
+    // the chunk doesn't fit in the buffer
+    stream = createStream(CompressionKind_ZSTD, compressed, 32767);
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+    std::string bad;
+    addChunkHeader(bad, 4, false);
+    bad += "junk";
+    stream = createStream(CompressionKind_ZSTD, bad, 1000);
+    EXPECT_THROW(stream->Next(&ptr, &length), ParseError);
+  }
+#else
+  TEST_F(TestCompression, testZstdUnavailable) {
+    std::string compressed;
+    EXPECT_THROW(createStream(CompressionKind_ZSTD, compressed, 1000),
+                 NotImplementedYet);
+  }
+#endif
+
+  /**
+   * A codec that stores each byte plus one, which stands in for a codec
+   * that an application registers.
+   */
+  class IncrementDecompressor: public Decompressor {
+  public:
+    ~IncrementDecompressor() override;
+
+    unsigned long decompress(const char* input,
+                             unsigned long length,
+                             char* output,
+                             unsigned long maxOutputLength) override {
+      if (length > maxOutputLength) {
+        throw ParseError("increment chunk is larger than the buffer");
+      }
+      for(unsigned long i=0; i < length; ++i) {
+        output[i] = static_cast<char>(input[i] - 1);
+      }
+      return length;
+    }
+
+    std::string getName() const override {
+      return "increment";
+    }
+  };
+
+  IncrementDecompressor::~IncrementDecompressor() {
+    // PASS
+  }
+
+  TEST_F(TestCompression, testRegisteredDecompressor) {
+    std::string expected = makePattern(2500, 0);
+    std::string compressed;
+    std::vector<unsigned long> chunkOffsets;
+    for(unsigned long i=0; i < expected.size(); i += 1000) {
+      chunkOffsets.push_back(compressed.size());
+      std::string chunk = expected.substr(i, 1000);
+      for(char& c: chunk) {
+        c = static_cast<char>(c + 1);
+      }
+      addChunkHeader(compressed, chunk.size(), false);
+      compressed += chunk;
+    }
+
+    int created = 0;
+    registerDecompressor(CompressionKind_LZ4, [&created] {
+        created += 1;
+        return std::unique_ptr<Decompressor>(new IncrementDecompressor());
+      });
+    std::unique_ptr<SeekableInputStream> stream =
+      createStream(CompressionKind_LZ4, compressed, 1000, 7);
+    EXPECT_EQ(1, created);
+    EXPECT_EQ("increment(", stream->getName().substr(0, 10));
+    EXPECT_EQ(expected, readAll(*stream));
+    std::list<unsigned long> positions = {chunkOffsets[1], 5};
+    PositionProvider provider(positions);
+    stream->seek(provider);
+    EXPECT_EQ(expected.substr(1005), readAll(*stream));
+
+    // errors name the stream
+    stream = createStream(CompressionKind_LZ4, compressed, 999);
+    const void* ptr;
+    int length;
+    try {
+      stream->Next(&ptr, &length);
+      ADD_FAILURE() << "expected a ParseError";
+    } catch (ParseError& err) {
+      EXPECT_EQ("increment chunk is larger than the buffer in increment(",
+                std::string(err.what()).substr(0, 55));
+    }
+
+    // the built-in codec comes back
+    unregisterDecompressor(CompressionKind_LZ4);
+    EXPECT_EQ("lz4", createDecompressor(CompressionKind_LZ4)->getName());
+    EXPECT_EQ(2, created);
+
+    EXPECT_THROW(registerDecompressor(CompressionKind_NONE, [] {
+          return std::unique_ptr<Decompressor>(new IncrementDecompressor());
+        }), std::logic_error);
+    EXPECT_THROW(registerDecompressor(CompressionKind_ZLIB,
+                                      DecompressorFactory()),
+                 std::logic_error);
+    registerDecompressor(CompressionKind_ZLIB, [] {
+        return std::unique_ptr<Decompressor>();
+      });
+    EXPECT_THROW(createDecompressor(CompressionKind_ZLIB), std::logic_error);
+    unregisterDecompressor(CompressionKind_ZLIB);
+  }
+
+  /**
+   * Build data that compresses about as well as typical column data.
+   */
+  std::string makeBenchmarkData(unsigned long length) {
+    std::string result;
+    unsigned long state = 1;
+    while (result.size() < length) {
+      state = state * 6364136223846793005UL + 1442695040888963407UL;
+      std::ostringstream value;
+      value << "row-" << (state >> 54) << ",";
+      result += value.str();
+    }
+    result.resize(length);
+    return result;
+  }
+
+  /**
+   * Read a stream to the end and return the throughput in MB/s.
+   */
+  double measureThroughput(SeekableInputStream& stream,
+                           unsigned long expectedLength) {
+    auto start = std::chrono::steady_clock::now();
+    const void* ptr;
+    int length;
+    unsigned long total = 0;
+    unsigned long checksum = 0;
+    while (stream.Next(&ptr, &length)) {
+      total += static_cast<unsigned long>(length);
+      checksum += static_cast<const unsigned char*>(ptr)[length - 1];
+    }
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(expectedLength, total);
+    EXPECT_NE(0, checksum);
+    return static_cast<double>(total) / (1024 * 1024) / elapsed.count();
+  }
+
+  TEST_F(TestCompression, DISABLED_benchmarkSnappy) {
+    const unsigned long dataSize = 64 * 1024 * 1024;
+    const unsigned long chunkSize = 256 * 1024;
+    std::string data = makeBenchmarkData(dataSize);
+    std::string compressed = makeSnappyStream(data, chunkSize);
+    std::cout << "snappy ratio "
+              << static_cast<double>(compressed.size()) /
+                   static_cast<double>(data.size()) << "\n";
+    for(int trial = 0; trial < 3; ++trial) {
+      std::unique_ptr<SeekableInputStream> none =
+        createCodec(CompressionKind_NONE,
+                    std::unique_ptr<SeekableInputStream>
+                      (new SeekableArrayInputStream(data.data(), data.size(),
+                                                    chunkSize)),
+                    chunkSize);
+      std::unique_ptr<SeekableInputStream> snappy =
+        createSnappy(compressed, chunkSize);
+      double noneRate = measureThroughput(*none, dataSize);
+      double snappyRate = measureThroughput(*snappy, dataSize);
+      std::cout << "none " << noneRate << " MB/s, snappy " << snappyRate
+                << " MB/s\n";
+    }
+  }
+
+  /**
+   * Get the uncompressed contents of a zlib compressed ORC file, which is
+   * everything between the header and the postscript.
+   */
+  std::string readFileContents(const std::string& filename) {
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+    EXPECT_LT(4, bytes.size()) << "can't read " << filename;
+    if (bytes.size() <= 4) {
+      return "";
+    }
+    unsigned long postscriptLength =
+      static_cast<unsigned char>(bytes[bytes.size() - 1]);
+    std::string compressed = bytes.substr(3, bytes.size() - 4 -
+                                          postscriptLength);
+    std::unique_ptr<SeekableInputStream> stream =
+      createStream(CompressionKind_ZLIB, compressed, 256 * 1024);
+    return readAll(*stream);
+  }
+
+  TEST_F(TestCompression, DISABLED_benchmarkCodecs) {
+    struct {
+      const char* name;
+      CompressionKind kind;
+      std::string (*compress)(const std::string&);
+    } codecs[] = {
+      {"none", CompressionKind_NONE, nullptr},
+      {"zlib", CompressionKind_ZLIB, zlibCompress},
+      {"snappy", CompressionKind_SNAPPY, snappyCompress},
+      {"lzo", CompressionKind_LZO, lzoCompress},
+      {"lz4", CompressionKind_LZ4, lz4Compress},
+#ifdef HAVE_ZSTD
+      {"zstd", CompressionKind_ZSTD, zstdCompress},
+#endif
+    };
+    const unsigned long chunkSize = 256 * 1024;
+    const char* files[] = {"demo-11-zlib.orc", "demo-12-zlib.orc"};
+    for(const char* file: files) {
+      std::string data = readFileContents(std::string(exampleDirectory) +
+                                          "/" + file);
+      std::cout << file << ": " << data.size() << " bytes\n";
+      for(auto& codec: codecs) {
+        std::string compressed = codec.compress == nullptr ? data :
+          makeCompressedStream(data, chunkSize, codec.compress);
+        double best = 0;
+        for(int trial = 0; trial < 3; ++trial) {
+          std::unique_ptr<SeekableInputStream> stream =
+            createStream(codec.kind, compressed, chunkSize,
+                         static_cast<long>(chunkSize));
+          best = std::max(best, measureThroughput(*stream, data.size()));
+        }
+        std::cout << "  " << codec.name << ": ratio "
+                  << static_cast<double>(compressed.size()) /
+                       static_cast<double>(data.size())
+                  << ", " << best / 1024 << " GB/s\n";
+      }
+    }
+  }
 }
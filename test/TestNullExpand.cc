@@ -0,0 +1,174 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NullExpand.hh"
+#include "wrap/gtest-wrapper.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace orc {
+
+  /**
+   * Make a notNull array where each position is null with the given
+   * probability.
+   */
+  std::vector<char> makeNotNull(unsigned long count, double nullFraction,
+                                std::mt19937& random) {
+    std::bernoulli_distribution isNull(nullFraction);
+    std::vector<char> result(count);
+    for (char& entry: result) {
+      // any non-zero byte means not null
+      entry = isNull(random) ? 0 : static_cast<char>(1 + random() % 255);
+    }
+    return result;
+  }
+
+  /**
+   * Expand random values over random null patterns at every level, checking
+   * that the values land in order and that the nulls are untouched.
+   */
+  template <typename T>
+  void checkExpand() {
+    std::mt19937 random(23);
+    const unsigned long counts[] = {0, 1, 7, 8, 9, 15, 16, 17, 31, 64, 100,
+                                    1000, 1027};
+    const double nullFractions[] = {0, 0.05, 0.5, 0.95, 1};
+    for (int level = BitUnpackLevel_SCALAR; level <= getBitUnpackLevel();
+         ++level) {
+      for (unsigned long count: counts) {
+        for (double nullFraction: nullFractions) {
+          std::vector<char> notNull = makeNotNull(count, nullFraction, random);
+          std::vector<T> values(countNonNulls(notNull.data(), count));
+          for (T& value: values) {
+            value = static_cast<T>(random());
+          }
+          std::vector<T> output(count, static_cast<T>(-1));
+          expandNonNulls(values.data(), notNull.data(), count, output.data(),
+                         static_cast<BitUnpackLevel>(level));
+          unsigned long used = 0;
+          for (unsigned long i = 0; i < count; ++i) {
+            ASSERT_EQ(notNull[i] ? values[used++] : static_cast<T>(-1),
+                      output[i])
+                << getBitUnpackLevelName(static_cast<BitUnpackLevel>(level))
+                << " count " << count << " nulls " << nullFraction
+                << " at " << i;
+          }
+        }
+      }
+    }
+  }
+
+  TEST(NullExpand, countNonNulls) {
+    std::mt19937 random(29);
+    for (unsigned long count: {0UL, 1UL, 15UL, 16UL, 17UL, 1000UL}) {
+      std::vector<char> notNull = makeNotNull(count, 0.3, random);
+      unsigned long expected = 0;
+      for (char entry: notNull) {
+        expected += entry != 0;
+      }
+      EXPECT_EQ(expected, countNonNulls(notNull.data(), count))
+          << "count " << count;
+    }
+  }
+
+  TEST(NullExpand, countNonNullBits) {
+    std::mt19937 random(37);
+    std::vector<unsigned char> bits(200);
+    for (unsigned char& byte: bits) {
+      byte = static_cast<unsigned char>(random());
+    }
+    for (unsigned long count: {0UL, 1UL, 63UL, 64UL, 65UL, 1000UL, 1600UL}) {
+      unsigned long expected = 0;
+      for (unsigned long i = 0; i < count; ++i) {
+        expected += (bits[i / 8] >> (7 - i % 8)) & 1;
+      }
+      EXPECT_EQ(expected, countNonNullBits(bits.data(), count))
+          << "count " << count;
+    }
+  }
+
+  TEST(NullExpand, expand64) {
+    checkExpand<long>();
+  }
+
+  TEST(NullExpand, expand8) {
+    checkExpand<char>();
+  }
+
+  TEST(NullExpand, expandPointers) {
+    char buffer[] = "abcdef";
+    std::vector<char> notNull = {0, 1, 1, 0, 0, 1, 0};
+    std::vector<char*> values = {buffer, buffer + 2, buffer + 5};
+    std::vector<char*> output(notNull.size(), nullptr);
+    expandNonNulls(values.data(), notNull.data(), notNull.size(),
+                   output.data());
+    std::vector<char*> expected = {nullptr, buffer, buffer + 2, nullptr,
+                                   nullptr, buffer + 5, nullptr};
+    EXPECT_EQ(expected, output);
+  }
+
+  TEST(NullExpand, readNonNulls) {
+    std::vector<char> notNull = {1, 0, 0, 1, 1, 0, 1};
+    std::vector<long> scratch;
+    std::vector<long> data(notNull.size(), -1);
+    readNonNulls(data.data(), data.size(), notNull.data(), scratch,
+                 [](long* values, unsigned long count) {
+                   for (unsigned long i = 0; i < count; ++i) {
+                     values[i] = static_cast<long>(i) * 10;
+                   }
+                 });
+    std::vector<long> expected = {0, -1, -1, 10, 20, -1, 30};
+    EXPECT_EQ(expected, data);
+  }
+
+  template <typename T>
+  void benchmarkExpand(const char* name, double nullFraction) {
+    const unsigned long count = 1024;
+    const int batches = 20000;
+    std::mt19937 random(31);
+    std::vector<char> notNull = makeNotNull(count, nullFraction, random);
+    std::vector<T> values(count, 1);
+    std::vector<T> output(count);
+    for (int level = BitUnpackLevel_SCALAR; level <= getBitUnpackLevel();
+         ++level) {
+      auto start = std::chrono::steady_clock::now();
+      for (int batch = 0; batch < batches; ++batch) {
+        expandNonNulls(values.data(), notNull.data(), count, output.data(),
+                       static_cast<BitUnpackLevel>(level));
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << name << " "
+                << getBitUnpackLevelName(static_cast<BitUnpackLevel>(level))
+                << ": "
+                << static_cast<double>(count) * batches / 1e6 /
+                     elapsed.count()
+                << " M values/s\n";
+    }
+  }
+
+  TEST(NullExpand, DISABLED_benchmark) {
+    benchmarkExpand<long>("64 bit, 10% nulls", 0.1);
+    benchmarkExpand<long>("64 bit, 50% nulls", 0.5);
+    benchmarkExpand<char>("8 bit, 10% nulls", 0.1);
+    benchmarkExpand<char>("8 bit, 50% nulls", 0.5);
+  }
+}
@@ -17,17 +17,504 @@
  */
 
 #include "orc/OrcFile.hh"
+#include "Exceptions.hh"
 #include "TestDriver.hh"
 
 #include "wrap/gmock.h"
 #include "wrap/gtest-wrapper.h"
+#include "wrap/orc-proto-wrapper.hh"
 
+#include <cstdio>
+#include <fstream>
 #include <sstream>
+#include <string.h>
 
 namespace {
 
 using ::testing::IsEmpty;
 
+/**
+ * An InputStream over a string that counts the reads.
+ */
+class StringInputStream: public orc::InputStream {
+private:
+  std::string name;
+  std::string contents;
+public:
+  unsigned long reads;
+  long modificationTime;
+  // the advice given to the stream as kind:offset:length
+  std::vector<std::string> advice;
+
+  StringInputStream(const std::string& _contents,
+                    const std::string& _name = "string"
+                    ): name(_name), contents(_contents), reads(0),
+                       modificationTime(0) {}
+  ~StringInputStream();
+
+  long getLength() const override {
+    return static_cast<long>(contents.size());
+  }
+
+  void read(void* buffer, unsigned long offset,
+            unsigned long length) override {
+    reads += 1;
+    memcpy(buffer, contents.data() + offset, length);
+  }
+
+  const std::string& getName() const override {
+    return name;
+  }
+
+  long getModificationTime() const override {
+    return modificationTime;
+  }
+
+  void advise(unsigned long offset, unsigned long length,
+              orc::ReadAdvice kind) override {
+    std::ostringstream text;
+    text << kind << ":" << offset << ":" << length;
+    advice.push_back(text.str());
+  }
+};
+
+StringInputStream::~StringInputStream() {
+  // PASS
+}
+
+/**
+ * Build an uncompressed file that only has a tail with the given number
+ * of empty stripes.
+ */
+std::string buildTailOnlyFile(int stripes) {
+  orc::proto::Footer footer;
+  footer.set_headerlength(3);
+  footer.set_contentlength(3);
+  footer.set_numberofrows(0);
+  orc::proto::Type* root = footer.add_types();
+  root->set_kind(orc::proto::Type_Kind_STRUCT);
+  root->add_subtypes(1);
+  root->add_fieldnames("x");
+  footer.add_types()->set_kind(orc::proto::Type_Kind_INT);
+  orc::proto::UserMetadataItem* item = footer.add_metadata();
+  item->set_name("author");
+  item->set_value("me");
+  orc::proto::Metadata metadata;
+  for(int i=0; i < stripes; ++i) {
+    orc::proto::StripeInformation* stripe = footer.add_stripes();
+    stripe->set_offset(3);
+    stripe->set_indexlength(0);
+    stripe->set_datalength(0);
+    stripe->set_footerlength(0);
+    stripe->set_numberofrows(0);
+    metadata.add_stripestats()->add_colstats()->set_numberofvalues(0);
+  }
+  std::string footerBytes = footer.SerializeAsString();
+  std::string metadataBytes = metadata.SerializeAsString();
+  orc::proto::PostScript postscript;
+  postscript.set_footerlength(footerBytes.size());
+  postscript.set_compression(orc::proto::NONE);
+  postscript.set_metadatalength(metadataBytes.size());
+  postscript.add_version(0);
+  postscript.add_version(12);
+  postscript.set_magic("ORC");
+  std::string postscriptBytes = postscript.SerializeAsString();
+  return "ORC" + metadataBytes + footerBytes + postscriptBytes +
+    static_cast<char>(postscriptBytes.size());
+}
+
+TEST(Reader, smallTail) {
+  StringInputStream* input = new StringInputStream(buildTailOnlyFile(10));
+  std::unique_ptr<orc::Reader> reader =
+    orc::createReader(std::unique_ptr<orc::InputStream>(input),
+                      orc::ReaderOptions());
+  EXPECT_EQ(1, input->reads);
+  EXPECT_EQ(10, reader->getNumberOfStripes());
+  EXPECT_EQ("me", reader->getMetadataValue("author"));
+}
+
+TEST(Reader, largeTail) {
+  std::string contents = buildTailOnlyFile(5000);
+  ASSERT_LT(16 * 1024, contents.size());
+
+  // the speculative read misses, so it takes exactly one more
+  StringInputStream* input = new StringInputStream(contents);
+  std::unique_ptr<orc::Reader> reader =
+    orc::createReader(std::unique_ptr<orc::InputStream>(input),
+                      orc::ReaderOptions());
+  EXPECT_EQ(2, input->reads);
+  EXPECT_EQ(5000, reader->getNumberOfStripes());
+  EXPECT_EQ("me", reader->getMetadataValue("author"));
+  EXPECT_EQ(1, reader->getType().getSubtypeCount());
+
+  // a big enough guess reads it all at once
+  input = new StringInputStream(contents);
+  orc::ReaderOptions opts;
+  opts.setTailReadSize(1024 * 1024);
+  reader = orc::createReader(std::unique_ptr<orc::InputStream>(input), opts);
+  EXPECT_EQ(1, input->reads);
+  EXPECT_EQ(5000, reader->getNumberOfStripes());
+
+  // tiny guesses still read the whole postscript
+  input = new StringInputStream(contents);
+  opts.setTailReadSize(1);
+  reader = orc::createReader(std::unique_ptr<orc::InputStream>(input), opts);
+  EXPECT_EQ(2, input->reads);
+  EXPECT_EQ(5000, reader->getNumberOfStripes());
+}
+
+std::unique_ptr<orc::Reader> openString(const std::string& contents,
+                                        const std::string& name,
+                                        long modificationTime,
+                                        const orc::ReaderOptions& opts,
+                                        unsigned long& reads) {
+  StringInputStream* input = new StringInputStream(contents, name);
+  input->modificationTime = modificationTime;
+  std::unique_ptr<orc::Reader> result =
+    orc::createReader(std::unique_ptr<orc::InputStream>(input), opts);
+  reads = input->reads;
+  return result;
+}
+
+TEST(Reader, fileTailCache) {
+  std::string contents = buildTailOnlyFile(100);
+  std::shared_ptr<orc::FileTailCache> cache =
+    std::make_shared<orc::FileTailCache>(2);
+  EXPECT_EQ(2, cache->getCapacity());
+  orc::ReaderOptions opts;
+  opts.setFileTailCache(cache);
+  unsigned long reads;
+
+  std::unique_ptr<orc::Reader> first =
+    openString(contents, "a", 1000, opts, reads);
+  EXPECT_EQ(1, reads);
+  EXPECT_EQ(1, cache->size());
+  EXPECT_EQ(0, cache->getHits());
+  EXPECT_EQ(1, cache->getMisses());
+
+  // the same file opens without reading the tail
+  std::unique_ptr<orc::Reader> second =
+    openString(contents, "a", 1000, opts, reads);
+  EXPECT_EQ(0, reads);
+  EXPECT_EQ(1, cache->getHits());
+  EXPECT_EQ(100, second->getNumberOfStripes());
+  EXPECT_EQ("me", second->getMetadataValue("author"));
+  EXPECT_EQ(&first->getType(), &second->getType());
+
+  // a modified file is read again
+  second = openString(contents, "a", 2000, opts, reads);
+  EXPECT_EQ(1, reads);
+  EXPECT_EQ(2, cache->size());
+
+  // the least recently used file is dropped
+  second = openString(contents, "b", 1000, opts, reads);
+  EXPECT_EQ(1, reads);
+  EXPECT_EQ(2, cache->size());
+  second = openString(contents, "a", 2000, opts, reads);
+  EXPECT_EQ(0, reads);
+  second = openString(contents, "a", 1000, opts, reads);
+  EXPECT_EQ(1, reads);
+
+  // streams without a modification time aren't cached
+  second = openString(contents, "c", 0, opts, reads);
+  EXPECT_EQ(1, reads);
+  second = openString(contents, "c", 0, opts, reads);
+  EXPECT_EQ(1, reads);
+
+  cache->clear();
+  EXPECT_EQ(0, cache->size());
+  EXPECT_EQ(100, first->getNumberOfStripes());
+}
+
+/**
+ * Wrap bytes in a compression chunk that holds them uncompressed.
+ */
+std::string addOriginalHeader(const std::string& bytes) {
+  unsigned long header = (bytes.size() << 1) | 1;
+  std::string result;
+  result += static_cast<char>(header & 0xff);
+  result += static_cast<char>((header >> 8) & 0xff);
+  result += static_cast<char>((header >> 16) & 0xff);
+  return result + bytes;
+}
+
+/**
+ * Build a file with one stripe of struct<x:int> that holds
+ * 0, 1, null, 2, 3.
+ * @param stripeOffset the stripe offset to record in the footer
+ * @param extraDataLength bytes to add to the recorded stripe data length
+ * @param extraStreamLength bytes to add to the recorded DATA stream length
+ * @param compressed whether to mark the file as zlib compressed, which
+ *    stores every section as an uncompressed chunk
+ */
+std::string buildIntFile(unsigned long stripeOffset = 3,
+                         unsigned long extraDataLength = 0,
+                         unsigned long extraStreamLength = 0,
+                         bool compressed = false) {
+  // PRESENT is a single literal byte, DATA is a run of 4 starting at 0
+  std::string present("\xff\xd8", 2);
+  std::string data("\x01\x01\x00", 3);
+  if (compressed) {
+    present = addOriginalHeader(present);
+    data = addOriginalHeader(data);
+  }
+  orc::proto::StripeFooter stripeFooter;
+  orc::proto::Stream* stream = stripeFooter.add_streams();
+  stream->set_column(1);
+  stream->set_kind(orc::proto::Stream_Kind_PRESENT);
+  stream->set_length(present.size());
+  stream = stripeFooter.add_streams();
+  stream->set_column(1);
+  stream->set_kind(orc::proto::Stream_Kind_DATA);
+  stream->set_length(data.size() + extraStreamLength);
+  for(int i=0; i < 2; ++i) {
+    stripeFooter.add_columns()->set_kind(orc::proto::ColumnEncoding_Kind_DIRECT);
+  }
+  std::string stripeFooterBytes = stripeFooter.SerializeAsString();
+  if (compressed) {
+    stripeFooterBytes = addOriginalHeader(stripeFooterBytes);
+  }
+
+  orc::proto::Footer footer;
+  footer.set_headerlength(3);
+  footer.set_contentlength(3 + present.size() + data.size() +
+                           stripeFooterBytes.size());
+  footer.set_numberofrows(5);
+  orc::proto::Type* root = footer.add_types();
+  root->set_kind(orc::proto::Type_Kind_STRUCT);
+  root->add_subtypes(1);
+  root->add_fieldnames("x");
+  footer.add_types()->set_kind(orc::proto::Type_Kind_INT);
+  orc::proto::StripeInformation* stripe = footer.add_stripes();
+  stripe->set_offset(stripeOffset);
+  stripe->set_indexlength(0);
+  stripe->set_datalength(present.size() + data.size() + extraDataLength);
+  stripe->set_footerlength(stripeFooterBytes.size());
+  stripe->set_numberofrows(5);
+  std::string footerBytes = footer.SerializeAsString();
+  if (compressed) {
+    footerBytes = addOriginalHeader(footerBytes);
+  }
+  orc::proto::PostScript postscript;
+  postscript.set_footerlength(footerBytes.size());
+  postscript.set_compression(compressed ? orc::proto::ZLIB :
+                             orc::proto::NONE);
+  postscript.set_metadatalength(0);
+  postscript.add_version(0);
+  postscript.add_version(12);
+  postscript.set_magic("ORC");
+  std::string postscriptBytes = postscript.SerializeAsString();
+  return "ORC" + present + data + stripeFooterBytes + footerBytes +
+    postscriptBytes + static_cast<char>(postscriptBytes.size());
+}
+
+TEST(Reader, metrics) {
+  StringInputStream* input = new StringInputStream(buildIntFile());
+  std::unique_ptr<orc::Reader> reader =
+    orc::createReader(std::unique_ptr<orc::InputStream>(input),
+                      orc::ReaderOptions());
+  orc::ReaderMetrics metrics = reader->getMetrics();
+  EXPECT_EQ(1, metrics.readCalls);
+  EXPECT_EQ(input->getLength(), metrics.readBytes);
+  ASSERT_EQ(2, metrics.columns.size());
+  EXPECT_EQ(0, metrics.columns[1].rows);
+
+  std::unique_ptr<orc::ColumnVectorBatch> batch = reader->createRowBatch(10);
+  batch->notNullBits.get()[0] = 0;
+  memset(batch->notNull.get(), 0, 10);
+  ASSERT_TRUE(reader->next(*batch));
+  EXPECT_EQ(5, batch->numElements);
+  // the root has no PRESENT stream, so all of its rows are marked present
+  EXPECT_FALSE(batch->hasNulls);
+  EXPECT_EQ(0, batch->nullCount);
+  EXPECT_EQ(0xf8, batch->notNullBits.get()[0] & 0xf8);
+  for(unsigned long i=0; i < 5; ++i) {
+    EXPECT_TRUE(batch->notNull.get()[i]) << "row " << i;
+  }
+  orc::LongVectorBatch* longs = dynamic_cast<orc::LongVectorBatch*>
+    (dynamic_cast<orc::StructVectorBatch&>(*batch).fields.get()[0].get());
+  ASSERT_TRUE(longs->hasNulls);
+  EXPECT_FALSE(longs->notNull.get()[2]);
+  EXPECT_EQ(1, longs->nullCount);
+  // 11011 packed with the first row in the top bit
+  EXPECT_EQ(0xd8, longs->notNullBits.get()[0]);
+  EXPECT_EQ(0, longs->data.get()[0]);
+  EXPECT_EQ(1, longs->data.get()[1]);
+  EXPECT_EQ(2, longs->data.get()[3]);
+  EXPECT_EQ(3, longs->data.get()[4]);
+  EXPECT_FALSE(reader->next(*batch));
+
+  metrics = reader->getMetrics();
+  EXPECT_EQ(input->reads, metrics.readCalls);
+  EXPECT_LT(1, metrics.readCalls);
+  EXPECT_EQ(5, metrics.columns[0].rows);
+  EXPECT_EQ(0, metrics.columns[0].nulls);
+  EXPECT_EQ(5, metrics.columns[1].rows);
+  EXPECT_EQ(1, metrics.columns[1].nulls);
+  EXPECT_LE(metrics.columns[1].decodeNanos, metrics.columns[0].decodeNanos);
+  EXPECT_EQ(0, metrics.decompressionNanos);
+}
+
+TEST(Reader, memoryFile) {
+  std::string contents = buildIntFile();
+  std::unique_ptr<orc::Reader> reader =
+    orc::createReader(orc::readMemory(contents.data(), contents.size(),
+                                      "payload"),
+                      orc::ReaderOptions());
+  EXPECT_EQ("payload", reader->getStreamName());
+  std::unique_ptr<orc::ColumnVectorBatch> batch = reader->createRowBatch(10);
+  ASSERT_TRUE(reader->next(*batch));
+  EXPECT_EQ(5, batch->numElements);
+  orc::LongVectorBatch* longs = dynamic_cast<orc::LongVectorBatch*>
+    (dynamic_cast<orc::StructVectorBatch&>(*batch).fields.get()[0].get());
+  EXPECT_FALSE(longs->notNull.get()[2]);
+  EXPECT_EQ(3, longs->data.get()[4]);
+
+  // only the tail is copied, the stripe is used in place
+  EXPECT_EQ(1, reader->getMetrics().readCalls);
+}
+
+/**
+ * Build a file that is only a postscript with the given section lengths.
+ */
+std::string buildTailOnly(unsigned long footerLength,
+                          unsigned long metadataLength) {
+  orc::proto::PostScript postscript;
+  postscript.set_footerlength(footerLength);
+  postscript.set_compression(orc::proto::NONE);
+  postscript.set_metadatalength(metadataLength);
+  postscript.set_magic("ORC");
+  std::string postscriptBytes = postscript.SerializeAsString();
+  return "ORC" + postscriptBytes +
+    static_cast<char>(postscriptBytes.size());
+}
+
+TEST(Reader, badTail) {
+  const std::string empty;
+  EXPECT_THROW(orc::createReader(orc::readMemory(empty.data(), 0, "empty"),
+                                 orc::ReaderOptions()),
+               orc::ParseError);
+
+  // the postscript length is more than the bytes before it
+  const std::string shortFile("ORC\x7f", 4);
+  EXPECT_THROW(orc::createReader(orc::readMemory(shortFile.data(),
+                                                 shortFile.size(), "short"),
+                                 orc::ReaderOptions()),
+               orc::ParseError);
+
+  // lengths that only fit in the file once their sum wraps around
+  std::string contents = buildTailOnly(~0UL - 19, 10);
+  try {
+    orc::createReader(orc::readMemory(contents.data(), contents.size(),
+                                      "wrap"),
+                      orc::ReaderOptions());
+    ADD_FAILURE() << "expected a ParseError";
+  } catch (orc::ParseError& err) {
+    EXPECT_EQ("file tail is larger than the file", std::string(err.what()));
+  }
+  contents = buildTailOnly(1000, 0);
+  EXPECT_THROW(orc::createReader(orc::readMemory(contents.data(),
+                                                 contents.size(), "long"),
+                                 orc::ReaderOptions()),
+               orc::ParseError);
+}
+
+TEST(Reader, memoryStripePastEnd) {
+  // a stripe that starts past the end of the buffer
+  std::string contents = buildIntFile(1000000);
+  EXPECT_THROW({
+      std::unique_ptr<orc::Reader> reader =
+        orc::createReader(orc::readMemory(contents.data(), contents.size(),
+                                          "payload"),
+                          orc::ReaderOptions());
+      std::unique_ptr<orc::ColumnVectorBatch> batch =
+        reader->createRowBatch(10);
+      reader->next(*batch);
+    }, orc::ParseError);
+
+  // a stripe whose data runs past the end of the buffer
+  contents = buildIntFile(3, 1000000);
+  EXPECT_THROW({
+      std::unique_ptr<orc::Reader> reader =
+        orc::createReader(orc::readMemory(contents.data(), contents.size(),
+                                          "payload"),
+                          orc::ReaderOptions());
+      std::unique_ptr<orc::ColumnVectorBatch> batch =
+        reader->createRowBatch(10);
+      reader->next(*batch);
+    }, orc::ParseError);
+}
+
+TEST(Reader, compressedStreamPastEnd) {
+  orc::ReaderOptions opts;
+  opts.setDecompressionThreads(2);
+  std::string contents = buildIntFile(3, 0, 0, true);
+  std::unique_ptr<orc::Reader> reader =
+    orc::createReader(orc::readMemory(contents.data(), contents.size(),
+                                      "payload"), opts);
+  EXPECT_EQ(orc::CompressionKind_ZLIB, reader->getCompression());
+  std::unique_ptr<orc::ColumnVectorBatch> batch = reader->createRowBatch(10);
+  ASSERT_TRUE(reader->next(*batch));
+  EXPECT_EQ(5, batch->numElements);
+
+  // the stream runs past the end of the buffer, but the stripe doesn't
+  contents = buildIntFile(3, 0, 1000000, true);
+  reader = orc::createReader(orc::readMemory(contents.data(),
+                                             contents.size(), "payload"),
+                             opts);
+  batch = reader->createRowBatch(10);
+  EXPECT_THROW(reader->next(*batch), orc::ParseError);
+}
+
+TEST(Reader, mappedStripePastEnd) {
+  const std::string filename = "stripe-past-end.orc";
+  {
+    std::ofstream file(filename, std::ios::binary);
+    file << buildIntFile(1000000);
+  }
+  EXPECT_THROW({
+      std::unique_ptr<orc::Reader> reader =
+        orc::createReader(orc::readLocalFileMapped(filename),
+                          orc::ReaderOptions());
+      std::unique_ptr<orc::ColumnVectorBatch> batch =
+        reader->createRowBatch(10);
+      reader->next(*batch);
+    }, orc::ParseError);
+  std::remove(filename.c_str());
+}
+
+TEST(Reader, readAdvice) {
+  std::string contents = buildIntFile();
+  StringInputStream* input = new StringInputStream(contents);
+  orc::ReaderOptions opts;
+  opts.setDropConsumedStripes(true);
+  std::unique_ptr<orc::Reader> reader =
+    orc::createReader(std::unique_ptr<orc::InputStream>(input), opts);
+  std::ostringstream whole;
+  whole << orc::ReadAdvice_SEQUENTIAL << ":0:" << contents.size();
+  ASSERT_EQ(1, input->advice.size());
+  EXPECT_EQ(whole.str(), input->advice[0]);
+
+  // the selected streams are requested before they are read and the
+  // stripe is dropped once its rows are returned
+  std::unique_ptr<orc::ColumnVectorBatch> batch = reader->createRowBatch(3);
+  ASSERT_TRUE(reader->next(*batch));
+  ASSERT_EQ(2, input->advice.size());
+  EXPECT_EQ("0:3:5", input->advice[1]);
+  ASSERT_TRUE(reader->next(*batch));
+  ASSERT_EQ(3, input->advice.size());
+  std::ostringstream drop;
+  drop << orc::ReadAdvice_DONT_NEED << ":3:";
+  EXPECT_EQ(drop.str(), input->advice[2].substr(0, drop.str().size()));
+
+  // a projection turns off read ahead
+  input = new StringInputStream(contents);
+  opts.include(std::list<int>());
+  reader = orc::createReader(std::unique_ptr<orc::InputStream>(input), opts);
+  ASSERT_EQ(1, input->advice.size());
+  EXPECT_EQ(orc::ReadAdvice_RANDOM, input->advice[0][0] - '0');
+}
+
 TEST(Reader, simpleTest) {
   orc::ReaderOptions opts;
   std::ostringstream filename;
@@ -93,4 +580,168 @@ TEST(Reader, simpleTest) {
   EXPECT_EQ(1920000, reader->getRowNumber());
 }
 
+/**
+ * Read all of the rows of a demo-11 file and check the id column.
+ */
+void checkDemo11Rows(orc::Reader& reader) {
+  unsigned long rowCount = 0;
+  std::unique_ptr<orc::ColumnVectorBatch> batch = reader.createRowBatch(1024);
+  orc::LongVectorBatch* longVector =
+    dynamic_cast<orc::LongVectorBatch*>
+    (dynamic_cast<orc::StructVectorBatch&>(*batch).fields[0].get());
+  long* idCol = longVector->data.get();
+  while (reader.next(*batch)) {
+    ASSERT_EQ(rowCount, reader.getRowNumber());
+    for(unsigned int i=0; i < batch->numElements; ++i) {
+      ASSERT_EQ(rowCount + i + 1, idCol[i]) << "Bad id for " << i;
+    }
+    rowCount += batch->numElements;
+  }
+  EXPECT_EQ(1920800, rowCount);
+  EXPECT_EQ(1920000, reader.getRowNumber());
+}
+
+TEST(Reader, zlibTest) {
+  orc::ReaderOptions opts;
+  std::ostringstream filename;
+  filename << exampleDirectory << "/demo-11-zlib.orc";
+  std::unique_ptr<orc::Reader> reader =
+    orc::createReader(orc::readLocalFile(filename.str()), opts);
+
+  EXPECT_EQ(orc::CompressionKind_ZLIB, reader->getCompression());
+  EXPECT_EQ(256 * 1024, reader->getCompressionSize());
+  EXPECT_EQ(385, reader->getNumberOfStripes());
+  EXPECT_EQ(1920800, reader->getNumberOfRows());
+  EXPECT_EQ(10000, reader->getRowIndexStride());
+  EXPECT_EQ(396823, reader->getContentLength());
+  const orc::Type& rootType = reader->getType();
+  ASSERT_EQ(9, rootType.getSubtypeCount());
+  EXPECT_EQ(orc::STRING, rootType.getSubtype(1).getKind());
+
+  checkDemo11Rows(*reader);
+  orc::ReaderMetrics metrics = reader->getMetrics();
+  EXPECT_LT(0, metrics.decompressionNanos);
+  EXPECT_LT(metrics.readBytes, metrics.decompressedBytes);
+  EXPECT_EQ(1920800, metrics.columns[1].rows);
+  EXPECT_EQ(0, metrics.columns[1].nulls);
+}
+
+TEST(Reader, zlibMappedPrefetch) {
+  orc::ReaderOptions opts;
+  opts.setPrefetch(true);
+  std::ostringstream filename;
+  filename << exampleDirectory << "/demo-11-zlib.orc";
+  std::unique_ptr<orc::Reader> reader =
+    orc::createReader(orc::readLocalFileMapped(filename.str()), opts);
+  checkDemo11Rows(*reader);
+  reader = orc::createReader(orc::readLocalFile(filename.str()), opts);
+  checkDemo11Rows(*reader);
+}
+
+TEST(Reader, zlibProjection) {
+  orc::ReaderOptions opts;
+  opts.include({1});
+  std::ostringstream filename;
+  filename << exampleDirectory << "/demo-11-zlib.orc";
+  std::unique_ptr<orc::Reader> reader =
+    orc::createReader(orc::readLocalFile(filename.str()), opts);
+  const bool* const selected = reader->getSelectedColumns();
+  EXPECT_TRUE(selected[1]);
+  EXPECT_FALSE(selected[2]);
+  checkDemo11Rows(*reader);
+  EXPECT_EQ(0, reader->getMetrics().columns[2].rows);
+}
+
+/**
+ * Read two readers in lock step and check that they return the same rows.
+ */
+void compareReaders(orc::Reader& expected, orc::Reader& actual) {
+  std::unique_ptr<orc::ColumnVectorBatch> expectedBatch =
+    expected.createRowBatch(1000);
+  std::unique_ptr<orc::ColumnVectorBatch> actualBatch =
+    actual.createRowBatch(1000);
+  orc::StructVectorBatch& expectedStruct =
+    dynamic_cast<orc::StructVectorBatch&>(*expectedBatch);
+  orc::StructVectorBatch& actualStruct =
+    dynamic_cast<orc::StructVectorBatch&>(*actualBatch);
+  unsigned long rowCount = 0;
+  while (expected.next(*expectedBatch)) {
+    ASSERT_TRUE(actual.next(*actualBatch));
+    ASSERT_EQ(expectedBatch->numElements, actualBatch->numElements);
+    for(unsigned long field=0; field < expectedStruct.numFields; ++field) {
+      orc::ColumnVectorBatch* left = expectedStruct.fields[field].get();
+      orc::ColumnVectorBatch* right = actualStruct.fields[field].get();
+      orc::LongVectorBatch* longs = dynamic_cast<orc::LongVectorBatch*>(left);
+      orc::StringVectorBatch* strings =
+        dynamic_cast<orc::StringVectorBatch*>(left);
+      for(unsigned long i=0; i < left->numElements; ++i) {
+        if (longs) {
+          ASSERT_EQ(longs->data[i],
+                    dynamic_cast<orc::LongVectorBatch*>(right)->data[i])
+            << "row " << rowCount + i << " field " << field;
+        } else if (strings) {
+          orc::StringVectorBatch* other =
+            dynamic_cast<orc::StringVectorBatch*>(right);
+          ASSERT_EQ(std::string(strings->data[i],
+                                static_cast<size_t>(strings->length[i])),
+                    std::string(other->data[i],
+                                static_cast<size_t>(other->length[i])))
+            << "row " << rowCount + i << " field " << field;
+        }
+      }
+    }
+    rowCount += expectedBatch->numElements;
+  }
+  EXPECT_FALSE(actual.next(*actualBatch));
+  EXPECT_EQ(1920800, rowCount);
+}
+
+TEST(Reader, zlibParallelDecompression) {
+  std::ostringstream filename;
+  filename << exampleDirectory << "/demo-11-zlib.orc";
+  orc::ReaderOptions opts;
+  opts.setDecompressionThreads(4);
+  EXPECT_EQ(4, opts.getDecompressionThreads());
+  EXPECT_EQ(0, orc::ReaderOptions().getDecompressionThreads());
+  std::unique_ptr<orc::Reader> reader =
+    orc::createReader(orc::readLocalFile(filename.str()), opts);
+  std::unique_ptr<orc::Reader> serial =
+    orc::createReader(orc::readLocalFile(filename.str()),
+                      orc::ReaderOptions());
+  compareReaders(*serial, *reader);
+  orc::ReaderMetrics metrics = reader->getMetrics();
+  EXPECT_LT(0, metrics.decompressionNanos);
+  EXPECT_LT(metrics.readBytes, metrics.decompressedBytes);
+
+  // decompress in the background while prefetching from a mapped file
+  opts.setPrefetch(true);
+  reader = orc::createReader(orc::readLocalFileMapped(filename.str()), opts);
+  checkDemo11Rows(*reader);
+
+  // a projection only decompresses the selected columns
+  opts.include({1});
+  reader = orc::createReader(orc::readLocalFile(filename.str()), opts);
+  checkDemo11Rows(*reader);
+}
+
+TEST(Reader, zlibRleV2) {
+  std::ostringstream filename;
+  filename << exampleDirectory << "/demo-12-zlib.orc";
+  std::unique_ptr<orc::Reader> reader =
+    orc::createReader(orc::readLocalFile(filename.str()),
+                      orc::ReaderOptions());
+  EXPECT_EQ(1920800, reader->getNumberOfRows());
+  checkDemo11Rows(*reader);
+
+  // the same rows as the RLEv1 encoded file
+  std::ostringstream expectedName;
+  expectedName << exampleDirectory << "/demo-11-zlib.orc";
+  std::unique_ptr<orc::Reader> expected =
+    orc::createReader(orc::readLocalFile(expectedName.str()),
+                      orc::ReaderOptions());
+  reader = orc::createReader(orc::readLocalFile(filename.str()),
+                             orc::ReaderOptions());
+  compareReaders(*expected, *reader);
+}
+
 }  // namespace
@@ -17,11 +17,15 @@
  */
 
 #include "Compression.hh"
+#include "Exceptions.hh"
 #include "RLE.hh"
 #include "RLEs.hh"
 #include "wrap/gtest-wrapper.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <random>
 #include <vector>
 
 namespace orc {
@@ -2128,4 +2132,654 @@ TEST(RLEv1, seekTest) {
   } while (i != 0);
 }
 
+TEST(RLEv2, shortRepeat) {
+  std::unique_ptr<RleDecoder> rle =
+      createRleDecoder(
+          std::unique_ptr<SeekableInputStream>(
+              new SeekableArrayInputStream({0x0a, 0x27, 0x10})),
+          false, RleVersion_2);
+  std::vector<long> data(5);
+  rle->next(data.data(), 5, nullptr);
+  for (size_t i = 0; i < 5; ++i) {
+    EXPECT_EQ(10000, data[i]) << "Output wrong at " << i;
+  }
+}
+
+TEST(RLEv2, direct) {
+  std::unique_ptr<RleDecoder> rle =
+      createRleDecoder(
+          std::unique_ptr<SeekableInputStream>(
+              new SeekableArrayInputStream(
+                  {0x5e, 0x03, 0x5c, 0xa1, 0xab, 0x1e, 0xde, 0xad, 0xbe,
+                   0xef})),
+          false, RleVersion_2);
+  std::vector<long> data(4);
+  rle->next(data.data(), 4, nullptr);
+  EXPECT_EQ(23713, data[0]);
+  EXPECT_EQ(43806, data[1]);
+  EXPECT_EQ(57005, data[2]);
+  EXPECT_EQ(48879, data[3]);
+}
+
+TEST(RLEv2, patchedBase) {
+  std::unique_ptr<RleDecoder> rle =
+      createRleDecoder(
+          std::unique_ptr<SeekableInputStream>(
+              new SeekableArrayInputStream(
+                  {0x8e, 0x13, 0x2b, 0x21, 0x07, 0xd0, 0x1e, 0x00, 0x14,
+                   0x70, 0x28, 0x32, 0x3c, 0x46, 0x50, 0x5a, 0x64, 0x6e,
+                   0x78, 0x82, 0x8c, 0x96, 0xa0, 0xaa, 0xb4, 0xbe, 0xfc,
+                   0xe8})),
+          true, RleVersion_2);
+  std::vector<long> data(20);
+  rle->next(data.data(), 20, nullptr);
+  EXPECT_EQ(2030, data[0]);
+  EXPECT_EQ(2000, data[1]);
+  EXPECT_EQ(2020, data[2]);
+  EXPECT_EQ(1000000, data[3]);
+  for (size_t i = 4; i < 20; ++i) {
+    EXPECT_EQ(2040 + 10 * (i - 4), data[i]) << "Output wrong at " << i;
+  }
+}
+
+TEST(RLEv2, delta) {
+  std::unique_ptr<RleDecoder> rle =
+      createRleDecoder(
+          std::unique_ptr<SeekableInputStream>(
+              new SeekableArrayInputStream(
+                  {0xc6, 0x09, 0x02, 0x02, 0x22, 0x42, 0x42, 0x46})),
+          false, RleVersion_2);
+  std::vector<long> data(10);
+  rle->next(data.data(), 10, nullptr);
+  const long primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29};
+  for (size_t i = 0; i < 10; ++i) {
+    EXPECT_EQ(primes[i], data[i]) << "Output wrong at " << i;
+  }
+}
+
+/**
+ * Get the 5 bit code that the RLEv2 headers use for a bit width.
+ */
+unsigned int encodeBitWidth(unsigned int width) {
+  if (width <= 24) {
+    return width - 1;
+  }
+  switch (width) {
+    case 26: return 24;
+    case 28: return 25;
+    case 30: return 26;
+    case 32: return 27;
+    case 40: return 28;
+    case 48: return 29;
+    case 56: return 30;
+    default: return 31;
+  }
+}
+
+/**
+ * Pack the values most significant bit first, padding the last byte.
+ */
+void appendPacked(std::vector<unsigned char>& out,
+                  const std::vector<unsigned long>& values,
+                  unsigned int width) {
+  unsigned int used = 8;
+  for (unsigned long value: values) {
+    for (unsigned int bit = width; bit-- > 0; ) {
+      if (used == 8) {
+        out.push_back(0);
+        used = 0;
+      }
+      out.back() = static_cast<unsigned char>(
+          out.back() | ((value >> bit) & 1) << (7 - used));
+      ++used;
+    }
+  }
+}
+
+void appendVulong(std::vector<unsigned char>& out, unsigned long value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<unsigned char>(0x80 | (value & 0x7f)));
+    value >>= 7;
+  }
+  out.push_back(static_cast<unsigned char>(value));
+}
+
+unsigned long zigZag(long value) {
+  return (static_cast<unsigned long>(value) << 1) ^
+    static_cast<unsigned long>(value >> 63);
+}
+
+void appendShortRepeat(std::vector<unsigned char>& out,
+                       unsigned long value,
+                       unsigned int count,
+                       unsigned int numBytes) {
+  out.push_back(static_cast<unsigned char>((numBytes - 1) << 3 |
+                                           (count - 3)));
+  for (unsigned int i = numBytes; i-- > 0; ) {
+    out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+  }
+}
+
+void appendDirect(std::vector<unsigned char>& out,
+                  const std::vector<unsigned long>& values,
+                  unsigned int width) {
+  unsigned long length = values.size() - 1;
+  out.push_back(static_cast<unsigned char>(0x40 | encodeBitWidth(width) << 1 |
+                                           length >> 8));
+  out.push_back(static_cast<unsigned char>(length));
+  appendPacked(out, values, width);
+}
+
+/**
+ * Append a delta run. A width of zero writes a fixed delta of deltaBase
+ * and ignores the deltas.
+ */
+void appendDelta(std::vector<unsigned char>& out,
+                 unsigned long first,
+                 long deltaBase,
+                 const std::vector<unsigned long>& deltas,
+                 unsigned int width,
+                 unsigned long length) {
+  out.push_back(static_cast<unsigned char>(
+      0xc0 | (width == 0 ? 0 : encodeBitWidth(width)) << 1 |
+      (length - 1) >> 8));
+  out.push_back(static_cast<unsigned char>(length - 1));
+  appendVulong(out, first);
+  appendVulong(out, zigZag(deltaBase));
+  if (width != 0) {
+    appendPacked(out, deltas, width);
+  }
+}
+
+std::unique_ptr<RleDecoder> createRleV2(const std::vector<unsigned char>& bytes,
+                                        bool isSigned,
+                                        long blockSize = -1) {
+  return createRleDecoder(
+      std::unique_ptr<SeekableInputStream>(
+          new SeekableArrayInputStream(
+              reinterpret_cast<const char*>(bytes.data()), bytes.size(),
+              blockSize)),
+      isSigned, RleVersion_2);
+}
+
+TEST(RLEv2, signedRuns) {
+  std::vector<unsigned char> bytes;
+  appendShortRepeat(bytes, zigZag(-300), 10, 2);
+  appendDirect(bytes, {zigZag(-1), zigZag(1), zigZag(-64), zigZag(63)}, 7);
+  // 100, 95, ..., 5
+  appendDelta(bytes, zigZag(100), -5, {}, 0, 20);
+  // 10, 7, 6, 2, 1
+  appendDelta(bytes, zigZag(10), -3, {1, 4, 1}, 3, 5);
+  std::unique_ptr<RleDecoder> rle = createRleV2(bytes, true);
+  std::vector<long> data(39);
+  rle->next(data.data(), 39, nullptr);
+  for (size_t i = 0; i < 10; ++i) {
+    EXPECT_EQ(-300, data[i]) << "Output wrong at " << i;
+  }
+  EXPECT_EQ(-1, data[10]);
+  EXPECT_EQ(1, data[11]);
+  EXPECT_EQ(-64, data[12]);
+  EXPECT_EQ(63, data[13]);
+  for (size_t i = 0; i < 20; ++i) {
+    EXPECT_EQ(100 - 5 * static_cast<long>(i), data[14 + i])
+        << "Output wrong at " << i;
+  }
+  EXPECT_EQ(10, data[34]);
+  EXPECT_EQ(7, data[35]);
+  EXPECT_EQ(6, data[36]);
+  EXPECT_EQ(2, data[37]);
+  EXPECT_EQ(1, data[38]);
+}
+
+TEST(RLEv2, directAllWidths) {
+  const unsigned int widths[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+                                 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+                                 26, 28, 30, 32, 40, 48, 56, 64};
+  std::mt19937_64 random(42);
+  for (unsigned int width: widths) {
+    for (unsigned long count: {1UL, 7UL, 100UL, 512UL}) {
+      std::vector<unsigned long> values(count);
+      for (unsigned long& value: values) {
+        value = width == 64 ? random() : random() & ((1UL << width) - 1);
+      }
+      std::vector<unsigned char> bytes;
+      appendDirect(bytes, values, width);
+      // small blocks make the packed values span buffers
+      std::unique_ptr<RleDecoder> rle = createRleV2(bytes, false, 13);
+      std::vector<long> data(count);
+      rle->next(data.data(), count, nullptr);
+      for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(values[i], static_cast<unsigned long>(data[i]))
+            << "width " << width << " count " << count << " at " << i;
+      }
+    }
+  }
+}
+
+TEST(RLEv2, patchedBaseLongGap) {
+  // 300 values of 4 bits with a base of -1000 and a single patch at 280,
+  // which needs a gap of 255 with an empty patch before the real gap of 25
+  std::vector<unsigned long> values(300);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = i % 16;
+  }
+  std::vector<unsigned char> bytes;
+  bytes.push_back(static_cast<unsigned char>(0x80 | encodeBitWidth(4) << 1 |
+                                             (values.size() - 1) >> 8));
+  bytes.push_back(static_cast<unsigned char>(values.size() - 1));
+  // 2 byte base, 4 bit patches
+  bytes.push_back(static_cast<unsigned char>(1 << 5 | encodeBitWidth(4)));
+  // 8 bit gaps, 2 patches
+  bytes.push_back(static_cast<unsigned char>(7 << 5 | 2));
+  bytes.push_back(0x83);
+  bytes.push_back(0xe8);
+  appendPacked(bytes, values, 4);
+  appendPacked(bytes, {255UL << 4, 25UL << 4 | 0xa}, 12);
+  appendShortRepeat(bytes, 7, 3, 1);
+  std::unique_ptr<RleDecoder> rle = createRleV2(bytes, false);
+  std::vector<long> data(303);
+  rle->next(data.data(), 303, nullptr);
+  for (size_t i = 0; i < 300; ++i) {
+    long expected = static_cast<long>(i % 16) - 1000;
+    if (i == 280) {
+      expected += 0xa << 4;
+    }
+    EXPECT_EQ(expected, data[i]) << "Output wrong at " << i;
+  }
+  EXPECT_EQ(7, data[300]);
+}
+
+TEST(RLEv2, nullsAndSkip) {
+  std::vector<unsigned char> bytes;
+  std::vector<unsigned long> values;
+  for (unsigned long i = 0; i < 200; ++i) {
+    values.push_back(i * 3);
+  }
+  appendDirect(bytes, values, 10);
+  appendShortRepeat(bytes, 5, 10, 1);
+  appendDelta(bytes, 1000, 1, {}, 0, 300);
+  std::vector<long> expected;
+  for (unsigned long i = 0; i < 200; ++i) {
+    expected.push_back(static_cast<long>(i * 3));
+  }
+  expected.insert(expected.end(), 10, 5);
+  for (long i = 0; i < 300; ++i) {
+    expected.push_back(1000 + i);
+  }
+
+  // every third value is null
+  std::unique_ptr<RleDecoder> rle = createRleV2(bytes, false, 7);
+  std::vector<char> notNull(expected.size() * 3 / 2);
+  for (size_t i = 0; i < notNull.size(); ++i) {
+    notNull[i] = i % 3 != 2;
+  }
+  std::vector<long> data(notNull.size(), -1);
+  rle->next(data.data(), data.size(), notNull.data());
+  size_t value = 0;
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (notNull[i]) {
+      EXPECT_EQ(expected[value++], data[i]) << "Output wrong at " << i;
+    } else {
+      EXPECT_EQ(-1, data[i]) << "Null overwritten at " << i;
+    }
+  }
+  EXPECT_EQ(expected.size(), value);
+
+  // skip across and within runs
+  rle = createRleV2(bytes, false, 7);
+  size_t position = 0;
+  for (unsigned long step: {1UL, 150UL, 55UL, 5UL, 200UL}) {
+    rle->skip(step);
+    position += step;
+    rle->next(data.data(), 1, nullptr);
+    EXPECT_EQ(expected[position], data[0]) << "Output wrong at " << position;
+    ++position;
+  }
+}
+
+TEST(RLEv2, seek) {
+  std::vector<unsigned char> bytes;
+  std::vector<unsigned long> values;
+  for (unsigned long i = 0; i < 100; ++i) {
+    values.push_back(i);
+  }
+  appendDirect(bytes, values, 7);
+  const unsigned long secondRun = bytes.size();
+  appendDelta(bytes, 500, -2, {}, 0, 100);
+  std::unique_ptr<RleDecoder> rle = createRleV2(bytes, true, 11);
+  std::vector<long> data(200);
+  rle->next(data.data(), 150, nullptr);
+  for (unsigned long i = 0; i < 100; ++i) {
+    // the direct run is read as signed values
+    EXPECT_EQ(static_cast<long>(i >> 1 ^ -(i & 1)), data[i]);
+  }
+  for (unsigned long i = 100; i < 200; ++i) {
+    std::list<unsigned long> positions;
+    positions.push_back(secondRun);
+    positions.push_back(i - 100);
+    PositionProvider location(positions);
+    rle->seek(location);
+    rle->next(data.data(), 1, nullptr);
+    EXPECT_EQ(250 - 2 * static_cast<long>(i - 100), data[0])
+        << "Output wrong at " << i;
+  }
+  std::list<unsigned long> positions;
+  positions.push_back(0);
+  positions.push_back(99);
+  PositionProvider location(positions);
+  rle->seek(location);
+  rle->next(data.data(), 2, nullptr);
+  EXPECT_EQ(-50, data[0]);
+  EXPECT_EQ(250, data[1]);
+}
+
+TEST(RLEv2, badData) {
+  std::unique_ptr<RleDecoder> rle =
+      createRleDecoder(
+          std::unique_ptr<SeekableInputStream>(
+              new SeekableArrayInputStream({0x5e, 0x03, 0x5c, 0xa1})),
+          false, RleVersion_2);
+  std::vector<long> data(4);
+  EXPECT_THROW(rle->next(data.data(), 4, nullptr), ParseError);
+}
+
+/**
+ * Decode the stream repeatedly and print the rate in millions of values
+ * per second.
+ */
+void benchmarkRleV2(const char* name,
+                    const std::vector<unsigned char>& bytes,
+                    unsigned long numValues) {
+  std::vector<long> data(1024);
+  double best = 0;
+  for (int trial = 0; trial < 3; ++trial) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<RleDecoder> rle = createRleV2(bytes, true, 256 * 1024);
+    long checksum = 0;
+    for (unsigned long done = 0; done < numValues; done += data.size()) {
+      unsigned long count = std::min(numValues - done,
+                                     static_cast<unsigned long>(data.size()));
+      rle->next(data.data(), count, nullptr);
+      checksum += data[count - 1];
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    EXPECT_NE(0, checksum);
+    best = std::max(best, static_cast<double>(numValues) / 1e6 /
+                            elapsed.count());
+  }
+  std::cout << name << ": " << bytes.size() << " bytes, " << best
+            << " M values/s\n";
+}
+
+TEST(RLEv2, DISABLED_benchmark) {
+  const unsigned long numRuns = 40000;
+  std::mt19937_64 random(7);
+  std::vector<unsigned char> shortRepeat;
+  for (unsigned long i = 0; i < numRuns * 50; ++i) {
+    appendShortRepeat(shortRepeat, zigZag(static_cast<long>(i)), 10, 3);
+  }
+  benchmarkRleV2("short repeat", shortRepeat, numRuns * 500);
+  for (unsigned int width: {4U, 13U, 32U, 64U}) {
+    std::vector<unsigned char> direct;
+    std::vector<unsigned long> values(512);
+    for (unsigned long i = 0; i < numRuns; ++i) {
+      for (unsigned long& value: values) {
+        value = width == 64 ? random() : random() & ((1UL << width) - 1);
+      }
+      appendDirect(direct, values, width);
+    }
+    std::string name = "direct " + std::to_string(width);
+    benchmarkRleV2(name.c_str(), direct, numRuns * 512);
+  }
+  std::vector<unsigned char> patched;
+  std::vector<unsigned long> values(512);
+  for (unsigned long i = 0; i < numRuns; ++i) {
+    patched.push_back(0x80 | encodeBitWidth(8) << 1 | 1);
+    patched.push_back(0xff);
+    patched.push_back(1 << 5 | encodeBitWidth(16));
+    patched.push_back(7 << 5 | 4);
+    patched.push_back(0x07);
+    patched.push_back(0xd0);
+    for (unsigned long& value: values) {
+      value = random() & 0xff;
+    }
+    appendPacked(patched, values, 8);
+    appendPacked(patched, {100UL << 16 | 0x1234, 100UL << 16 | 0x4321,
+                           100UL << 16 | 0x5678, 100UL << 16 | 0x8765}, 24);
+  }
+  benchmarkRleV2("patched base", patched, numRuns * 512);
+  std::vector<unsigned char> fixedDelta;
+  std::vector<unsigned char> delta;
+  for (unsigned long i = 0; i < numRuns; ++i) {
+    appendDelta(fixedDelta, zigZag(static_cast<long>(i)), 3, {}, 0, 512);
+    for (unsigned long& value: values) {
+      value = random() & 0x3f;
+    }
+    values.resize(510);
+    appendDelta(delta, zigZag(static_cast<long>(i)), 1, values, 6, 512);
+    values.resize(512);
+  }
+  benchmarkRleV2("fixed delta", fixedDelta, numRuns * 512);
+  benchmarkRleV2("delta", delta, numRuns * 512);
+}
+
+/**
+ * Append values as RLEv1 literal runs.
+ */
+void appendRleV1Literals(std::vector<unsigned char>& out,
+                         const std::vector<long>& values,
+                         bool isSigned) {
+  for (size_t start = 0; start < values.size(); start += 128) {
+    size_t count = std::min(values.size() - start, static_cast<size_t>(128));
+    out.push_back(static_cast<unsigned char>(256 - count));
+    for (size_t i = start; i < start + count; ++i) {
+      appendVulong(out, isSigned
+                   ? zigZag(values[i])
+                   : static_cast<unsigned long>(values[i]));
+    }
+  }
+}
+
+/**
+ * Make values of random magnitudes so that the varints have every length.
+ */
+std::vector<long> makeRleV1Values(unsigned long count, bool isSigned) {
+  std::mt19937_64 random(11);
+  std::vector<long> result(count);
+  for (long& value: result) {
+    unsigned int bits = static_cast<unsigned int>(random() % 65);
+    unsigned long magnitude = bits == 0 ? 0 : random() >> (64 - bits);
+    value = static_cast<long>(magnitude);
+    if (isSigned && bits < 64 && random() % 2) {
+      value = -value;
+    }
+  }
+  return result;
+}
+
+TEST(RLEv1, literalFastPath) {
+  for (bool isSigned: {false, true}) {
+    std::vector<long> values = makeRleV1Values(3000, isSigned);
+    std::vector<unsigned char> bytes;
+    appendRleV1Literals(bytes, values, isSigned);
+    for (long blockSize: {1L, 3L, 10L, 17L, 100L, -1L}) {
+      std::unique_ptr<RleDecoder> rle =
+          createRleDecoder(
+              std::unique_ptr<SeekableInputStream>(
+                  new SeekableArrayInputStream(
+                      reinterpret_cast<const char*>(bytes.data()),
+                      bytes.size(), blockSize)),
+              isSigned, RleVersion_1);
+      std::vector<long> data(values.size());
+      // uneven batches so that they end inside the runs
+      size_t position = 0;
+      for (size_t batch = 1; position < data.size(); batch = batch * 3 + 1) {
+        size_t count = std::min(batch % 500, data.size() - position);
+        rle->next(data.data() + position, count, nullptr);
+        position += count;
+      }
+      for (size_t i = 0; i < values.size(); ++i) {
+        ASSERT_EQ(values[i], data[i])
+            << "block size " << blockSize << " signed " << isSigned
+            << " at " << i;
+      }
+    }
+  }
+}
+
+TEST(RLEv1, literalNullsAndSkip) {
+  std::vector<long> values = makeRleV1Values(1000, true);
+  std::vector<unsigned char> bytes;
+  appendRleV1Literals(bytes, values, true);
+  for (long blockSize: {5L, 64L, -1L}) {
+    std::unique_ptr<RleDecoder> rle =
+        createRleDecoder(
+            std::unique_ptr<SeekableInputStream>(
+                new SeekableArrayInputStream(
+                    reinterpret_cast<const char*>(bytes.data()),
+                    bytes.size(), blockSize)),
+            true, RleVersion_1);
+    // nulls at every fourth and fifth position
+    std::vector<char> notNull(1000);
+    for (size_t i = 0; i < notNull.size(); ++i) {
+      notNull[i] = i % 4 != 3 && i % 5 != 4;
+    }
+    std::vector<long> data(notNull.size(), -1);
+    rle->next(data.data(), 100, notNull.data());
+    rle->next(data.data() + 100, 900, notNull.data() + 100);
+    size_t value = 0;
+    for (size_t i = 0; i < data.size(); ++i) {
+      if (notNull[i]) {
+        ASSERT_EQ(values[value++], data[i]) << "Output wrong at " << i;
+      } else {
+        ASSERT_EQ(-1, data[i]) << "Null overwritten at " << i;
+      }
+    }
+    rle->skip(3);
+    rle->next(data.data(), 1, nullptr);
+    EXPECT_EQ(values[value + 3], data[0]);
+    rle->skip(150);
+    rle->next(data.data(), 1, nullptr);
+    EXPECT_EQ(values[value + 154], data[0]);
+  }
+}
+
+TEST(RLEv1, varintTooLong) {
+  std::vector<unsigned char> bytes = {0xff};
+  bytes.insert(bytes.end(), 11, 0x80);
+  bytes.insert(bytes.end(), 20, 0x01);
+  std::unique_ptr<RleDecoder> rle =
+      createRleDecoder(
+          std::unique_ptr<SeekableInputStream>(
+              new SeekableArrayInputStream(
+                  reinterpret_cast<const char*>(bytes.data()), bytes.size())),
+          false, RleVersion_1);
+  std::vector<long> data(1);
+  EXPECT_THROW(rle->next(data.data(), 1, nullptr), ParseError);
+}
+
+/**
+ * Decode the stream repeatedly and print the rate in millions of values
+ * per second.
+ */
+TEST(RLEv1, repeatSparseNulls) {
+  // 130 values from 1000 by -2, then 10 values from 5 by 1
+  std::unique_ptr<RleDecoder> rle =
+      createRleDecoder(
+          std::unique_ptr<SeekableInputStream>(
+              new SeekableArrayInputStream(
+                  {0x7f, 0xfe, 0xd0, 0x0f, 0x07, 0x01, 0x0a})),
+          true, RleVersion_1);
+  std::vector<char> notNull(158);
+  for (size_t i = 0; i < notNull.size(); ++i) {
+    notNull[i] = i % 9 != 2;
+  }
+  std::vector<long> data(notNull.size(), -1);
+  rle->next(data.data(), 50, notNull.data());
+  rle->next(data.data() + 50, 108, notNull.data() + 50);
+  long value = 0;
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (notNull[i]) {
+      EXPECT_EQ(value < 130 ? 1000 - 2 * value : value - 125, data[i])
+        << "Output wrong at " << i;
+      value += 1;
+    } else {
+      EXPECT_EQ(-1, data[i]) << "Null overwritten at " << i;
+    }
+  }
+  EXPECT_EQ(140, value);
+}
+
+void benchmarkRleV1(const char* name,
+                    const std::vector<unsigned char>& bytes,
+                    unsigned long numValues,
+                    const char* notNull) {
+  std::vector<long> data(1024);
+  double best = 0;
+  for (int trial = 0; trial < 3; ++trial) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<RleDecoder> rle =
+        createRleDecoder(
+            std::unique_ptr<SeekableInputStream>(
+                new SeekableArrayInputStream(
+                    reinterpret_cast<const char*>(bytes.data()),
+                    bytes.size(), 256 * 1024)),
+            true, RleVersion_1);
+    for (unsigned long done = 0; done < numValues; done += data.size()) {
+      unsigned long count = std::min(numValues - done,
+                                     static_cast<unsigned long>(data.size()));
+      rle->next(data.data(), count, notNull);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::max(best, static_cast<double>(numValues) / 1e6 /
+                            elapsed.count());
+  }
+  std::cout << name << ": " << bytes.size() << " bytes, " << best
+            << " M values/s\n";
+}
+
+TEST(RLEv1, DISABLED_benchmark) {
+  const unsigned long numValues = 20 * 1024 * 1024;
+  std::mt19937_64 random(13);
+  std::vector<long> values(numValues);
+  struct {
+    const char* name;
+    unsigned long range;
+  } dataSets[] = {{"1 byte literals", 64},
+                  {"2 byte literals", 8192},
+                  {"4 byte literals", 1UL << 27},
+                  {"8 byte literals", 1UL << 55}};
+  std::vector<char> notNull(1024);
+  for (size_t i = 0; i < notNull.size(); ++i) {
+    notNull[i] = i % 10 != 0;
+  }
+  // the same density of nulls, but in no pattern the branch predictor learns
+  std::vector<char> randomNotNull(notNull);
+  std::shuffle(randomNotNull.begin(), randomNotNull.end(), random);
+  for (auto& dataSet: dataSets) {
+    for (long& value: values) {
+      value = static_cast<long>(random() % dataSet.range) -
+        static_cast<long>(dataSet.range / 2);
+    }
+    std::vector<unsigned char> bytes;
+    appendRleV1Literals(bytes, values, true);
+    benchmarkRleV1(dataSet.name, bytes, numValues, nullptr);
+    std::string name = std::string(dataSet.name) + " with nulls";
+    benchmarkRleV1(name.c_str(), bytes, numValues * 10 / 9, notNull.data());
+    name = std::string(dataSet.name) + " with random nulls";
+    benchmarkRleV1(name.c_str(), bytes, numValues * 10 / 9,
+                   randomNotNull.data());
+  }
+  // runs of 130 values with a small delta
+  std::vector<unsigned char> runs;
+  for (unsigned long i = 0; i < numValues / 130; ++i) {
+    runs.push_back(127);
+    runs.push_back(1);
+    appendVulong(runs, zigZag(static_cast<long>(i)));
+  }
+  benchmarkRleV1("runs", runs, numValues / 130 * 130, nullptr);
+}
+
 }  // namespace orc
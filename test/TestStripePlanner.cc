@@ -0,0 +1,359 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Exceptions.hh"
+#include "StripePlanner.hh"
+#include "wrap/gtest-wrapper.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace orc {
+
+  /**
+   * An InputStream over a fixed pattern that counts the reads.
+   */
+  class CountingInputStream: public InputStream {
+  private:
+    std::string name;
+  public:
+    unsigned long reads;
+    unsigned long bytes;
+    unsigned long alignment;
+    // the reads whose offset or buffer weren't aligned
+    unsigned long unalignedReads;
+
+    CountingInputStream(): name("counting"), reads(0), bytes(0),
+                           alignment(1), unalignedReads(0) {}
+    ~CountingInputStream();
+
+    long getLength() const override {
+      return 1000;
+    }
+
+    void read(void* buffer, unsigned long offset,
+              unsigned long length) override {
+      reads += 1;
+      bytes += length;
+      if (offset % alignment != 0 ||
+          reinterpret_cast<unsigned long>(buffer) % alignment != 0) {
+        unalignedReads += 1;
+      }
+      char* output = static_cast<char*>(buffer);
+      for(unsigned long i=0; i < length; ++i) {
+        output[i] = static_cast<char>(offset + i);
+      }
+    }
+
+    unsigned long getReadAlignment() const override {
+      return alignment;
+    }
+
+    const std::string& getName() const override {
+      return name;
+    }
+  };
+
+  CountingInputStream::~CountingInputStream() {
+    // PASS
+  }
+
+  TEST(StripePlanner, coalesceRanges) {
+    std::vector<ReadRange> ranges;
+    ranges.push_back({100, 10});
+    ranges.push_back({0, 10});
+    ranges.push_back({15, 20});
+    ranges.push_back({30, 10});
+    ranges.push_back({500, 1});
+    std::vector<ReadRange> result = coalesceRanges(ranges, 5);
+    ASSERT_EQ(3, result.size());
+    EXPECT_EQ(0, result[0].offset);
+    EXPECT_EQ(40, result[0].length);
+    EXPECT_EQ(100, result[1].offset);
+    EXPECT_EQ(10, result[1].length);
+    EXPECT_EQ(500, result[2].offset);
+    EXPECT_EQ(1, result[2].length);
+
+    result = coalesceRanges(ranges, 1000);
+    ASSERT_EQ(1, result.size());
+    EXPECT_EQ(0, result[0].offset);
+    EXPECT_EQ(501, result[0].length);
+
+    result = coalesceRanges(ranges, 0);
+    ASSERT_EQ(4, result.size());
+    EXPECT_EQ(0, coalesceRanges(std::vector<ReadRange>(), 10).size());
+
+    // close ranges stop merging at the largest range plus four gaps
+    ranges.clear();
+    for(unsigned long i=0; i < 10; ++i) {
+      ranges.push_back({i * 20, 10});
+    }
+    result = coalesceRanges(ranges, 10);
+    ASSERT_EQ(4, result.size());
+    EXPECT_EQ(0, result[0].offset);
+    EXPECT_EQ(50, result[0].length);
+    EXPECT_EQ(60, result[1].offset);
+    EXPECT_EQ(50, result[1].length);
+    EXPECT_EQ(120, result[2].offset);
+    EXPECT_EQ(50, result[2].length);
+    EXPECT_EQ(180, result[3].offset);
+    EXPECT_EQ(10, result[3].length);
+  }
+
+  TEST(StripePlanner, planStripeReads) {
+    proto::StripeFooter footer;
+    const unsigned int columns[] = {1, 1, 2, 1, 2, 2};
+    const proto::Stream_Kind kinds[] = {proto::Stream_Kind_ROW_INDEX,
+                                        proto::Stream_Kind_PRESENT,
+                                        proto::Stream_Kind_PRESENT,
+                                        proto::Stream_Kind_DATA,
+                                        proto::Stream_Kind_DATA,
+                                        proto::Stream_Kind_LENGTH};
+    for(unsigned int i=0; i < 6; ++i) {
+      proto::Stream* stream = footer.add_streams();
+      stream->set_column(columns[i]);
+      stream->set_kind(kinds[i]);
+      stream->set_length(10 * (i + 1));
+    }
+    bool selected[] = {true, true, false};
+    std::vector<ReadRange> ranges =
+      planStripeReads(footer, 1000, 210, selected, 3);
+    ASSERT_EQ(2, ranges.size());
+    EXPECT_EQ(1010, ranges[0].offset);
+    EXPECT_EQ(20, ranges[0].length);
+    EXPECT_EQ(1060, ranges[1].offset);
+    EXPECT_EQ(40, ranges[1].length);
+
+    // the streams don't fit in the stripe
+    EXPECT_THROW(planStripeReads(footer, 1000, 209, selected, 3), ParseError);
+    footer.mutable_streams(5)->set_length(~0UL);
+    EXPECT_THROW(planStripeReads(footer, 1000, 210, selected, 3), ParseError);
+
+    // a column that isn't in the file
+    footer.mutable_streams(5)->set_length(60);
+    footer.mutable_streams(5)->set_column(3);
+    EXPECT_THROW(planStripeReads(footer, 1000, 210, selected, 3), ParseError);
+  }
+
+  TEST(StripePlanner, stripeBuffer) {
+    CountingInputStream input;
+    StripeBuffer buffer;
+    std::vector<ReadRange> ranges;
+    ranges.push_back({10, 20});
+    ranges.push_back({100, 50});
+    buffer.load(input, ranges);
+    EXPECT_EQ(2, input.reads);
+    EXPECT_EQ(70, input.bytes);
+
+    EXPECT_EQ(nullptr, buffer.getRange(0, 5));
+    EXPECT_EQ(nullptr, buffer.getRange(25, 10));
+    EXPECT_EQ(nullptr, buffer.getRange(140, 20));
+    ASSERT_NE(nullptr, buffer.getRange(15, 15));
+    EXPECT_EQ(15, buffer.getRange(15, 15)[0]);
+    ASSERT_NE(nullptr, buffer.getRange(100, 50));
+    EXPECT_EQ(120, buffer.getRange(120, 2)[0]);
+
+    // streams inside of a loaded range don't read again
+    std::unique_ptr<SeekableInputStream> stream =
+      buffer.getStream(&input, 110, 30, 8);
+    const void* ptr;
+    int length;
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(buffer.getRange(110, 30), ptr);
+    EXPECT_EQ(30, length);
+    EXPECT_EQ(2, input.reads);
+
+    // others fall back to the input
+    stream = buffer.getStream(&input, 200, 30, 8);
+    ASSERT_TRUE(stream->Next(&ptr, &length));
+    EXPECT_EQ(8, length);
+    EXPECT_EQ(static_cast<char>(200), static_cast<const char*>(ptr)[0]);
+    EXPECT_EQ(3, input.reads);
+
+    buffer.clear();
+    EXPECT_EQ(nullptr, buffer.getRange(15, 15));
+  }
+
+  TEST(StripePlanner, alignedStripeBuffer) {
+    CountingInputStream input;
+    input.alignment = 256;
+    StripeBuffer buffer;
+    std::vector<ReadRange> ranges;
+    ranges.push_back({10, 20});
+    ranges.push_back({300, 50});
+    ranges.push_back({900, 50});
+    buffer.load(input, ranges);
+
+    // the first two ranges widen to [0, 512) and the last stops at the end
+    // of the file
+    EXPECT_EQ(2, input.reads);
+    EXPECT_EQ(512 + 232, input.bytes);
+    EXPECT_EQ(0, input.unalignedReads);
+    ASSERT_NE(nullptr, buffer.getRange(10, 20));
+    EXPECT_EQ(10, buffer.getRange(10, 20)[0]);
+    ASSERT_NE(nullptr, buffer.getRange(300, 50));
+    EXPECT_EQ(static_cast<char>(300), buffer.getRange(300, 50)[0]);
+    ASSERT_NE(nullptr, buffer.getRange(900, 50));
+    EXPECT_EQ(static_cast<char>(900), buffer.getRange(900, 50)[0]);
+    EXPECT_EQ(nullptr, buffer.getRange(990, 20));
+  }
+
+  TEST(StripePlanner, asyncTask) {
+    AsyncTask task;
+    EXPECT_FALSE(task.isPending());
+    task.wait();
+
+    CountingInputStream input;
+    StripeBuffer buffer;
+    std::vector<ReadRange> ranges;
+    ranges.push_back({10, 20});
+    task.start([&input, &buffer, &ranges] {
+        buffer.load(input, ranges);
+      });
+    EXPECT_TRUE(task.isPending());
+    EXPECT_THROW(task.start([] {}), std::logic_error);
+    task.wait();
+    EXPECT_FALSE(task.isPending());
+    EXPECT_EQ(1, input.reads);
+    ASSERT_NE(nullptr, buffer.getRange(10, 20));
+
+    // errors from the work are reported when waiting
+    task.start([] { throw std::runtime_error("bad read"); });
+    EXPECT_THROW(task.wait(), std::runtime_error);
+    task.start([&input] { input.reads += 1; });
+    task.wait();
+    EXPECT_EQ(2, input.reads);
+
+    // destroying a task waits for its work
+    {
+      AsyncTask other;
+      other.start([&input] { input.reads += 1; });
+    }
+    EXPECT_EQ(3, input.reads);
+  }
+
+  /**
+   * An InputStream that records how many reads are in flight at once.
+   */
+  class SlowInputStream: public InputStream {
+  private:
+    std::string name;
+    std::atomic<int> active;
+  public:
+    std::atomic<int> maxActive;
+    std::atomic<int> reads;
+
+    SlowInputStream(): name("slow"), active(0), maxActive(0), reads(0) {}
+    ~SlowInputStream();
+
+    long getLength() const override {
+      return 1000;
+    }
+
+    void read(void* buffer, unsigned long offset,
+              unsigned long length) override {
+      int now = ++active;
+      int seen = maxActive;
+      while (now > seen && !maxActive.compare_exchange_weak(seen, now)) {
+        // PASS
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      reads += 1;
+      active -= 1;
+      if (offset >= 1000) {
+        throw std::runtime_error("bad offset");
+      }
+      memset(buffer, static_cast<int>(offset), length);
+    }
+
+    const std::string& getName() const override {
+      return name;
+    }
+  };
+
+  SlowInputStream::~SlowInputStream() {
+    // PASS
+  }
+
+  TEST(StripePlanner, readRangesInParallel) {
+    SlowInputStream input;
+    char buffers[6][10];
+    std::vector<ReadRequest> requests;
+    for(unsigned long i=0; i < 6; ++i) {
+      requests.push_back({buffers[i], i * 10, 10});
+    }
+    readRangesInParallel(input, requests, 3);
+    EXPECT_EQ(6, input.reads);
+    EXPECT_LT(1, input.maxActive);
+    EXPECT_GE(3, input.maxActive);
+    for(unsigned long i=0; i < 6; ++i) {
+      EXPECT_EQ(static_cast<char>(i * 10), buffers[i][9]);
+    }
+
+    // one at a time when parallel reads are turned off
+    SlowInputStream serial;
+    readRangesInParallel(serial, requests, 1);
+    EXPECT_EQ(6, serial.reads);
+    EXPECT_EQ(1, serial.maxActive);
+
+    // the other reads finish before an error is reported
+    requests[2].offset = 2000;
+    SlowInputStream failing;
+    EXPECT_THROW(readRangesInParallel(failing, requests, 4),
+                 std::runtime_error);
+    EXPECT_EQ(6, failing.reads);
+  }
+
+  TEST(StripePlanner, runInParallel) {
+    std::vector<std::atomic<int>> runs(50);
+    std::atomic<unsigned int> maxWorker(0);
+    runInParallel(50, 4, [&runs, &maxWorker](unsigned int worker,
+                                             unsigned long task) {
+        runs[task] += 1;
+        unsigned int seen = maxWorker;
+        while (worker > seen && !maxWorker.compare_exchange_weak(seen,
+                                                                 worker)) {
+          // PASS
+        }
+      });
+    for(unsigned long i=0; i < runs.size(); ++i) {
+      EXPECT_EQ(1, runs[i]) << "task " << i;
+    }
+    EXPECT_GT(4, maxWorker);
+
+    // nothing to do
+    runInParallel(0, 4, [](unsigned int, unsigned long) {
+        FAIL() << "no tasks should run";
+      });
+
+    // every task runs before the first error is rethrown
+    std::atomic<int> count(0);
+    EXPECT_THROW(runInParallel(10, 3, [&count](unsigned int,
+                                               unsigned long task) {
+                     count += 1;
+                     if (task % 2 == 1) {
+                       throw std::runtime_error("bad task");
+                     }
+                   }),
+                 std::runtime_error);
+    EXPECT_EQ(10, count);
+  }
+}